@@ -3,6 +3,8 @@
 
 #include <loader.h>
 
+#include <stats.h>
+
 static u8 rel16(void *dst, u64 val, u8 relative)
 {
 
@@ -152,6 +154,11 @@ u8 loader_apply_relocation(
 	 */
 	switch (rel_type) {
 		
+		case 1: /*R_AMD64_64 :*/
+			rel_f = &rel64;
+			relative = 0;
+			break;
+
 		case 2: /*R_AMD64_PC32 :*/
 			rel_f = &rel32;
 			relative = 1;
@@ -169,8 +176,8 @@ u8 loader_apply_relocation(
 
 	}
 
-	/*Compute the relocation value;*/
-	rel_value = sym_addr + addend - rel_addr;
+	/*Compute the relocation value, relative to the relocation if required;*/
+	rel_value = sym_addr + addend - ((relative) ? rel_addr : 0);
 
 	/*Apply the relocation;*/
 	error = (*rel_f)((void *) rel_addr, rel_value, relative);
@@ -186,3 +193,114 @@ u8 loader_apply_relocation(
 	return 0;
 
 }
+
+/**
+ * relocation_widths : the number of bytes written by relocations of each type
+ * below LOADER_RELOCATION_TYPES, 0 if the type is not supported;
+ */
+static const u8 relocation_widths[LOADER_RELOCATION_TYPES] = {
+	0,
+	8, /*R_AMD64_64 :*/
+	4, /*R_AMD64_PC32 :*/
+	0,
+	4, /*R_AMD64_PLT32 :*/
+};
+
+/**
+ * loader_relocation_width : returns the number of bytes written by a
+ * relocation of type @rel_type;
+ * This function is processor-defined;
+ * @param rel_type : the relocation type;
+ * @return the number of bytes written, 0 if the type is not supported;
+ */
+u8 loader_relocation_width(
+		u32 rel_type
+)
+{
+
+	/*Unsupported relocations past the table are 0 bytes wide;*/
+	return (rel_type < LOADER_RELOCATION_TYPES) ?
+		relocation_widths[rel_type] : (u8) 0;
+
+}
+
+/**
+ * loader_thunk_size : returns the size in bytes of a counting thunk;
+ * This function is processor-defined;
+ * @return the size of a thunk, a multiple of its alignment;
+ */
+u8 loader_thunk_size(void)
+{
+
+	return 32;
+
+}
+
+/**
+ * loader_write_thunk : writes at @thunk a thunk that atomically increments
+ * the counter at @counter, then jumps to @target; registers used for
+ * arguments, and al for variadic calls, are preserved;
+ * This function is processor-defined;
+ * @param thunk : the location of the thunk, loader_thunk_size bytes;
+ * @param counter : the counter to increment;
+ * @param target : the function to jump to;
+ */
+void loader_write_thunk(
+		u8 *thunk,
+		u64 *counter,
+		u64 target
+)
+{
+
+	u8 byte;
+
+	/*movabs $counter, %r11;*/
+	thunk[0] = 0x49;
+	thunk[1] = 0xbb;
+	for (byte = 0; byte < 8; byte++) {
+		thunk[2 + byte] = (u8) ((u64) counter >> (8 * byte));
+	}
+
+	/*lock incq (%r11);*/
+	thunk[10] = 0xf0;
+	thunk[11] = 0x49;
+	thunk[12] = 0xff;
+	thunk[13] = 0x03;
+
+	/*movabs $target, %r11;*/
+	thunk[14] = 0x49;
+	thunk[15] = 0xbb;
+	for (byte = 0; byte < 8; byte++) {
+		thunk[16 + byte] = (u8) (target >> (8 * byte));
+	}
+
+	/*jmp *%r11;*/
+	thunk[24] = 0x41;
+	thunk[25] = 0xff;
+	thunk[26] = 0xe3;
+
+	/*Fill with int3;*/
+	for (byte = 27; byte < 32; byte++) {
+		thunk[byte] = 0xcc;
+	}
+
+}
+
+/**
+ * loader_timestamp : returns the current value of a monotonic,
+ * high-resolution counter;
+ * This function is processor-defined;
+ * @return the current timestamp;
+ */
+u64 loader_timestamp(void)
+{
+
+	u32 low;
+	u32 high;
+
+	/*Read the time stamp counter;*/
+	__asm__ __volatile__ ("rdtsc" : "=a" (low), "=d" (high));
+
+	return ((u64) high << 32) | low;
+
+}
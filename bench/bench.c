@@ -0,0 +1,290 @@
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <unistd.h>
+
+#include <loader.h>
+
+#include "gen.h"
+
+/*The size of the arena loader metadata is allocated in;*/
+#define ARENA_SIZE (1 << 20)
+
+/*The number of loads per configuration, the fastest one is reported;*/
+#define REPEAT 5
+
+#define handle_error(msg) { fprintf(stderr, "%s error;\n", msg); exit(1); }
+
+/*Relocation counts of the default sweep;*/
+static const u32 sweep[] = {10, 100, 1000, 10000, 100000, 1000000};
+
+/*The arena the loader allocates its metadata in, reset before each load;*/
+static u8 arena[ARENA_SIZE];
+static usize arena_used;
+
+/*Cleared statistics;*/
+static const struct loader_stats no_stats;
+
+static void *arena_alloc(void *handle, usize size, usize align, u64 flags)
+{
+	
+	usize start;
+	
+	if (!align)
+		align = 1;
+	
+	start = (arena_used + align - 1) & ~(align - 1);
+	
+	if (start + size > ARENA_SIZE)
+		return 0;
+	
+	arena_used = start + size;
+	
+	return arena + start;
+	
+}
+
+static u64 now_ns(void)
+{
+	
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	
+	return (u64) ts.tv_sec * 1000000000 + (u64) ts.tv_nsec;
+	
+}
+
+/*Derive unset parameters from the relocation count;*/
+static void derive(struct gen_params *p, const struct gen_params *set)
+{
+	
+	u32 r = p->g_relocations;
+	
+	p->g_sections = set->g_sections ? set->g_sections : 1 + r / 4096;
+	p->g_symbols = set->g_symbols ? set->g_symbols : 1 + r / 16;
+	p->g_imports = set->g_imports ? set->g_imports :
+		((r / 64 < 1024) ? 1 + r / 64 : 1024);
+	p->g_plt_percent = set->g_plt_percent;
+	
+}
+
+/*Generate, load and time the object described by @p; print one CSV row;*/
+static void run(const struct gen_params *p, u32 repeat)
+{
+	
+	struct loading_env env;
+	struct loader_allocator alloc;
+	struct loader_stats stats;
+	struct loader_stats best;
+	struct loader_symbol *imports;
+	struct loader_symbol query;
+	char (*names)[16];
+	void *object;
+	usize size;
+	u64 start;
+	u64 total;
+	u64 best_total;
+	u32 iteration;
+	u32 i;
+	u8 error;
+	
+	size = gen_size(p);
+	
+	/*Imports resolve to the object itself, so that PC32 values fit;*/
+	if (!(object = malloc(size)) ||
+		!(imports = malloc(p->g_imports * sizeof(*imports))) ||
+		!(names = malloc(p->g_imports * sizeof(*names))))
+		handle_error("malloc")
+	
+	for (i = 0; i < p->g_imports; i++) {
+		
+		gen_import_name(i, names[i]);
+		imports[i].s_next = (i + 1 < p->g_imports) ? imports + i + 1 : 0;
+		imports[i].s_addr = object;
+		imports[i].s_defined = 1;
+		imports[i].s_name = names[i];
+		
+	}
+	
+	alloc.a_handle = 0;
+	alloc.a_alloc = &arena_alloc;
+	
+	best = no_stats;
+	best_total = (u64) -1;
+	iteration = 0;
+	
+	do {
+		
+		gen_object(p, object);
+		arena_used = 0;
+		
+		query.s_next = 0;
+		query.s_addr = 0;
+		query.s_defined = 0;
+		query.s_name = "f0";
+		
+		start = now_ns();
+		
+		error = loader_init(&env, object, &alloc);
+		
+		if (!error) {
+			
+			loader_stats_start(&env, &stats);
+			error = loader_load(&env, p->g_imports ? imports : 0, &query);
+			
+		}
+		
+		total = now_ns() - start;
+		
+		if (error || !query.s_defined) {
+			
+			fprintf(stderr, "load error %d (phase %d, section %d, entry %d)\n",
+					error, env.r_error.e_phase, env.r_error.e_section,
+					env.r_error.e_entry);
+			exit(1);
+			
+		}
+		
+		if (!iteration || total < best_total) {
+			
+			best_total = total;
+			best = stats;
+			
+		}
+		
+	} while (++iteration < repeat);
+	
+	printf("%u,%u,%u,%u,%u,%lu,%lu,%lu,%lu,%lu,%lu,%u,%u,%u\n",
+		   p->g_relocations, p->g_sections, p->g_symbols, p->g_imports,
+		   p->g_plt_percent, (unsigned long) size, (unsigned long) best_total,
+		   (unsigned long) best.st_time[LOADER_STATS_INIT],
+		   (unsigned long) best.st_time[LOADER_PHASE_SECTIONS],
+		   (unsigned long) best.st_time[LOADER_PHASE_SYMBOLS],
+		   (unsigned long) best.st_time[LOADER_PHASE_RELOCATIONS],
+		   best.st_lookups, best.st_compares, best.st_relocations);
+	
+	fflush(stdout);
+	
+	free(names);
+	free(imports);
+	free(object);
+	
+}
+
+static void usage(const char *name)
+{
+	
+	fprintf(stderr,
+		"usage : %s [-s sections] [-y symbols] [-i imports] [-p plt_percent]\n"
+		"          [-r repeat] [-o object] [relocations ...]\n"
+		"  times each load phase of synthetic objects and prints CSV rows;\n"
+		"  with -o, writes the object with the first relocation count instead;\n",
+		name);
+	
+	exit(1);
+	
+}
+
+int main(int argc, char *argv[])
+{
+	
+	struct gen_params set;
+	struct gen_params p;
+	const char *output;
+	void *object;
+	usize size;
+	FILE *file;
+	u32 repeat;
+	int opt;
+	int i;
+	
+	set.g_sections = set.g_symbols = set.g_imports = 0;
+	set.g_relocations = 0;
+	set.g_plt_percent = 50;
+	repeat = REPEAT;
+	output = 0;
+	
+	while ((opt = getopt(argc, argv, "s:y:i:p:r:o:")) != -1) {
+		
+		switch (opt) {
+			case 's': set.g_sections = (u32) atol(optarg); break;
+			case 'y': set.g_symbols = (u32) atol(optarg); break;
+			case 'i': set.g_imports = (u32) atol(optarg); break;
+			case 'p': set.g_plt_percent = (u32) atol(optarg); break;
+			case 'r': repeat = (u32) atol(optarg); break;
+			case 'o': output = optarg; break;
+			default: usage(argv[0]);
+		}
+		
+	}
+	
+	if (!repeat || set.g_plt_percent > 100)
+		usage(argv[0]);
+	
+	if (output) {
+		
+		if (optind >= argc)
+			usage(argv[0]);
+		
+		p.g_relocations = (u32) atol(argv[optind]);
+		derive(&p, &set);
+		
+		size = gen_size(&p);
+		
+		if (!(object = malloc(size)))
+			handle_error("malloc")
+		
+		gen_object(&p, object);
+		
+		if (!(file = fopen(output, "wb")) ||
+			fwrite(object, 1, size, file) != size || fclose(file))
+			handle_error("write")
+		
+		free(object);
+		
+		return 0;
+		
+	}
+	
+	printf("relocations,sections,symbols,imports,plt_percent,size,total_ns,"
+		   "init,sections_phase,symbols_phase,relocations_phase,lookups,"
+		   "compares,applied\n");
+	
+	if (optind < argc) {
+		
+		for (i = optind; i < argc; i++) {
+			
+			p.g_relocations = (u32) atol(argv[i]);
+			derive(&p, &set);
+			run(&p, repeat);
+			
+		}
+		
+	} else {
+		
+		for (i = 0; i < (int) (sizeof(sweep) / sizeof(*sweep)); i++) {
+			
+			p.g_relocations = sweep[i];
+			derive(&p, &set);
+			run(&p, repeat);
+			
+		}
+		
+	}
+	
+	return 0;
+	
+}
+
+
+void ns_log(const char *str) {
+	fprintf(stderr, "%s", str);
+}
+
+void ns_abort() {
+	abort();
+}
@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Writes a large C source on the standard output; each of its functions mixes
+ * patterns common in real objects : calls to static and global functions and
+ * to libc, string literals, constant tables, switch statements, zero-filled
+ * and initialised globals; with -t, functions are also reached through a
+ * table of function pointers;
+ */
+
+static void usage(const char *name)
+{
+	
+	fprintf(stderr, "usage : %s [-t] functions\n", name);
+	
+	exit(1);
+	
+}
+
+int main(int argc, char *argv[])
+{
+	
+	unsigned long functions;
+	unsigned long i;
+	int table;
+	
+	table = (argc == 3) && (argv[1][0] == '-') && (argv[1][1] == 't');
+	
+	if ((argc != 2 + table) || !(functions = strtoul(argv[1 + table], 0, 10)))
+		usage(argv[0]);
+	
+	printf("#include <stdio.h>\n#include <string.h>\n\n");
+	
+	for (i = 0; i < functions; i++) {
+		
+		printf("unsigned long g%lu;\n", i);
+		printf("unsigned long d%lu = %lu;\n", i, i * 7 + 1);
+		printf("static const unsigned short t%lu[8] = "
+			   "{%lu, %lu, %lu, %lu, %lu, %lu, %lu, %lu};\n", i,
+			   i, i + 3, i * 5, i ^ 9, i + 17, i * 3, i + 1, i ^ 33);
+		printf("\n");
+		
+		printf("static unsigned long s%lu(unsigned long x)\n{\n", i);
+		printf("\tswitch (x %% 8) {\n");
+		printf("\t\tcase 0: return x + t%lu[0];\n", i);
+		printf("\t\tcase 1: return x ^ t%lu[1];\n", i);
+		printf("\t\tcase 2: return x * t%lu[2];\n", i);
+		printf("\t\tcase 3: return x - t%lu[3];\n", i);
+		printf("\t\tcase 4: return (x << 1) + t%lu[4];\n", i);
+		printf("\t\tcase 5: return (x >> 1) + t%lu[5];\n", i);
+		printf("\t\tcase 6: return x + d%lu;\n", i);
+		printf("\t\tdefault: return x + t%lu[7];\n", i);
+		printf("\t}\n}\n\n");
+		
+		printf("unsigned long f%lu(unsigned long x)\n{\n", i);
+		printf("\tchar buffer[32];\n");
+		printf("\tint len;\n");
+		printf("\tlen = sprintf(buffer, \"f%lu %%lu\", x);\n", i);
+		printf("\tg%lu += (unsigned long) len + strlen(buffer);\n", i);
+		if (i)
+			printf("\tx ^= f%lu(x >> 3) & 0xff;\n", (i * 2654435761UL) % i);
+		printf("\treturn s%lu(x) + g%lu + d%lu;\n}\n\n", i, i, i);
+		
+	}
+	
+	if (table) {
+		
+		printf("static unsigned long (*const dispatch[])(unsigned long) = {\n");
+		for (i = 0; i < functions; i++)
+			printf("\tf%lu,\n", i);
+		printf("};\n\n");
+		
+	}
+	
+	printf("unsigned long corpus_main(unsigned long x)\n{\n");
+	printf("\tunsigned long i;\n");
+	if (table) {
+		printf("\tfor (i = 0; i < %lu; i++)\n", functions);
+		printf("\t\tx += dispatch[i](x + i);\n");
+	} else {
+		printf("\tfor (i = 0; i < 16; i++)\n");
+		printf("\t\tx += f%lu(x + i);\n", functions - 1);
+	}
+	printf("\treturn x;\n}\n");
+	
+	return 0;
+	
+}
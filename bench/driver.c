@@ -0,0 +1,535 @@
+#define _GNU_SOURCE
+
+#include <sys/mman.h>
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <elf64.h>
+#include <loader.h>
+
+#include "perfmap.h"
+
+/*The size of the arena sections and loader metadata are allocated in;*/
+#define ARENA_SIZE (64 << 20)
+
+/*The number of loads per variant, the fastest one is reported;*/
+#define REPEAT 5
+
+/*The symbol the driver queries and calls, and its argument;*/
+#define ENTRY "corpus_main"
+#define ENTRY_ARG 1
+
+#define handle_error(msg) { fprintf(stderr, "%s error;\n", msg); exit(1); }
+
+typedef unsigned long (*entry_t)(unsigned long);
+
+/*The maximal length of a profile line;*/
+#define PROFILE_LINE 256
+
+/*<string.h> resolves to nostd's, declare libc's copies;*/
+extern void *memcpy(void *dst, const void *src, size_t size);
+extern char *strdup(const char *str);
+
+/*The arena the loader allocates in, reset before each load;*/
+static u8 *arena;
+static usize arena_used;
+
+/*The object, read in memory so that file reads are not timed;*/
+static u8 *object;
+static usize object_size;
+
+static void *arena_alloc(void *handle, usize size, usize align, u64 flags)
+{
+	
+	usize start;
+	
+	if (!align)
+		align = 1;
+	
+	start = (arena_used + align - 1) & ~(align - 1);
+	
+	if (start + size > ARENA_SIZE)
+		return 0;
+	
+	arena_used = start + size;
+	
+	return arena + start;
+	
+}
+
+/*Sections of an image are laid out in the arena, metadata apart;*/
+static void *image_alloc(void *handle, usize size, usize align, u64 flags)
+{
+	
+	if (!(flags & SHF_ALLOC))
+		return malloc(size ? size : 1);
+	
+	return arena_alloc(handle, size, align, flags);
+	
+}
+
+static u8 mem_read(void *handle, void *dst, u64 offset, usize size)
+{
+	
+	if (offset + size > object_size)
+		return 1;
+	
+	memcpy(dst, object + offset, size);
+	
+	return 0;
+	
+}
+
+static u64 now_ns(void)
+{
+	
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	
+	return (u64) ts.tv_sec * 1000000000 + (u64) ts.tv_nsec;
+	
+}
+
+/*Read @path in memory;*/
+static void read_object(const char *path)
+{
+	
+	FILE *file;
+	long size;
+	
+	if (!(file = fopen(path, "rb")) || fseek(file, 0, SEEK_END) ||
+		((size = ftell(file)) < 0) || fseek(file, 0, SEEK_SET))
+		handle_error("open")
+	
+	object_size = (usize) size;
+	
+	if (!(object = malloc(object_size)) ||
+		fread(object, 1, object_size, file) != object_size)
+		handle_error("read")
+	
+	fclose(file);
+	
+}
+
+/*
+ * Read the profile at @path in @profile : each line holds a function name,
+ * optionally preceded by its call count; functions are sorted by decreasing
+ * count, functions without a count keep the file order;
+ */
+static void read_profile(const char *path, struct loader_profile *profile)
+{
+	
+	FILE *file;
+	char line[PROFILE_LINE];
+	char name[PROFILE_LINE];
+	unsigned long *counts;
+	unsigned long count;
+	const char *function;
+	u32 size;
+	u32 sorted;
+	
+	if (!(file = fopen(path, "r")))
+		handle_error("profile open")
+	
+	profile->p_functions = 0;
+	profile->p_count = 0;
+	counts = 0;
+	size = 0;
+	
+	while (fgets(line, PROFILE_LINE, file)) {
+		
+		if (sscanf(line, "%lu %255s", &count, name) != 2) {
+			
+			count = 0;
+			
+			if (sscanf(line, "%255s", name) != 1)
+				continue;
+			
+		}
+		
+		if (profile->p_count == size) {
+			
+			size = size ? size * 2 : 64;
+			
+			if (!(profile->p_functions = realloc(profile->p_functions,
+				size * sizeof(*profile->p_functions))) ||
+				!(counts = realloc(counts, size * sizeof(*counts))))
+				handle_error("profile realloc")
+			
+		}
+		
+		if (!(function = strdup(name)))
+			handle_error("profile strdup")
+		
+		/*Insert after functions with a greater or equal count;*/
+		for (sorted = profile->p_count;
+			 (sorted) && (counts[sorted - 1] < count); sorted--) {
+			counts[sorted] = counts[sorted - 1];
+			profile->p_functions[sorted] = profile->p_functions[sorted - 1];
+		}
+		
+		counts[sorted] = count;
+		profile->p_functions[sorted] = function;
+		profile->p_count++;
+		
+	}
+	
+	fclose(file);
+	free(counts);
+	
+}
+
+/*
+ * Count relocations of the object per type in @types, the last slot counting
+ * types out of range; return the definition list of undefined symbols, that
+ * are resolved in the driver's process;
+ */
+static struct loader_symbol *scan_object(u32 *types, u32 *relocations,
+										 u16 *sections)
+{
+	
+	struct elf64_hdr *hdr;
+	struct elf64_shdr *shdrs;
+	struct elf64_shdr *shdr;
+	struct elf64_sym *sym;
+	struct loader_symbol *defs;
+	struct loader_symbol *def;
+	const char *strtab;
+	u64 count;
+	u64 entry;
+	u32 type;
+	u16 i;
+	
+	hdr = (struct elf64_hdr *) object;
+	shdrs = (struct elf64_shdr *) (object + hdr->e_shoff);
+	*sections = hdr->e_shnum;
+	*relocations = 0;
+	defs = 0;
+	
+	for (i = 0; i < hdr->e_shnum; i++) {
+		
+		shdr = shdrs + i;
+		
+		if ((shdr->sh_type == SHT_RELA) || (shdr->sh_type == SHT_REL)) {
+			
+			count = shdr->sh_size / shdr->sh_entsize;
+			
+			for (entry = 0; entry < count; entry++) {
+				
+				type = ELF64_R_TYPE(((struct elf64_rel *) (object +
+					shdr->sh_offset + entry * shdr->sh_entsize))->r_info);
+				types[(type < LOADER_STATS_REL_TYPES) ?
+					type : LOADER_STATS_REL_TYPES]++;
+				
+			}
+			
+			*relocations += (u32) count;
+			
+		}
+		
+		if (shdr->sh_type != SHT_SYMTAB)
+			continue;
+		
+		strtab = (const char *) object + shdrs[shdr->sh_link].sh_offset;
+		count = shdr->sh_size / sizeof(struct elf64_sym);
+		
+		for (entry = 1; entry < count; entry++) {
+			
+			sym = (struct elf64_sym *) (object + shdr->sh_offset) + entry;
+			
+			if ((sym->sy_shndx != SHN_UNDEF) || !strtab[sym->sy_name])
+				continue;
+			
+			if (!(def = malloc(sizeof(*def))))
+				handle_error("malloc")
+			
+			def->s_name = strtab + sym->sy_name;
+			def->s_addr = dlsym(RTLD_DEFAULT, def->s_name);
+			def->s_defined = (def->s_addr != 0);
+			def->s_next = defs;
+			defs = def;
+			
+		}
+		
+	}
+	
+	return defs;
+	
+}
+
+int main(int argc, char *argv[])
+{
+	
+	struct loading_env env;
+	struct loader_stream stream;
+	struct loader_allocator alloc;
+	struct loader_symbol *defs;
+	struct loader_symbol query;
+	struct loader_error error;
+	struct loader_stats stats;
+	struct loader_profile profile;
+	struct loader_profile *hot;
+	struct loader_image_hdr *image;
+	usize image_size;
+	void *base;
+	u8 convert;
+	u32 types[LOADER_STATS_REL_TYPES + 1];
+	u32 relocations;
+	u16 sections;
+	u64 start;
+	u64 time;
+	u64 load_ns;
+	u64 resolve_ns;
+	u64 dlopen_ns;
+	unsigned long loaded;
+	unsigned long shared;
+	void *handle;
+	entry_t entry;
+	u32 iteration;
+	u32 type;
+	u32 flags;
+	struct perfmap map;
+	int perf;
+	
+	/*With -g, only sections reachable from the entry are loaded;
+	 * with -f, identical code sections are folded;
+	 * with -p, loaded functions are written to the perf map, with -j, to
+	 * a jitdump file too; with -o <profile>, code sections are ordered by
+	 * the profile; with -i, the object is converted to an image, whose
+	 * load is timed;*/
+	flags = 0;
+	perf = 0;
+	hot = 0;
+	convert = 0;
+	while ((argc > 1) && (argv[1][0] == '-')) {
+		if ((argv[1][1] == 'o') && (argc > 2)) {
+			read_profile(argv[2], &profile);
+			hot = &profile;
+			argv++;
+			argc--;
+		} else if (argv[1][1] == 'g') {
+			flags |= LOADER_FLAG_GC_SECTIONS;
+		} else if (argv[1][1] == 'f') {
+			flags |= LOADER_FLAG_FOLD_CODE;
+		} else if (argv[1][1] == 'p') {
+			perf = 1;
+		} else if (argv[1][1] == 'j') {
+			perf = 2;
+		} else if (argv[1][1] == 'i') {
+			convert = 1;
+		} else {
+			break;
+		}
+		argv++;
+		argc--;
+	}
+	
+	/*Without arguments, print the CSV header;*/
+	if (argc == 1) {
+		
+		printf("variant,error,phase,section,entry,sections,relocations,pc32,"
+			   "plt32,other_types,image,resolve_ns,load_ns,dlopen_ns,match,"
+			   "folded,folded_bytes\n");
+		
+		return 0;
+		
+	}
+	
+	if (argc != 4) {
+		
+		fprintf(stderr, "usage : %s [-g] [-f] [-p|-j] [-o profile] [-i]"
+				" [variant object shared_object]\n"
+				"  loads the object with rmld and the shared object with dlopen,"
+				" and prints\n  a CSV row; without arguments, prints the header;\n",
+				argv[0]);
+		
+		return 1;
+		
+	}
+	
+	arena = mmap(NULL, ARENA_SIZE, PROT_WRITE | PROT_READ | PROT_EXEC,
+				 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	
+	if (arena == MAP_FAILED) handle_error("arena mmap")
+	
+	read_object(argv[2]);
+	
+	if ((perf) && (perfmap_open(&map, perf == 2)))
+		handle_error("jitdump")
+	
+	for (type = 0; type <= LOADER_STATS_REL_TYPES; type++)
+		types[type] = 0;
+	
+	/*Resolving imports is the embedder's job, time it apart;*/
+	start = now_ns();
+	defs = scan_object(types, &relocations, &sections);
+	resolve_ns = now_ns() - start;
+	
+	alloc.a_handle = 0;
+	alloc.a_alloc = &arena_alloc;
+	stream.s_handle = 0;
+	stream.s_read = &mem_read;
+	
+	/*If required, convert the object once, untimed;*/
+	image = 0;
+	
+	if (convert) {
+		
+		arena_used = 0;
+		alloc.a_alloc = &image_alloc;
+		
+		env.r_error.e_code = loader_init_stream(&env, &stream, &alloc);
+		
+		query.s_next = 0;
+		query.s_addr = 0;
+		query.s_defined = 0;
+		query.s_name = ENTRY;
+		
+		/*Sections are collected from the entry;*/
+		if (!env.r_error.e_code) {
+			env.r_flags = flags;
+			env.r_roots = &query;
+			if (!loader_assign_sections(&env) &&
+				!loader_assign_symbols(&env, 0, &query))
+				loader_image_build(&env, (u64) arena, arena_used, &image,
+								   &image_size);
+		}
+		
+		if (env.r_error.e_code) {
+			fprintf(stderr, "conversion error %d\n", env.r_error.e_code);
+			return 1;
+		}
+		
+		alloc.a_alloc = &arena_alloc;
+		
+	}
+	
+	load_ns = (u64) -1;
+	
+	for (iteration = 0; iteration < REPEAT; iteration++) {
+		
+		arena_used = 0;
+		
+		query.s_next = 0;
+		query.s_addr = 0;
+		query.s_defined = 0;
+		query.s_name = ENTRY;
+		
+		start = now_ns();
+		
+		/*Images load apart, without stats;*/
+		if (image) {
+			
+			env.r_error.e_code = loader_image_load(
+				image, image_size, &alloc, defs, &query, &base
+			);
+			
+			env.r_error.e_phase = env.r_error.e_section = 0;
+			env.r_error.e_entry = 0;
+			stats.st_folded = 0;
+			stats.st_folded_bytes = 0;
+			
+		} else if (!(env.r_error.e_code =
+			loader_init_stream(&env, &stream, &alloc))) {
+			env.r_flags = flags;
+			env.r_profile = hot;
+			
+			/*Only the last load is symbolized, previous ones are reset;*/
+			if ((perf) && (iteration == REPEAT - 1))
+				env.r_hook = &map.p_hook;
+			
+			loader_stats_start(&env, &stats);
+			loader_load(&env, defs, &query);
+		}
+		
+		time = now_ns() - start;
+		
+		if (time < load_ns)
+			load_ns = time;
+		
+		error = env.r_error;
+		
+		/*Only locate errors;*/
+		if (error.e_code)
+			break;
+		
+		error.e_phase = error.e_section = 0;
+		error.e_entry = 0;
+		
+	}
+	
+	loaded = 0;
+	
+	if (!error.e_code && query.s_defined) {
+		
+		entry = (entry_t) (usize) query.s_addr;
+		loaded = (*entry)(ENTRY_ARG);
+		
+	}
+	
+	/*dlopen and dlclose the shared object, that is unloaded each time;*/
+	dlopen_ns = (u64) -1;
+	shared = 0;
+	
+	for (iteration = 0; iteration < REPEAT; iteration++) {
+		
+		start = now_ns();
+		
+		if (!(handle = dlopen(argv[3], RTLD_NOW | RTLD_LOCAL)))
+			handle_error("dlopen")
+		
+		time = now_ns() - start;
+		
+		if (time < dlopen_ns)
+			dlopen_ns = time;
+		
+		if (!iteration) {
+			
+			if (!(entry = (entry_t) (usize) dlsym(handle, ENTRY)))
+				handle_error("dlsym")
+			
+			shared = (*entry)(ENTRY_ARG);
+			
+		}
+		
+		dlclose(handle);
+		
+	}
+	
+	if (perf)
+		perfmap_close(&map);
+	
+	printf("%s,%d,%d,%d,%u,%u,%u,%u,%u,", argv[1], error.e_code,
+		   error.e_phase, error.e_section, error.e_entry, sections,
+		   relocations, types[2], types[4]);
+	
+	for (type = 0; type <= LOADER_STATS_REL_TYPES; type++) {
+		
+		if ((type == 2) || (type == 4) || !types[type])
+			continue;
+		
+		printf("%u=%u;", type, types[type]);
+		
+	}
+	
+	printf(",%lu,%lu,%lu,%lu,%d,%u,%lu\n", (unsigned long) arena_used,
+		   (unsigned long) resolve_ns, (unsigned long) load_ns,
+		   (unsigned long) dlopen_ns, !error.e_code && (loaded == shared),
+		   error.e_code ? 0 : stats.st_folded,
+		   error.e_code ? 0 : (unsigned long) stats.st_folded_bytes);
+	
+	return 0;
+	
+}
+
+
+void ns_log(const char *str) {
+	fprintf(stderr, "%s", str);
+}
+
+void ns_abort() {
+	abort();
+}
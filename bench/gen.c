@@ -0,0 +1,262 @@
+/*gen.c - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#include <stdio.h>
+
+#include <elf64.h>
+
+#include "gen.h"
+
+/*The alignment of sections in the generated object;*/
+#define GEN_ALIGN 16
+
+#define gen_align(x) (((x) + GEN_ALIGN - 1) & ~((usize) GEN_ALIGN - 1))
+
+/**
+ * The generator layout struct holds the offset of each part of an object;
+ */
+struct gen_layout {
+	
+	/*The offset of the first text section;*/
+	usize l_text;
+	
+	/*The offset of the first relocation table;*/
+	usize l_rela;
+	
+	/*The offsets of the symbol table and of both string tables;*/
+	usize l_symtab;
+	usize l_strtab;
+	usize l_shstrtab;
+	
+	/*The offset of the section header table;*/
+	usize l_shtable;
+	
+	/*The total size;*/
+	usize l_size;
+	
+};
+
+/*The number of relocations in the text section @i;*/
+static u32 gen_section_relocations(const struct gen_params *p, u32 i)
+{
+	return p->g_relocations / p->g_sections +
+		(u32) (i < p->g_relocations % p->g_sections);
+}
+
+/*The size of the text section @i; each relocation uses 4 bytes;*/
+static usize gen_text_size(const struct gen_params *p, u32 i)
+{
+	return gen_align(4 * (usize) gen_section_relocations(p, i) + 4);
+}
+
+/*The size of a string table holding @count names of at most @len bytes;*/
+static usize gen_names_size(u32 count, usize len)
+{
+	return gen_align(1 + (usize) count * len);
+}
+
+/*Determine the layout of the object described by @p;*/
+static void gen_layout(const struct gen_params *p, struct gen_layout *l)
+{
+	
+	usize offset;
+	u32 i;
+	
+	offset = gen_align(sizeof(struct elf64_hdr));
+	
+	l->l_text = offset;
+	for (i = 0; i < p->g_sections; i++)
+		offset += gen_text_size(p, i);
+	
+	l->l_rela = offset;
+	offset += gen_align((usize) p->g_relocations * sizeof(struct elf64_rela));
+	
+	l->l_symtab = offset;
+	offset += gen_align((usize) (1 + p->g_symbols + p->g_imports) *
+		sizeof(struct elf64_sym));
+	
+	l->l_strtab = offset;
+	offset += gen_names_size(p->g_symbols + p->g_imports, 16);
+	
+	l->l_shstrtab = offset;
+	offset += gen_names_size(2 * p->g_sections + 3, 24);
+	
+	l->l_shtable = offset;
+	offset += (usize) (2 * p->g_sections + 4) * sizeof(struct elf64_shdr);
+	
+	l->l_size = offset;
+	
+}
+
+usize gen_size(const struct gen_params *params)
+{
+	
+	struct gen_layout layout;
+	
+	gen_layout(params, &layout);
+	
+	return layout.l_size;
+	
+}
+
+void gen_import_name(u32 index, char *name)
+{
+	sprintf(name, "imp%u", index);
+}
+
+/*Append @name to the string table at @table, of current size @size;*/
+static u32 gen_name(char *table, usize *size, const char *name)
+{
+	
+	u32 offset;
+	
+	offset = (u32) *size;
+	
+	/*<string.h> resolves to nostd's, copy by hand;*/
+	do {
+		table[(*size)++] = *name;
+	} while (*name++);
+	
+	return offset;
+	
+}
+
+/*Fill a section header;*/
+static void gen_shdr(
+	struct elf64_shdr *shdr, u32 name, u32 type, u64 flags, usize offset,
+	usize size, u32 link, u32 info, u64 entsize
+)
+{
+	shdr->sh_name = name;
+	shdr->sh_type = type;
+	shdr->sh_flags = flags;
+	shdr->sh_addr = 0;
+	shdr->sh_offset = offset;
+	shdr->sh_size = size;
+	shdr->sh_link = link;
+	shdr->sh_info = info;
+	shdr->sh_addralign = GEN_ALIGN;
+	shdr->sh_entsize = entsize;
+}
+
+usize gen_object(const struct gen_params *p, void *buffer)
+{
+	
+	struct gen_layout l;
+	struct elf64_hdr *hdr;
+	struct elf64_shdr *shdrs;
+	struct elf64_sym *syms;
+	struct elf64_rela *rela;
+	char *strtab;
+	char *shstrtab;
+	usize strtab_size;
+	usize shstrtab_size;
+	usize text;
+	u32 nsyms;
+	u32 symtab_id;
+	u32 i;
+	u32 j;
+	u32 k;
+	usize w;
+	char name[32];
+	
+	gen_layout(p, &l);
+	
+	/*The layout is 16 bytes aligned, clear it by words;*/
+	for (w = 0; w < l.l_size / sizeof(u64); w++)
+		((u64 *) buffer)[w] = 0;
+	
+	/*Elf header;*/
+	hdr = buffer;
+	hdr->e_ident.ei_mag0 = ELFMAG0;
+	hdr->e_ident.ei_mag1 = ELFMAG1;
+	hdr->e_ident.ei_mag2 = ELFMAG2;
+	hdr->e_ident.ei_mag3 = ELFMAG3;
+	hdr->e_ident.ei_class = ELFCLASS64;
+	hdr->e_ident.ei_data = ELFDATA2LSB;
+	hdr->e_ident.ei_version = EV_CURRENT;
+	hdr->e_type = ET_REL;
+	hdr->e_machine = EM_X86_64;
+	hdr->e_version = EV_CURRENT;
+	hdr->e_shoff = l.l_shtable;
+	hdr->e_ehsize = sizeof(struct elf64_hdr);
+	hdr->e_shentsize = sizeof(struct elf64_shdr);
+	hdr->e_shnum = (u16) (2 * p->g_sections + 4);
+	hdr->e_shstrndx = (u16) (2 * p->g_sections + 3);
+	
+	shdrs = (struct elf64_shdr *) ((u8 *) buffer + l.l_shtable);
+	syms = (struct elf64_sym *) ((u8 *) buffer + l.l_symtab);
+	rela = (struct elf64_rela *) ((u8 *) buffer + l.l_rela);
+	strtab = (char *) buffer + l.l_strtab;
+	shstrtab = (char *) buffer + l.l_shstrtab;
+	strtab_size = shstrtab_size = 1;
+	nsyms = 1 + p->g_symbols + p->g_imports;
+	symtab_id = 2 * p->g_sections + 1;
+	
+	/*Text sections and their relocation tables;*/
+	text = l.l_text;
+	for (i = 0; i < p->g_sections; i++) {
+		
+		sprintf(name, ".text.%u", i);
+		gen_shdr(shdrs + 1 + i, gen_name(shstrtab, &shstrtab_size, name),
+			SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, text, gen_text_size(p, i),
+			0, 0, 0);
+		
+		sprintf(name, ".rela.text.%u", i);
+		gen_shdr(shdrs + 1 + p->g_sections + i,
+			gen_name(shstrtab, &shstrtab_size, name), SHT_RELA, 0,
+			(usize) ((u8 *) rela - (u8 *) buffer),
+			gen_section_relocations(p, i) * sizeof(struct elf64_rela),
+			symtab_id, 1 + i, sizeof(struct elf64_rela));
+		
+		/*Relocations, 4 bytes apart, referencing symbols in turn;*/
+		for (j = 0; j < gen_section_relocations(p, i); j++, rela++) {
+			
+			k = (u32) (rela - (struct elf64_rela *) ((u8 *) buffer + l.l_rela));
+			
+			rela->r_offset = 4 * (u64) j;
+			rela->r_info = ELF64_R_INFO(1 + k % (nsyms - 1),
+				((k % 100) < p->g_plt_percent) ? 4 : 2);
+			rela->r_addend = -4;
+			
+		}
+		
+		text += gen_text_size(p, i);
+		
+	}
+	
+	/*Symbols; defined ones are spread over text sections;*/
+	for (i = 0; i < p->g_symbols; i++) {
+		
+		sprintf(name, "f%u", i);
+		syms[1 + i].sy_name = gen_name(strtab, &strtab_size, name);
+		syms[1 + i].sy_info = ELF_SY_BIND_TYPE_TO_INFO(SYB_GLOBAL, SYT_FUNC);
+		syms[1 + i].sy_shndx = (u16) (1 + i % p->g_sections);
+		syms[1 + i].sy_value = 0;
+		
+	}
+	
+	for (i = 0; i < p->g_imports; i++) {
+		
+		gen_import_name(i, name);
+		syms[1 + p->g_symbols + i].sy_name =
+			gen_name(strtab, &strtab_size, name);
+		syms[1 + p->g_symbols + i].sy_info =
+			ELF_SY_BIND_TYPE_TO_INFO(SYB_GLOBAL, SYT_NOTYPE);
+		
+	}
+	
+	gen_shdr(shdrs + symtab_id, gen_name(shstrtab, &shstrtab_size, ".symtab"),
+		SHT_SYMTAB, 0, l.l_symtab, nsyms * sizeof(struct elf64_sym),
+		symtab_id + 1, 1, sizeof(struct elf64_sym));
+	
+	gen_shdr(shdrs + symtab_id + 1,
+		gen_name(shstrtab, &shstrtab_size, ".strtab"), SHT_STRTAB, 0,
+		l.l_strtab, strtab_size, 0, 0, 0);
+	
+	gen_shdr(shdrs + symtab_id + 2,
+		gen_name(shstrtab, &shstrtab_size, ".shstrtab"), SHT_STRTAB, 0,
+		l.l_shstrtab, shstrtab_size, 0, 0, 0);
+	
+	return l.l_size;
+	
+}
@@ -0,0 +1,50 @@
+/*gen.h - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#ifndef RMLD_BENCH_GEN_H
+#define RMLD_BENCH_GEN_H
+
+#include <types.h>
+
+/**
+ * The generator parameters struct describes a synthetic relocatable object;
+ * relocations are spread evenly over text sections, and each one references
+ * a defined or imported symbol, in turn;
+ */
+struct gen_params {
+	
+	/*The number of text sections, each with its relocation table;*/
+	u32 g_sections;
+	
+	/*The number of global symbols defined in text sections;*/
+	u32 g_symbols;
+	
+	/*The number of undefined symbols, named imp<n>;*/
+	u32 g_imports;
+	
+	/*The number of relocations;*/
+	u32 g_relocations;
+	
+	/*The percentage of R_X86_64_PLT32 relocations, others are PC32;*/
+	u32 g_plt_percent;
+	
+};
+
+/**
+ * gen_size : returns the size in bytes of the object described by @params;
+ */
+usize gen_size(const struct gen_params *params);
+
+/**
+ * gen_object : writes the object described by @params in @buffer, that must
+ * be at least gen_size(params) bytes long and 8 bytes aligned;
+ * @return the size of the object;
+ */
+usize gen_object(const struct gen_params *params, void *buffer);
+
+/**
+ * gen_import_name : writes the name of the @index-th import in @name;
+ */
+void gen_import_name(u32 index, char *name);
+
+
+#endif /*RMLD_BENCH_GEN_H*/
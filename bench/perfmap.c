@@ -0,0 +1,263 @@
+/*perfmap.c - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#define _GNU_SOURCE
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "perfmap.h"
+
+/*jitdump constants, see tools/perf/Documentation/jitdump-specification.txt;*/
+#define JITDUMP_MAGIC 0x4A695444
+#define JITDUMP_VERSION 1
+#define JITDUMP_CODE_LOAD 0
+#define JITDUMP_CODE_CLOSE 3
+#define JITDUMP_MACH_X86_64 62
+
+/*A loaded function;*/
+struct perfmap_entry {
+	u64 e_addr;
+	u64 e_size;
+	char *e_name;
+};
+
+/*The jitdump file header;*/
+struct jitdump_header {
+	u32 h_magic;
+	u32 h_version;
+	u32 h_size;
+	u32 h_mach;
+	u32 h_pad;
+	u32 h_pid;
+	u64 h_timestamp;
+	u64 h_flags;
+};
+
+/*The jitdump record prefix;*/
+struct jitdump_record {
+	u32 r_id;
+	u32 r_size;
+	u64 r_timestamp;
+};
+
+/*The jitdump code load record, followed by the name and the code;*/
+struct jitdump_load {
+	struct jitdump_record l_record;
+	u32 l_pid;
+	u32 l_tid;
+	u64 l_vma;
+	u64 l_code_addr;
+	u64 l_code_size;
+	u64 l_code_index;
+};
+
+/*<string.h> resolves to nostd's, declare libc's copies;*/
+extern size_t strlen(const char *str);
+extern char *strdup(const char *str);
+
+/*perf expects monotonic timestamps in nanoseconds;*/
+static u64 timestamp(void)
+{
+	
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	
+	return (u64) ts.tv_sec * 1000000000 + (u64) ts.tv_nsec;
+	
+}
+
+/*Rewrite the map with all loaded functions;*/
+static void perfmap_rewrite(struct perfmap *map)
+{
+	
+	char path[64];
+	FILE *file;
+	u32 index;
+	
+	sprintf(path, "/tmp/perf-%d.map", (int) getpid());
+	
+	if (!(file = fopen(path, "w")))
+		return;
+	
+	for (index = 0; index < map->p_count; index++) {
+		fprintf(file, "%lx %lx %s\n", (unsigned long) map->p_entries[index].e_addr,
+				(unsigned long) map->p_entries[index].e_size,
+				map->p_entries[index].e_name);
+	}
+	
+	fclose(file);
+	
+}
+
+static void perfmap_load(void *handle, const char *name, u64 addr, u64 size)
+{
+	
+	struct perfmap *map = handle;
+	struct perfmap_entry *entry;
+	struct jitdump_load load;
+	char path[64];
+	FILE *file;
+	usize length;
+	
+	/*perf ignores empty ranges;*/
+	if (!size)
+		size = 1;
+	
+	if (map->p_count == map->p_size) {
+		
+		map->p_size = map->p_size ? 2 * map->p_size : 64;
+		map->p_entries = realloc(map->p_entries,
+								 map->p_size * sizeof(struct perfmap_entry));
+		
+		if (!map->p_entries)
+			abort();
+		
+	}
+	
+	entry = map->p_entries + map->p_count++;
+	entry->e_addr = addr;
+	entry->e_size = size;
+	entry->e_name = strdup(name);
+	
+	/*Append the entry to the map;*/
+	sprintf(path, "/tmp/perf-%d.map", (int) getpid());
+	
+	if ((file = fopen(path, "a"))) {
+		fprintf(file, "%lx %lx %s\n", (unsigned long) addr,
+				(unsigned long) size, name);
+		fclose(file);
+	}
+	
+	if (map->p_jitdump < 0)
+		return;
+	
+	/*Append a code load record, with the code bytes;*/
+	length = strlen(name) + 1;
+	
+	load.l_record.r_id = JITDUMP_CODE_LOAD;
+	load.l_record.r_size = (u32) (sizeof(load) + length + size);
+	load.l_record.r_timestamp = timestamp();
+	load.l_pid = load.l_tid = (u32) getpid();
+	load.l_vma = load.l_code_addr = addr;
+	load.l_code_size = size;
+	load.l_code_index = map->p_index++;
+	
+	if ((write(map->p_jitdump, &load, sizeof(load)) < 0) ||
+		(write(map->p_jitdump, name, length) < 0) ||
+		(write(map->p_jitdump, (void *) (usize) addr, size) < 0))
+		fprintf(stderr, "jitdump write error;\n");
+	
+}
+
+static void perfmap_unload(void *handle, const char *name, u64 addr, u64 size)
+{
+	
+	struct perfmap *map = handle;
+	u32 index;
+	
+	/*Remove the entry, and rewrite the map;*/
+	for (index = 0; index < map->p_count; index++) {
+		
+		if (map->p_entries[index].e_addr != addr)
+			continue;
+		
+		free(map->p_entries[index].e_name);
+		map->p_entries[index] = map->p_entries[--map->p_count];
+		
+		perfmap_rewrite(map);
+		
+		return;
+		
+	}
+	
+}
+
+/**
+ * perfmap_open : initializes @map and its hook, creates the jitdump file if
+ * @jitdump is set;
+ * @return 0 if the map is ready, 1 if the jitdump file could not be created;
+ */
+int perfmap_open(struct perfmap *map, int jitdump)
+{
+	
+	struct jitdump_header header;
+	char path[64];
+	
+	map->p_hook.h_handle = map;
+	map->p_hook.h_load = &perfmap_load;
+	map->p_hook.h_unload = &perfmap_unload;
+	map->p_entries = 0;
+	map->p_count = map->p_size = 0;
+	map->p_jitdump = -1;
+	map->p_marker = MAP_FAILED;
+	map->p_index = 0;
+	
+	/*Start with an empty map;*/
+	perfmap_rewrite(map);
+	
+	if (!jitdump)
+		return 0;
+	
+	sprintf(path, "jit-%d.dump", (int) getpid());
+	
+	map->p_jitdump = open(path, O_CREAT | O_TRUNC | O_RDWR, 0666);
+	
+	if (map->p_jitdump < 0)
+		return 1;
+	
+	header.h_magic = JITDUMP_MAGIC;
+	header.h_version = JITDUMP_VERSION;
+	header.h_size = sizeof(header);
+	header.h_mach = JITDUMP_MACH_X86_64;
+	header.h_pad = 0;
+	header.h_pid = (u32) getpid();
+	header.h_timestamp = timestamp();
+	header.h_flags = 0;
+	
+	if (write(map->p_jitdump, &header, sizeof(header)) < 0)
+		return 1;
+	
+	/*perf record finds the file through an executable mapping of it;*/
+	map->p_marker = mmap(NULL, (size_t) sysconf(_SC_PAGESIZE),
+						 PROT_READ | PROT_EXEC, MAP_PRIVATE, map->p_jitdump, 0);
+	
+	return map->p_marker == MAP_FAILED;
+	
+}
+
+/**
+ * perfmap_close : closes the jitdump file of @map, and releases entries;
+ * the map file is kept, for perf report;
+ */
+void perfmap_close(struct perfmap *map)
+{
+	
+	struct jitdump_record close_record;
+	
+	if (map->p_jitdump >= 0) {
+		
+		close_record.r_id = JITDUMP_CODE_CLOSE;
+		close_record.r_size = sizeof(close_record);
+		close_record.r_timestamp = timestamp();
+		
+		if (write(map->p_jitdump, &close_record, sizeof(close_record)) < 0)
+			fprintf(stderr, "jitdump write error;\n");
+		
+		if (map->p_marker != MAP_FAILED)
+			munmap(map->p_marker, (size_t) sysconf(_SC_PAGESIZE));
+		
+		close(map->p_jitdump);
+		
+	}
+	
+	while (map->p_count)
+		free(map->p_entries[--map->p_count].e_name);
+	
+	free(map->p_entries);
+	
+}
@@ -0,0 +1,48 @@
+/*perfmap.h - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#ifndef RMLD_BENCH_PERFMAP_H
+#define RMLD_BENCH_PERFMAP_H
+
+#include <loader.h>
+
+/**
+ * The perfmap struct implements a code hook that symbolizes loaded
+ * functions for perf : it maintains /tmp/perf-<pid>.map, and optionally
+ * appends code load records, with code bytes, to ./jit-<pid>.dump;
+ */
+struct perfmap {
+	
+	/*The hook to set in loading environments;*/
+	struct loader_code_hook p_hook;
+	
+	/*The loaded functions, rewritten to the map when one is unloaded;*/
+	struct perfmap_entry *p_entries;
+	u32 p_count;
+	u32 p_size;
+	
+	/*The jitdump file descriptor, -1 if disabled;*/
+	int p_jitdump;
+	
+	/*The jitdump header mapping, that makes perf record the file;*/
+	void *p_marker;
+	
+	/*The index of the next code load record;*/
+	u64 p_index;
+	
+};
+
+/**
+ * perfmap_open : initializes @map and its hook, creates the jitdump file if
+ * @jitdump is set;
+ * @return 0 if the map is ready, 1 if the jitdump file could not be created;
+ */
+int perfmap_open(struct perfmap *map, int jitdump);
+
+/**
+ * perfmap_close : closes the jitdump file of @map, and releases entries;
+ * the map file is kept, for perf report;
+ */
+void perfmap_close(struct perfmap *map);
+
+
+#endif /*RMLD_BENCH_PERFMAP_H*/
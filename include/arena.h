@@ -0,0 +1,62 @@
+/*arena.h - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#ifndef KERNEL_TK_ARENA_H
+#define KERNEL_TK_ARENA_H
+
+#include <types.h>
+
+/**
+ * The loader arena struct is a bump allocator in a caller provided block;
+ * allocations are never freed one by one, the arena is reset at once; it
+ * can be plugged in a loader allocator with loader_arena_alloc;
+ */
+struct loader_arena {
+	
+	/*The first byte of the block;*/
+	u8 *a_start;
+	
+	/*The size of the block;*/
+	usize a_size;
+	
+	/*The number of bytes used, from the start of the block;*/
+	usize a_used;
+	
+	/*The greatest number of bytes used since the arena was initialized;*/
+	usize a_peak;
+	
+};
+
+/**
+ * loader_arena_init : initializes @arena in the block [@start, @start + @size[;
+ * @param arena : the arena to initialize;
+ * @param start : the first byte of the block;
+ * @param size : the size of the block;
+ */
+void loader_arena_init(
+	struct loader_arena *arena,
+	void *start,
+	usize size
+);
+
+/**
+ * loader_arena_alloc : allocates @size bytes aligned on @align in the arena
+ * @handle; the signature matches a loader allocator's, flags are ignored;
+ * @param handle : the arena;
+ * @param size : the number of bytes to allocate;
+ * @param align : the alignment, a power of 2, null for no alignment;
+ * @param flags : ignored;
+ * @return the allocated memory, null if the arena is full;
+ */
+void *loader_arena_alloc(
+	void *handle,
+	usize size,
+	usize align,
+	u64 flags
+);
+
+/**
+ * loader_arena_reset : frees all allocations of @arena at once;
+ */
+#define loader_arena_reset(arena) ((void) ((arena)->a_used = 0))
+
+#endif /*KERNEL_TK_ARENA_H*/
@@ -0,0 +1,112 @@
+/*common.h - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#ifndef KERNEL_TK_COMMON_H
+#define KERNEL_TK_COMMON_H
+
+#include <table.h>
+
+/**
+ * The loader common struct records a common symbol of a link set; its size
+ * and alignment are the largest declared, and it is placed once, by the first
+ * load that defines it;
+ */
+struct loader_common {
+	
+	/*The slot header, that holds the name's hash;*/
+	struct loader_hash_slot c_slot;
+	
+	/*The symbol's name;*/
+	const char *c_name;
+	
+	/*The largest size declared;*/
+	u64 c_size;
+	
+	/*The largest alignment declared;*/
+	u64 c_align;
+	
+	/*The symbol's address, null until a load places it;*/
+	u8 *c_addr;
+	
+};
+
+/**
+ * The loader common table struct is a hash set of common symbols, shared by
+ * the loads of a link set so that common symbols with the same name are one
+ * zero-filled object, as large and as aligned as their largest declaration;
+ * declarations are only merged before the symbol is placed : loads can
+ * declare their common symbols first, see loader_declare_commons; the loader
+ * saves names in data memory; symbols reference the module that placed
+ * them : before that module is unloaded, its symbols must be removed with
+ * loader_common_table_remove, and modules that resolved to them unloaded;
+ * the table takes no lock : loads that share it, including loads prepared
+ * on workers, and removals must be serialized by the caller;
+ */
+struct loader_common_table {
+	
+	/*The hash table of struct loader_common slots;*/
+	struct loader_hash_table t_commons;
+	
+};
+
+/**
+ * loader_common_table_init : initializes @table with the slot array
+ * @commons;
+ * @param table : the table to initialize;
+ * @param commons : the slot array;
+ * @param mask : the number of slots minus one; must be 2^n - 1;
+ */
+void loader_common_table_init(
+	struct loader_common_table *table,
+	struct loader_common *commons,
+	u32 mask
+);
+
+/**
+ * loader_common_find : searches @table for the common symbol named @name;
+ * if none is found, and the table is less than 3/4 full, a symbol is
+ * inserted, with the name @name, that the caller may replace with a copy, and
+ * a null size and alignment;
+ * @param table : the table to search;
+ * @param name : the symbol's name;
+ * @param inserted : set if the symbol was inserted, cleared if not;
+ * @param probes : incremented with the number of slots probed;
+ * @return the symbol, null if it is not in the table and the table is full;
+ */
+struct loader_common *loader_common_find(
+	struct loader_common_table *table,
+	const char *name,
+	u8 *inserted,
+	u32 *probes
+);
+
+/**
+ * loader_common_declare : merges a declaration of @common with @size bytes
+ * and the alignment @align;
+ * @param common : the common symbol;
+ * @param size : the declared size;
+ * @param align : the declared alignment;
+ * @return 0 if the declaration was merged, 1 if @common is already placed,
+ * and smaller or less aligned than declared;
+ */
+u8 loader_common_declare(
+	struct loader_common *common,
+	u64 size,
+	u64 align
+);
+
+/**
+ * loader_common_table_remove : removes from @table the common symbols placed
+ * in [@start, @end[, so that their memory can be freed;
+ * @param table : the table;
+ * @param start : the first byte of the memory to free;
+ * @param end : the byte following the memory to free;
+ * @return the number of symbols removed;
+ */
+u32 loader_common_table_remove(
+	struct loader_common_table *table,
+	u64 start,
+	u64 end
+);
+
+
+#endif /*KERNEL_TK_COMMON_H*/
@@ -348,6 +348,9 @@ rel_error_t elf_identifier_check(struct elf_identifier *, u8 elf_64);
 /*Unknown section type;*/
 #define SHT_NUM 12
 
+/*Section holds a section group : a flag word, then member section indexes;*/
+#define SHT_GROUP 17
+
 /*Range reserves for processor-specified semantics;*/
 #define SHT_LOPROC 0x70000000
 #define SHT_HIPROC 0x7fffffff
@@ -368,11 +371,20 @@ rel_error_t elf_identifier_check(struct elf_identifier *, u8 elf_64);
 #define SHF_ALLOC (1 << 1)
 
 /*Section contains executable machine instructions;*/
-#define SHF_EXECINSTR (1 >> 2)
+#define SHF_EXECINSTR (1 << 2)
+
+/*Section contains entries of sh_entsize bytes that may be merged;*/
+#define SHF_MERGE (1 << 4)
+
+/*Mergeable entries are null-terminated strings of sh_entsize bytes chars;*/
+#define SHF_STRINGS (1 << 5)
 
 /*Reserved flags;*/
 #define SHF_MASKPROC 0xf0000000
 
+/*Group flag : only one copy of the group is kept;*/
+#define GRP_COMDAT 0x1
+
 
 /*------------------------ symbol entries constants -------------------------*/
 
@@ -425,7 +437,7 @@ rel_error_t elf_identifier_check(struct elf_identifier *, u8 elf_64);
 /*Combine sy_bind and sy_type to sy_info;*/
 #define ELF_SY_BIND_TYPE_TO_INFO(bind, type)\
 	((u8) (((0x0f & ((u8)(bind))) << 4) \
-					| (0x0f & ((u8)(info)))))
+					| (0x0f & ((u8)(type)))))
 
 
 /*
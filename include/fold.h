@@ -0,0 +1,121 @@
+/*fold.h - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#ifndef KERNEL_TK_FOLD_H
+#define KERNEL_TK_FOLD_H
+
+#include <table.h>
+
+/**
+ * The loader fold relocation struct describes a relocation of a code
+ * section, independently of the section's address;
+ */
+struct loader_fold_relocation {
+	
+	/*The offset of the relocated field in the section;*/
+	u64 r_offset;
+	
+	/*The target's address, or its offset in the section if r_self is set;*/
+	u64 r_target;
+	
+	/*The addend; for rel entries, the unrelocated bytes of the field;*/
+	s64 r_addend;
+	
+	/*The relocation type;*/
+	u32 r_type;
+	
+	/*The number of bytes written by the relocation;*/
+	u16 r_width;
+	
+	/*Set if the target is in the section;*/
+	u16 r_self;
+	
+};
+
+/**
+ * The loader fold entry struct records the first loaded copy of a code
+ * section, and its relocations, that copies must have to be folded into it;
+ */
+struct loader_fold_entry {
+	
+	/*The slot header, that holds the hash of the section's unrelocated
+	 * content and relocations;*/
+	struct loader_hash_slot f_slot;
+	
+	/*The address of the section;*/
+	u64 f_addr;
+	
+	/*The size of the section;*/
+	u64 f_size;
+	
+	/*The section's relocations, sorted by offset;*/
+	const struct loader_fold_relocation *f_relocations;
+	
+	/*The number of relocations;*/
+	u32 f_nb_relocations;
+	
+};
+
+/**
+ * The loader fold table struct is a hash set of code sections, that can be
+ * shared by loads so that identical code of all modules is used once;
+ * entries reference loaded sections : before a module is unloaded, its
+ * entries must be removed with loader_fold_table_remove, and modules that
+ * folded code into them unloaded; the table takes no lock : loads that
+ * share it, including loads prepared on workers, and removals must be
+ * serialized by the caller;
+ */
+struct loader_fold_table {
+	
+	/*The hash table of struct loader_fold_entry slots;*/
+	struct loader_hash_table t_entries;
+	
+};
+
+/**
+ * loader_fold_table_init : initializes @table with the slot array @entries;
+ * @param table : the table to initialize;
+ * @param entries : the slot array;
+ * @param mask : the number of slots minus one; must be 2^n - 1;
+ */
+void loader_fold_table_init(
+	struct loader_fold_table *table,
+	struct loader_fold_entry *entries,
+	u32 mask
+);
+
+/**
+ * loader_fold_find : searches @table for an entry identical to @section :
+ * with the same size and relocations, and the same bytes out of relocated
+ * fields, as the first copy may be relocated; if none is found, and the
+ * table is less than 3/4 full, @section is inserted; the caller must then
+ * make its relocations outlive the table;
+ * @param table : the table to search;
+ * @param hash : the section's hash;
+ * @param section : the section to search for, whose slot header is unused;
+ * @param probes : incremented with the number of slots probed;
+ * @return the identical entry, the inserted entry, whose address is the
+ * section's, or null if the table is full;
+ */
+struct loader_fold_entry *loader_fold_find(
+	struct loader_fold_table *table,
+	u32 hash,
+	const struct loader_fold_entry *section,
+	u32 *probes
+);
+
+/**
+ * loader_fold_table_remove : removes from @table the sections in
+ * [@start, @end[, so that their memory can be freed;
+ * @param table : the table;
+ * @param start : the first byte of the memory to free;
+ * @param end : the byte following the memory to free;
+ * @return the number of sections removed;
+ */
+u32 loader_fold_table_remove(
+	struct loader_fold_table *table,
+	u64 start,
+	u64 end
+);
+
+
+#endif /*KERNEL_TK_FOLD_H*/
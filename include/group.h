@@ -0,0 +1,96 @@
+/*group.h - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#ifndef KERNEL_TK_GROUP_H
+#define KERNEL_TK_GROUP_H
+
+#include <table.h>
+
+struct loader_symbol;
+
+/**
+ * The loader group struct records the first loaded copy of a COMDAT group;
+ */
+struct loader_group {
+	
+	/*The slot header, that holds the signature's hash;*/
+	struct loader_hash_slot g_slot;
+	
+	/*The group's signature;*/
+	const char *g_signature;
+	
+	/*The symbols and sections defined by the first copy, that later copies
+	 * resolve to; sections are named after their section name;*/
+	struct loader_symbol *g_symbols;
+	
+};
+
+/**
+ * The loader group table struct is a hash set of COMDAT groups, shared by
+ * loads so that each group is loaded once; the loader saves signatures and
+ * symbol names in data memory, as string tables of a load may be released
+ * with its scratch memory; symbols reference the module that loaded the
+ * first copy : before that module is unloaded, its groups must be removed
+ * with loader_group_table_remove, and modules that resolved to them unloaded;
+ * the table takes no lock : loads that share it, including loads prepared
+ * on workers, and removals must be serialized by the caller;
+ */
+struct loader_group_table {
+	
+	/*The hash table of struct loader_group slots;*/
+	struct loader_hash_table t_groups;
+	
+};
+
+/**
+ * loader_group_table_init : initializes @table with the slot array @groups;
+ * @param table : the table to initialize;
+ * @param groups : the slot array;
+ * @param mask : the number of slots minus one; must be 2^n - 1;
+ */
+void loader_group_table_init(
+	struct loader_group_table *table,
+	struct loader_group *groups,
+	u32 mask
+);
+
+/**
+ * loader_group_at : returns the group at @index in @table;
+ */
+#define loader_group_at(table, index) \
+	((struct loader_group *) loader_hash_slot_at(&(table)->t_groups, index))
+
+/**
+ * loader_group_find : searches @table for the group with the signature
+ * @signature; if none is found, and the table is less than 3/4 full, a group
+ * is inserted, with the signature @signature, that the caller may replace
+ * with a copy;
+ * @param table : the table to search;
+ * @param signature : the group's signature;
+ * @param inserted : set if the group was inserted, cleared if not;
+ * @param probes : incremented with the number of slots probed;
+ * @return the group, null if it is not in the table and the table is full;
+ */
+struct loader_group *loader_group_find(
+	struct loader_group_table *table,
+	const char *signature,
+	u8 *inserted,
+	u32 *probes
+);
+
+/**
+ * loader_group_table_remove : removes from @table the groups whose first
+ * copy defines a symbol in [@start, @end[, so that the memory of the copy can
+ * be freed;
+ * @param table : the table;
+ * @param start : the first byte of the memory to free;
+ * @param end : the byte following the memory to free;
+ * @return the number of groups removed;
+ */
+u32 loader_group_table_remove(
+	struct loader_group_table *table,
+	u64 start,
+	u64 end
+);
+
+
+#endif /*KERNEL_TK_GROUP_H*/
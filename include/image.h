@@ -0,0 +1,140 @@
+/*image.h - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#ifndef KERNEL_TK_IMAGE_H
+#define KERNEL_TK_IMAGE_H
+
+#include <types.h>
+
+/**
+ * A loader image is a file, laid out in memory offline, that loads without
+ * parsing elf structures; it is made of, in order and aligned on 8 bytes :
+ * - the image header;
+ * - the first i_file_size bytes of the image, the rest being zero;
+ * - i_nb_fixups fixups, relocations that depend on imports, or on the image's
+ *   address without being 64 bits words;
+ * - i_nb_imports offsets of import names in the string block;
+ * - i_nb_exports exports;
+ * - the string block, i_strings_size bytes;
+ * - i_nb_relr relr words, that locate 64 bits words of the image to which
+ *   the image's address must be added;
+ */
+
+/*The image magic number, "RMLI";*/
+#define LOADER_IMAGE_MAGIC ((u32) 0x494c4d52)
+
+/*The version of the image format;*/
+#define LOADER_IMAGE_VERSION ((u32) 1)
+
+/*The symbol of fixups relative to the image's address;*/
+#define LOADER_IMAGE_SELF ((u32) -1)
+
+/*The number of words located by a relr bitmap word;*/
+#define LOADER_RELR_BITS 63
+
+/**
+ * The loader image header struct describes the content of an image file;
+ */
+struct loader_image_hdr {
+	
+	/*The magic number and the format version;*/
+	u32 i_magic;
+	u32 i_version;
+	
+	/*The size of the image in memory;*/
+	u64 i_size;
+	
+	/*The number of bytes of the image stored in the file;*/
+	u64 i_file_size;
+	
+	/*The section flags of the image, transmitted to the allocator;*/
+	u64 i_flags;
+	
+	/*The alignment of the image;*/
+	u32 i_align;
+	
+	/*The number of fixups, imports, exports and relr words;*/
+	u32 i_nb_fixups;
+	u32 i_nb_imports;
+	u32 i_nb_exports;
+	u32 i_nb_relr;
+	
+	/*The size of the string block;*/
+	u32 i_strings_size;
+	
+};
+
+/**
+ * The loader image fixup struct describes a relocation applied at load;
+ */
+struct loader_image_fixup {
+	
+	/*The offset of the relocation in the image;*/
+	u32 f_offset;
+	
+	/*The index of the import, or LOADER_IMAGE_SELF;*/
+	u32 f_symbol;
+	
+	/*The relocation type;*/
+	u32 f_type;
+	
+	/*The addend; for LOADER_IMAGE_SELF, includes the target's offset;*/
+	s32 f_addend;
+	
+};
+
+/**
+ * The loader image export struct describes a definition of the image;
+ */
+struct loader_image_export {
+	
+	/*The offset of the name in the string block;*/
+	u32 e_name;
+	
+	/*The offset of the definition in the image;*/
+	u32 e_offset;
+	
+};
+
+/**
+ * loader_relr_encode : encodes sorted offsets of 64 bits words in relr
+ * words : an even word is the offset of a word, and each following odd word
+ * is a bitmap of the LOADER_RELR_BITS next words;
+ * @param offsets : the sorted offsets, multiple of 8;
+ * @param count : the number of offsets;
+ * @param words : the relr words, at most @count; may be @offsets;
+ * @return the number of relr words;
+ */
+u32 loader_relr_encode(
+	const u64 *offsets,
+	u32 count,
+	u64 *words
+);
+
+/**
+ * loader_relr_check : verifies that words located by @words are in an image
+ * of @size bytes;
+ * @param words : the relr words;
+ * @param count : the number of relr words;
+ * @param size : the size of the image;
+ * @return 1 if all words are in the image, 0 if not;
+ */
+u8 loader_relr_check(
+	const u64 *words,
+	u32 count,
+	u64 size
+);
+
+/**
+ * loader_relr_apply : adds @base to each 64 bits word of the image at @base
+ * located by @words;
+ * @param base : the image;
+ * @param words : the relr words;
+ * @param count : the number of relr words;
+ */
+void loader_relr_apply(
+	u8 *base,
+	const u64 *words,
+	u32 count
+);
+
+#endif /*KERNEL_TK_IMAGE_H*/
@@ -7,6 +7,29 @@
 
 #include <elf64.h>
 
+#include <trace.h>
+
+#include <probe.h>
+
+#include <stats.h>
+
+#include <table.h>
+
+#include <merge.h>
+
+#include <group.h>
+
+#include <fold.h>
+#include <common.h>
+
+#include <module.h>
+
+#include <registry.h>
+
+#include <image.h>
+
+#include <arena.h>
+
 /**
  * The byte table struct contains data to describe an abstract byte table,
  * that contains a given number of entries, of a constant size;
@@ -25,6 +48,42 @@ struct elf_table {
 
 };
 
+/**
+ * The loader sections struct caches the section header data used by loading
+ * phases, as a struct of arrays indexed by section index, so that each phase
+ * only scans the fields it requires, and never reads raw section headers;
+ */
+struct loader_sections {
+	
+	/*The number of sections;*/
+	u16 s_count;
+	
+	/*Section addresses in RAM, null if the section is not in RAM;*/
+	u64 *s_addr;
+	
+	/*Section sizes in bytes;*/
+	u64 *s_size;
+	
+	/*Section flags;*/
+	u64 *s_flags;
+	
+	/*Section entry sizes;*/
+	u64 *s_entsize;
+	
+	/*Section types;*/
+	u32 *s_type;
+	
+	/*Section links;*/
+	u32 *s_link;
+	
+	/*Section extra information;*/
+	u32 *s_info;
+	
+	/*Section names offsets in the section names table;*/
+	u32 *s_name;
+	
+};
+
 /**
  * The loader symbol struct either provides or receives definition for a symbol
  * in memory;
@@ -46,6 +105,134 @@ struct loader_symbol {
 	
 };
 
+/**
+ * The loader counter struct selects a function whose calls must be counted;
+ * imports and queries of the function are routed through a thunk that
+ * increments the counter then jumps to the function;
+ */
+struct loader_counter {
+	
+	/*counters are referenced in a linked list;*/
+	struct loader_counter *c_next;
+	
+	/*The name of the function;*/
+	const char *c_name;
+	
+	/*The number of calls, incremented atomically by thunks;*/
+	u64 c_count;
+	
+	/*The number of thunks routing calls to the counter;*/
+	u32 c_thunks;
+	
+};
+
+/**
+ * The loader profile struct lists the hot functions of a file, hottest
+ * first; when a streamed file is loaded, the code sections of these
+ * functions, named .text.<function> by -ffunction-sections, are packed in a
+ * hot region in this order, and .text.unlikely and .text.cold sections in a
+ * cold region;
+ */
+struct loader_profile {
+	
+	/*The names of hot functions, hottest first;*/
+	const char **p_functions;
+	
+	/*The number of hot functions;*/
+	u32 p_count;
+	
+};
+
+/**
+ * loader_counter_read : returns the number of calls counted by @counter;
+ */
+#define loader_counter_read(counter) \
+	__atomic_load_n(&(counter)->c_count, __ATOMIC_RELAXED)
+
+/**
+ * The loader allocator struct provides the loader with memory; it is used to
+ * place sections when the file is not mapped in RAM, and loader metadata;
+ * a load uses a code allocator, a data allocator and a scratch allocator,
+ * see loading_env;
+ */
+struct loader_allocator {
+	
+	/*The allocator's private data, provided to each call;*/
+	void *a_handle;
+	
+	/*
+	 * Allocate @size bytes aligned on @align, for a section whose header
+	 * flags are @flags; flags are null for loader metadata; must return 0 if
+	 * no memory is available;
+	 */
+	void *(*a_alloc)(void *handle, usize size, usize align, u64 flags);
+	
+};
+
+/**
+ * The loader stream struct gives access to the content of an elf file that
+ * is not mapped in RAM, by file offset;
+ */
+struct loader_stream {
+	
+	/*The stream's private data, provided to each call;*/
+	void *s_handle;
+	
+	/*
+	 * Copy @size bytes at file offset @offset to @dst; must return 0 if all
+	 * bytes were read, and 1 if not;
+	 */
+	u8 (*s_read)(void *handle, void *dst, u64 offset, usize size);
+	
+};
+
+/**
+ * The loader page report struct describes how many bytes of a mapped file
+ * stay shared with the page cache, and how many are privately copied because
+ * the load writes to them;
+ */
+struct loader_page_report {
+	
+	/*The number of bytes in pages the load never writes to;*/
+	usize p_shared;
+	
+	/*The number of bytes in pages the load writes to;*/
+	usize p_private;
+	
+};
+
+/**
+ * The loader error struct locates the error that stopped a load;
+ */
+struct loader_error {
+	
+	/*The error code, null if no error occurred;*/
+	u8 e_code;
+	
+	/*The loading phase the error occurred in;*/
+	u8 e_phase;
+	
+	/*The index of the section that was processed;*/
+	u16 e_section;
+	
+	/*The position from 1 of the symbol or relocation processed, 0 if none;*/
+	u32 e_entry;
+	
+};
+
+/*
+ * Loading phases;
+ */
+
+/*Sections assignment;*/
+#define LOADER_PHASE_SECTIONS ((u8) 1)
+
+/*Symbols assignment;*/
+#define LOADER_PHASE_SYMBOLS ((u8) 2)
+
+/*Relocations application;*/
+#define LOADER_PHASE_RELOCATIONS ((u8) 3)
+
 /*
  * Loading error codes;
  */
@@ -74,6 +261,82 @@ struct loader_symbol {
 /*A relocation symbol had a null address;*/
 #define LOADER_ERROR_REL_VALUE_OVERFLOW ((u8) 8)
 
+/*A stream read failed or returned less bytes than required;*/
+#define LOADER_ERROR_STREAM_READ ((u8) 9)
+
+/*The allocator could not provide the required memory;*/
+#define LOADER_ERROR_ALLOCATION ((u8) 10)
+
+/*An operation reserved to files mapped in RAM was required on a stream;*/
+#define LOADER_ERROR_NOT_MAPPED ((u8) 11)
+
+/*The file holds more than one symbol table;*/
+#define LOADER_ERROR_MULTIPLE_SYMBOL_TABLES ((u8) 12)
+
+/*A relocation wrote past the end of the section to relocate;*/
+#define LOADER_ERROR_REL_BAD_OFFSET ((u8) 13)
+
+/*An image is ill-formed, or a file can't be converted to an image;*/
+#define LOADER_ERROR_BAD_IMAGE ((u8) 14)
+
+/*A file is prepared without a module, a registry to publish it in, or a
+ * reader slot;*/
+#define LOADER_ERROR_NOT_PUBLISHABLE ((u8) 15)
+
+/*A common symbol's alignment is not a power of 2;*/
+#define LOADER_ERROR_BAD_COMMON_ALIGN ((u8) 16)
+
+/*A prepared file's code intersects the code of a published module;*/
+#define LOADER_ERROR_CODE_OVERLAP ((u8) 17)
+
+/*A common symbol is larger or more aligned than the copy a previous load
+ * placed;*/
+#define LOADER_ERROR_BAD_COMMON_SIZE ((u8) 18)
+
+/*The number of relocation types the processor gives the width of;*/
+#define LOADER_RELOCATION_TYPES 64
+
+
+/*
+ * Loading options;
+ */
+
+/*
+ * Sort relocation tables by offset before applying them, so that each page
+ * of a relocated section is written once; unsorted tables are written;
+ */
+#define LOADER_FLAG_SORT_RELOCATIONS ((u32) (1 << 0))
+
+/*
+ * Only load sections reachable through relocations from the sections
+ * defining the symbols of r_roots; other SHF_ALLOC sections are neither
+ * allocated nor relocated;
+ */
+#define LOADER_FLAG_GC_SECTIONS ((u32) (1 << 1))
+
+/*
+ * Split SHF_MERGE sections in entries, and resolve symbols and section
+ * relocations to the first identical entry of r_merge, or of the load if
+ * r_merge is null; only entries that are new are allocated; sections that
+ * relocation tables target are loaded whole;
+ */
+#define LOADER_FLAG_MERGE_SECTIONS ((u32) (1 << 2))
+
+/*
+ * Load each COMDAT group once per r_groups table; sections of groups already
+ * in the table are neither allocated nor relocated, and symbols they define
+ * resolve to the first copy;
+ */
+#define LOADER_FLAG_DEDUPE_GROUPS ((u32) (1 << 3))
+
+/*
+ * Fold read-only code sections into the first copy of r_folds, or of the
+ * load if r_folds is null, with the same bytes and the same relocation
+ * targets; folded sections are not relocated, and symbols they define
+ * resolve to the first copy;
+ */
+#define LOADER_FLAG_FOLD_CODE ((u32) (1 << 4))
+
 
 /**
  * The loading environment contains data related to a relocatable elf file
@@ -83,38 +346,194 @@ struct loading_env {
 
 	/*The elf header;*/
 	struct elf64_hdr *r_hdr;
+	
+	/*The stream the file is read from, null if the file is mapped in RAM;*/
+	struct loader_stream *r_stream;
+	
+	/*The allocator providing memory to executable sections of a streamed
+	 * load, set by initializers, may be changed by the caller;*/
+	struct loader_allocator *r_code;
+	
+	/*The allocator providing memory to other sections of a streamed load,
+	 * and to metadata that outlives the load, like module indexes and
+	 * published group symbols; set by initializers, may be changed by the
+	 * caller;*/
+	struct loader_allocator *r_data;
+	
+	/*The allocator providing memory to metadata only used during the load,
+	 * like the section cache, non-allocated sections and hash tables of the
+	 * load; all of it can be freed at once when the load completes, for
+	 * example by resetting a loader arena;*/
+	struct loader_allocator *r_scratch;
+	
+	/*A copy of the elf header, referenced by r_hdr for a streamed load;*/
+	struct elf64_hdr r_ehdr;
 
 	/*Section header table descriptor;*/
 	struct elf_table r_shtable;
 	
+	/*Section header data cache;*/
+	struct loader_sections r_sections;
+	
 	/*The an internal context to restore in case of internal error;*/
 	struct rest_ctx *r_error_ctx;
+	
+	/*The location of the last loading error;*/
+	struct loader_error r_error;
+	
+	/*Loading options, reset by initializers, set by the caller;*/
+	u32 r_flags;
+	
+	/*The trace to record events in, reset by initializers, set by the caller;*/
+	struct loader_trace *r_trace;
+	
+	/*The stats to update, reset by initializers, set by loader_stats_start;*/
+	struct loader_stats *r_stats;
+	
+	/*The queries section collection starts from, set by the caller or by
+	 * loader_load;*/
+	struct loader_symbol *r_roots;
+	
+	/*The process-wide merge pool, reset by initializers, set by the caller;
+	 * loads sharing it must be serialized;*/
+	struct loader_merge_pool *r_merge;
+	
+	/*For each section, the map of its merged entries, null if no section is
+	 * merged;*/
+	struct loader_merge_map *r_maps;
+	
+	/*The process-wide group table, reset by initializers, set by the caller;
+	 * loads sharing it must be serialized;*/
+	struct loader_group_table *r_groups;
+	
+	/*For each section, 0 or the 1-based slot of its group in r_groups,
+	 * shifted left by one, and ored with 1 if the group is discarded;*/
+	u32 *r_members;
+	
+	/*The process-wide fold table, reset by initializers, set by the caller;
+	 * loads sharing it must be serialized;*/
+	struct loader_fold_table *r_folds;
+	
+	/*The module to index exports in, reset by initializers, set by the
+	 * caller;*/
+	struct loader_module *r_module;
+	
+	/*The registry undefined symbols missing from definitions are searched
+	 * in, reset by initializers, set by the caller;*/
+	struct loader_registry *r_registry;
+	
+	/*The reader slot of the loading thread in r_registry, reset by
+	 * initializers, set by the caller with r_registry;*/
+	struct loader_registry_reader *r_reader;
+	
+	/*The epoch of the view of r_registry the view prepared by
+	 * loader_prepare was filled from;*/
+	u32 r_epoch;
+	
+	/*The hook notified of loaded functions once relocations are applied,
+	 * reset by initializers, set by the caller;*/
+	struct loader_code_hook *r_hook;
+	
+	/*The functions whose calls are counted, reset by initializers, set by
+	 * the caller;*/
+	struct loader_counter *r_counters;
+	
+	/*The profile code sections are ordered by, reset by initializers, set
+	 * by the caller;*/
+	struct loader_profile *r_profile;
+	
+	/*The link set's common symbol table, reset by initializers, set by the
+	 * caller; loads sharing it must be serialized;*/
+	struct loader_common_table *r_commons;
+	
+	/*The block common symbols are placed in, null until they are, reset
+	 * by initializers;*/
+	u8 *r_common_block;
+	
+	/*The duration of the initialization;*/
+	u64 r_init_time;
 
 };
 
 /**
- * loader_init : initializes the loading environment for the provided elf file;
+ * loader_init : initializes the loading environment for the provided elf file,
+ * and builds the section cache;
  * @param env : the environment to initialize;
  * @param ram_start : the address of the file's first byte in RAM;
- * @param file_size : the size in bytes of the file in RAM;
+ * @param alloc : the allocator providing memory to the load, used as code,
+ * data and scratch allocator until the caller changes them;
+ * @return 0 if the environment was initialized, LOADER_ERROR_ALLOCATION if
+ * not;
+ * The @alloc parameter and the return value were added with the section
+ * cache : this breaks callers of the former loader_init(env, ram_start),
+ * that returned nothing; they must provide an allocator, and check the
+ * result;
  */
-void loader_init(
+u8 loader_init(
 		struct loading_env *env,
-		void *ram_start
+		void *ram_start,
+		struct loader_allocator *alloc
+);
+
+/**
+ * loader_init_stream : initializes the loading environment for an elf file
+ * that is not mapped in RAM; the elf header, the section header table and the
+ * section header string table are read from @stream, and the section cache is
+ * built; other sections will be read by loader_assign_sections, only if the
+ * load requires them;
+ * @param env : the environment to initialize;
+ * @param stream : the stream to read the file from;
+ * @param alloc : the allocator providing memory to the load, used as code,
+ * data and scratch allocator until the caller changes them;
+ * @return 0 if the environment was initialized, LOADER_ERROR_STREAM_READ or
+ * LOADER_ERROR_ALLOCATION if not;
+ */
+u8 loader_init_stream(
+		struct loading_env *env,
+		struct loader_stream *stream,
+		struct loader_allocator *alloc
+);
+
+/**
+ * loader_stats_start : resets @stats and attaches them to @env, so that
+ * loading phases update them; the duration of the initialization is saved;
+ * must be called after the environment is initialized;
+ * @param env : the loading environment;
+ * @param stats : the stats to reset and attach;
+ */
+void loader_stats_start(
+	struct loading_env *env,
+	struct loader_stats *stats
 );
 
 /**
  * loader_assign_sections : update all section's values to their RAM addresses;
+ * for a streamed load, SHF_ALLOC sections, symbol tables, their string tables
+ * and relocation tables that apply to SHF_ALLOC sections are allocated and
+ * read to their final location; other sections are not read;
  * @param env : the loading environment;
- * @param env : an error descriptor;
- * @return 0 if all section were assigned correctly, 1 if an error occurred;
- * if the latter occurs, @err will be initialized with the error context for
- * further debug; any error should halt the loading;
+ * @return 0 if all section were assigned correctly, a loading error code if
+ * not; the error is located by env->r_error; any error should halt the
+ * loading;
 */
 u8 loader_assign_sections(
 		struct loading_env *env
 );
 
+/**
+ * loader_declare_commons : declares the common symbols of the file in
+ * env->r_commons, so that each common symbol of a link set is placed with its
+ * largest size and alignment; the loads of the link set must all declare
+ * their common symbols before any of them places its own; the symbol table
+ * and its string table of a streamed file are read;
+ * @param env : the loading environment, whose r_commons is set;
+ * @return 0 if common symbols were declared, a loading error code if not;
+ * the error is located by env->r_error;
+ */
+u8 loader_declare_commons(
+	struct loading_env *env
+);
+
 /**
  * loader_assign_symbols : for each symbol in the environment :
  * - if the symbol is defined updates the symbol's address internally and
@@ -130,9 +549,9 @@ u8 loader_assign_sections(
  * @param queries : a set of symbols the executable may define; if defined
  * symbols with matching names are found in the executable, the list will be
  * updated with the value of the symbol in the executable;
- * @return 0 if all symbols had their value assigned, or, if a symbol table's
- * string table index was invalid (only source of error), the index of the
- * symbol table's section header; this error should stop the loading;
+ * @return 0 if all symbols had their value assigned, a loading error code if
+ * not; the error is located by env->r_error; any error should halt the
+ * loading;
  */
 u8 loader_assign_symbols(
 	struct loading_env *env,
@@ -152,5 +571,142 @@ u8 loader_assign_symbols(
  */
 u8 loader_apply_relocations(struct loading_env *env);
 
+/**
+ * loader_load : loads the file in a single pass : assigns sections, then
+ * classifies sections once, assigning the symbol table when the first
+ * relocation table requiring it is met, and applying each relocation table
+ * as it is met; this is equivalent to calling loader_assign_sections,
+ * loader_assign_symbols and loader_apply_relocations in order;
+ * @param env : the loading environment;
+ * @param defs : a list of defined symbols, see loader_assign_symbols;
+ * @param queries : a set of symbols the file may define, see
+ * loader_assign_symbols;
+ * @return 0 if the file was loaded, a loading error code if not; the error is
+ * located by env->r_error;
+ */
+u8 loader_load(
+	struct loading_env *env,
+	struct loader_symbol *defs,
+	struct loader_symbol *queries
+);
+
+/**
+ * loader_prepare : loads the file with loader_load, then prepares its
+ * publication : @view is filled with the modules of env->r_registry
+ * followed by env->r_module, in which the file's exports are indexed; none
+ * of it is visible to lookups of the registry, so that this can run on a
+ * worker, and the file is published by loader_commit; loads that share a
+ * group table, a merge pool or a fold table must still be serialized;
+ * @param env : the loading environment, whose module, registry and reader
+ * are set;
+ * @param defs : a list of defined symbols, see loader_assign_symbols;
+ * @param queries : a set of symbols the file may define, see
+ * loader_assign_symbols;
+ * @param view : the view to fill, neither published nor used by lookups;
+ * @return 0 if the file was prepared, LOADER_ERROR_NOT_PUBLISHABLE,
+ * LOADER_ERROR_ALLOCATION if @view is too small, LOADER_ERROR_CODE_OVERLAP
+ * if a section of the file's code intersects a published module's code, or
+ * a loading error code if not; the error is located by env->r_error;
+ */
+u8 loader_prepare(
+	struct loading_env *env,
+	struct loader_symbol *defs,
+	struct loader_symbol *queries,
+	struct loader_registry_view *view
+);
+
+/**
+ * loader_commit : publishes the file prepared by loader_prepare, by
+ * publishing @view in env->r_registry, in constant time if the previous
+ * publication was retired; if another view was published since the
+ * preparation, @view is filled again first; the returned view can be reused
+ * once loader_registry_retire completes, so that two views are enough to
+ * prepare files one after the other;
+ * @param env : the loading environment, prepared by loader_prepare;
+ * @param reader : the reader slot of the calling thread, that fills @view
+ * again; env->r_reader belongs to the thread that ran loader_prepare;
+ * @param view : the view filled by loader_prepare;
+ * @return the previous view, or null if @view became too small, or if the
+ * code of a module published meanwhile intersects the file's code, in which
+ * case nothing is published;
+ */
+struct loader_registry_view *loader_commit(
+	struct loading_env *env,
+	struct loader_registry_reader *reader,
+	struct loader_registry_view *view
+);
+
+/**
+ * loader_dirty_pages : for a file mapped in RAM, determines which pages of the
+ * file the load writes to : pages holding symbol tables, writable sections or
+ * the site of a relocation; other pages can be mapped directly from the file
+ * and shared between all instances, written ones must be private;
+ * must be called after loader_init and after options are set, before any
+ * other loading step;
+ * @param env : the loading environment;
+ * @param file_size : the size in bytes of the mapped file;
+ * @param page_shift : the base 2 logarithm of the page size;
+ * @param bitmap : a bitmap with one bit per page of the file, set by this
+ * function if the page is written to, cleared if not;
+ * @param report : updated with the number of shared and private bytes;
+ * @return 0 if the bitmap was computed, LOADER_ERROR_NOT_MAPPED if the file is
+ * streamed, or a loading error code if the file is ill-formed;
+ */
+u8 loader_dirty_pages(
+	struct loading_env *env,
+	usize file_size,
+	u8 page_shift,
+	u8 *bitmap,
+	struct loader_page_report *report
+);
+
+/**
+ * loader_image_build : converts a streamed file, whose sections and symbols
+ * are assigned, into an image; relocations that do not depend on the
+ * image's address are applied to the file's sections, others are saved in
+ * the image; undefined symbols become imports and global definitions
+ * become exports; the image is allocated by the scratch allocator;
+ * must be called after loader_assign_symbols, instead of
+ * loader_apply_relocations;
+ * @param env : the loading environment;
+ * @param base : the start of the range sections of the file are allocated
+ * in; other allocations of the load must not be in the range;
+ * @param size : the size of the range;
+ * @param image : updated with the image;
+ * @param image_size : updated with the size of the image;
+ * @return 0 if the image was built, a loading error code if not; the error
+ * is located by env->r_error;
+ */
+u8 loader_image_build(
+	struct loading_env *env,
+	u64 base,
+	u64 size,
+	struct loader_image_hdr **image,
+	usize *image_size
+);
+
+/**
+ * loader_image_load : loads an image built by loader_image_build : the
+ * image is copied in memory provided by @alloc, relr words and fixups are
+ * applied, and exports are matched with @queries;
+ * @param image : the image, aligned on 8 bytes;
+ * @param image_size : the size of the image;
+ * @param alloc : the allocator providing memory to the image;
+ * @param defs : a list of defined symbols, imports are resolved in;
+ * @param queries : a set of symbols the image may export; if exported, they
+ * are defined with the address of the export;
+ * @param base : updated with the address of the loaded image;
+ * @return 0 if the image was loaded, LOADER_ERROR_BAD_IMAGE,
+ * LOADER_ERROR_ALLOCATION, LOADER_ERROR_REL_SYMBOL_NULL_ADDRESS,
+ * LOADER_ERROR_REL_BAD_TYPE or LOADER_ERROR_REL_VALUE_OVERFLOW if not;
+ */
+u8 loader_image_load(
+	const struct loader_image_hdr *image,
+	usize image_size,
+	struct loader_allocator *alloc,
+	struct loader_symbol *defs,
+	struct loader_symbol *queries,
+	void **base
+);
 
 #endif /*KERNEL_TK_LOADER_H*/
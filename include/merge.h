@@ -0,0 +1,144 @@
+/*merge.h - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#ifndef KERNEL_TK_MERGE_H
+#define KERNEL_TK_MERGE_H
+
+#include <table.h>
+
+/**
+ * The loader merge entry struct references a constant or a string of a loaded
+ * SHF_MERGE section;
+ */
+struct loader_merge_entry {
+	
+	/*The slot header, that holds the entry's hash;*/
+	struct loader_hash_slot m_slot;
+	
+	/*The entry's first byte;*/
+	const u8 *m_data;
+	
+	/*The entry's size in bytes;*/
+	u64 m_size;
+	
+};
+
+/**
+ * The loader merge pool struct is a hash set of merge entries; a pool can be
+ * shared by loads, so that identical constants and strings of all modules are
+ * used once; entries reference loaded sections : before a module is
+ * unloaded, its entries must be removed with loader_merge_pool_remove, and
+ * modules that resolved to them unloaded; the pool takes no lock : loads
+ * that share it, including loads prepared on workers, and removals must be
+ * serialized by the caller;
+ */
+struct loader_merge_pool {
+	
+	/*The hash table of struct loader_merge_entry slots;*/
+	struct loader_hash_table p_entries;
+	
+};
+
+/**
+ * The loader merge piece struct maps an entry of a SHF_MERGE section of a
+ * file to the pooled entry with the same content;
+ */
+struct loader_merge_piece {
+	
+	/*The entry's offset in the section of the file;*/
+	u64 p_offset;
+	
+	/*The address of the pooled entry;*/
+	u64 p_addr;
+	
+};
+
+/**
+ * The loader merge map struct maps the entries of a merged section, sorted by
+ * offset;
+ */
+struct loader_merge_map {
+	
+	/*The section's pieces, null if the section is not merged;*/
+	struct loader_merge_piece *m_pieces;
+	
+	/*The number of pieces;*/
+	u64 m_count;
+	
+};
+
+/**
+ * loader_merge_pool_init : initializes @pool with the slot array @entries;
+ * @param pool : the pool to initialize;
+ * @param entries : the slot array;
+ * @param mask : the number of slots minus one; must be 2^n - 1;
+ */
+void loader_merge_pool_init(
+	struct loader_merge_pool *pool,
+	struct loader_merge_entry *entries,
+	u32 mask
+);
+
+/**
+ * loader_merge_find : searches @pool for an entry with the content of the
+ * @size bytes at @data; if none is found, and the pool is less than 3/4 full,
+ * @data is inserted;
+ * @param pool : the pool to search;
+ * @param data : the entry's content;
+ * @param size : the entry's size;
+ * @param probes : incremented with the number of slots probed;
+ * @return the address of the pooled entry with the same content, @data if
+ * there is none;
+ */
+const u8 *loader_merge_find(
+	struct loader_merge_pool *pool,
+	const u8 *data,
+	u64 size,
+	u32 *probes
+);
+
+/**
+ * loader_merge_lookup : searches @pool for an entry with the content of the
+ * @size bytes at @data, without inserting it;
+ * @param pool : the pool to search;
+ * @param data : the entry's content;
+ * @param size : the entry's size;
+ * @param probes : incremented with the number of slots probed;
+ * @return the address of the pooled entry with the same content, null if
+ * there is none;
+ */
+const u8 *loader_merge_lookup(
+	struct loader_merge_pool *pool,
+	const u8 *data,
+	u64 size,
+	u32 *probes
+);
+
+/**
+ * loader_merge_map_addr : returns the address @offset designates in the
+ * section mapped by @map : the address of the pooled copy of the entry
+ * containing @offset, plus the offset in the entry;
+ * @param map : the map of a merged section;
+ * @param offset : an offset in the section of the file;
+ * @return the address, 0 if @map has no pieces;
+ */
+u64 loader_merge_map_addr(
+	const struct loader_merge_map *map,
+	u64 offset
+);
+
+/**
+ * loader_merge_pool_remove : removes from @pool the entries in
+ * [@start, @end[, so that the memory of their section can be freed;
+ * @param pool : the pool;
+ * @param start : the first byte of the memory to free;
+ * @param end : the byte following the memory to free;
+ * @return the number of entries removed;
+ */
+u32 loader_merge_pool_remove(
+	struct loader_merge_pool *pool,
+	u64 start,
+	u64 end
+);
+
+
+#endif /*KERNEL_TK_MERGE_H*/
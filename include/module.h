@@ -0,0 +1,218 @@
+/*module.h - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#ifndef KERNEL_TK_MODULE_H
+#define KERNEL_TK_MODULE_H
+
+#include <table.h>
+
+/**
+ * The loader export struct references a global definition of a loaded
+ * module;
+ */
+struct loader_export {
+	
+	/*The slot header, that holds the hash of the definition's name;*/
+	struct loader_hash_slot e_slot;
+	
+	/*The address of the definition;*/
+	void *e_addr;
+	
+	/*The offset of the definition's name in the module's name block;*/
+	u32 e_name;
+	
+};
+
+/**
+ * The loader function struct references a function of a loaded module;
+ */
+struct loader_function {
+	
+	/*The address of the function;*/
+	u64 f_addr;
+	
+	/*The size of the function, null if unknown;*/
+	u64 f_size;
+	
+	/*The offset of the function's name in the module's name block;*/
+	u32 f_name;
+	
+};
+
+/**
+ * The loader code range struct locates a contiguous part of the code of a
+ * loaded module; the code allocator may place the sections of several
+ * modules between each other, so that a module's code is a list of ranges;
+ */
+struct loader_code_range {
+	
+	/*The first byte of the range;*/
+	u64 c_start;
+	
+	/*The byte following the range;*/
+	u64 c_end;
+	
+	/*The module whose code contains the range;*/
+	struct loader_module *c_module;
+	
+};
+
+/**
+ * The loader module struct indexes the global definitions of a loaded
+ * module, in a hash table of exports, and its functions and code ranges, in
+ * tables sorted by address; names are copied in a block, so that neither the symbol table
+ * nor the string table must stay in RAM;
+ */
+struct loader_module {
+	
+	/*The hash table of struct loader_export slots;*/
+	struct loader_hash_table m_exports;
+	
+	/*The functions, sorted by address once the module is sorted;*/
+	struct loader_function *m_functions;
+	
+	/*The block containing names, null-terminated;*/
+	char *m_names;
+	
+	/*The code ranges, sorted by address once the module is sorted;*/
+	struct loader_code_range *m_ranges;
+	
+	/*The number of functions;*/
+	u32 m_nb_functions;
+	
+	/*The number of code ranges;*/
+	u32 m_nb_ranges;
+	
+	/*The number of bytes of the name block in use;*/
+	u32 m_length;
+	
+};
+
+/**
+ * The loader code hook struct is notified of the functions of loaded
+ * modules, for profilers or debuggers to symbolize their code;
+ */
+struct loader_code_hook {
+	
+	/*The handle to provide to notification functions;*/
+	void *h_handle;
+	
+	/*Notifies that the function @name of @size bytes is loaded at @addr,
+	 * relocated, and can be read;*/
+	void (*h_load)(void *handle, const char *name, u64 addr, u64 size);
+	
+	/*Notifies that the function @name at @addr is about to be unloaded;*/
+	void (*h_unload)(void *handle, const char *name, u64 addr, u64 size);
+	
+};
+
+/**
+ * loader_module_init : initializes @module with the slot array @exports,
+ * the function array @functions, the range array @ranges and the name block
+ * @names; the module has no code;
+ * @param module : the module to initialize;
+ * @param exports : the slot array, with at least 4/3 slots per export;
+ * @param mask : the number of slots minus one; must be 2^n - 1;
+ * @param functions : the function array, large enough for all functions;
+ * @param ranges : the range array, large enough for all code ranges;
+ * @param names : the name block, large enough for all names, terminators
+ * included;
+ */
+void loader_module_init(
+	struct loader_module *module,
+	struct loader_export *exports,
+	u32 mask,
+	struct loader_function *functions,
+	struct loader_code_range *ranges,
+	char *names
+);
+
+/**
+ * loader_module_export : exports @name at @addr from @module, copying the
+ * name in the name block; if @name is already exported, or if the slot array
+ * is 3/4 full, nothing is done;
+ * @param module : the module;
+ * @param name : the name of the definition;
+ * @param addr : the address of the definition, not null;
+ */
+void loader_module_export(
+	struct loader_module *module,
+	const char *name,
+	void *addr
+);
+
+/**
+ * loader_module_function : adds the function @name at @addr to @module,
+ * copying the name in the name block; functions must be sorted before
+ * being searched;
+ * @param module : the module;
+ * @param name : the name of the function;
+ * @param addr : the address of the function;
+ * @param size : the size of the function, null if unknown;
+ */
+void loader_module_function(
+	struct loader_module *module,
+	const char *name,
+	u64 addr,
+	u64 size
+);
+
+/**
+ * loader_module_code : adds the code range [@start, @end[ to @module; ranges
+ * must be sorted before being searched or registered;
+ * @param module : the module;
+ * @param start : the first byte of the range;
+ * @param end : the byte following the range;
+ */
+void loader_module_code(
+	struct loader_module *module,
+	u64 start,
+	u64 end
+);
+
+/**
+ * loader_module_sort : sorts the functions and the code ranges of @module by
+ * address, and merges contiguous ranges;
+ * @param module : the module;
+ */
+void loader_module_sort(
+	struct loader_module *module
+);
+
+/**
+ * loader_module_function_at : searches the sorted functions of @module for
+ * the function containing @addr, in O(log n); a function of unknown size
+ * extends to the next one; performs no write, and can be called from a
+ * signal handler;
+ * @param module : the module to search;
+ * @param addr : the address to search for;
+ * @return the function, null if no function contains @addr;
+ */
+const struct loader_function *loader_module_function_at(
+	const struct loader_module *module,
+	u64 addr
+);
+
+/**
+ * loader_module_lookup : searches @module for the export @name;
+ * @param module : the module to search;
+ * @param name : the name of the definition;
+ * @return the address of the definition, null if it is not exported;
+ */
+void *loader_module_lookup(
+	const struct loader_module *module,
+	const char *name
+);
+
+/**
+ * loader_module_unload : notifies @hook that each function of @module is
+ * about to be unloaded; to be called by the caller before it frees the
+ * module's code;
+ * @param module : the module;
+ * @param hook : the hook to notify;
+ */
+void loader_module_unload(
+	const struct loader_module *module,
+	const struct loader_code_hook *hook
+);
+
+#endif /*KERNEL_TK_MODULE_H*/
@@ -0,0 +1,51 @@
+/*probe.h - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#ifndef KERNEL_TK_PROBE_H
+#define KERNEL_TK_PROBE_H
+
+/*
+ * Static tracepoints, in the rmld provider, for bpftrace, perf or systemtap;
+ * probes are compiled in if LOADER_USDT is defined and <sys/sdt.h> is found,
+ * and compile to nothing if not; an unattached probe costs a nop;
+ *
+ * rmld:load_start(env, sections) : loader_load starts;
+ * rmld:load_end(env, error) : loader_load ends;
+ * rmld:phase_start(env, phase) : a phase starts;
+ * rmld:phase_end(env, phase, error, count) : a phase ends; count is the
+ * number of sections, symbols or relocations of the phase;
+ * rmld:overflow(env, section, entry, type) : a relocation value overflowed;
+ *
+ * env identifies the loading environment, that loads a single module;
+ */
+
+#if defined(LOADER_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define LOADER_PROBES 1
+#endif
+#endif
+
+#ifndef LOADER_PROBES
+#define LOADER_PROBES 0
+#endif
+
+#if LOADER_PROBES
+
+#define LOADER_PROBE2(name, a, b) DTRACE_PROBE2(rmld, name, a, b)
+#define LOADER_PROBE4(name, a, b, c, d) DTRACE_PROBE4(rmld, name, a, b, c, d)
+
+#else
+
+/*Arguments are not evaluated, only referenced;*/
+#define LOADER_PROBE2(name, a, b) \
+	do { (void) sizeof(a); (void) sizeof(b); } while (0)
+#define LOADER_PROBE4(name, a, b, c, d) \
+	do { \
+		(void) sizeof(a); (void) sizeof(b); \
+		(void) sizeof(c); (void) sizeof(d); \
+	} while (0)
+
+#endif
+
+
+#endif /*KERNEL_TK_PROBE_H*/
@@ -0,0 +1,242 @@
+/*registry.h - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#ifndef KERNEL_TK_REGISTRY_H
+#define KERNEL_TK_REGISTRY_H
+
+#include <module.h>
+
+/*A view can't contain all modules;*/
+#define LOADER_REGISTRY_FULL ((u8) 1)
+
+/*A code range of a module intersects a code range of a published module;*/
+#define LOADER_REGISTRY_OVERLAP ((u8) 2)
+
+/*The size of a cache line, that reader slots are padded to;*/
+#define LOADER_CACHE_LINE 64
+
+/**
+ * The loader registry view struct is an immutable list of modules; a view
+ * is never modified once published;
+ */
+struct loader_registry_view {
+	
+	/*The modules, searched in order;*/
+	struct loader_module **v_modules;
+	
+	/*The code ranges of the modules, sorted by address; ranges are
+	 * disjoint, but ranges of different modules may alternate;*/
+	const struct loader_code_range **v_ranges;
+	
+	/*The number of modules;*/
+	u32 v_count;
+	
+	/*The number of modules v_modules can contain;*/
+	u32 v_size;
+	
+	/*The number of code ranges;*/
+	u32 v_nb_ranges;
+	
+	/*The number of code ranges v_ranges can contain;*/
+	u32 v_range_size;
+	
+};
+
+/**
+ * The loader registry reader struct is the slot a thread, or a cpu, records
+ * its lookups in; it fills a cache line, so that lookups of different
+ * threads write no common line; a slot is used by one thread at a time, and
+ * by the signal handlers that interrupt it;
+ */
+struct loader_registry_reader {
+	
+	/*Set while a lookup is in progress;*/
+	u32 d_active;
+	
+	/*The epoch the lookup in progress started in;*/
+	u32 d_epoch;
+	
+	/*Padding up to the cache line;*/
+	u8 d_pad[LOADER_CACHE_LINE - 2 * sizeof(u32)];
+	
+} __attribute__((aligned(LOADER_CACHE_LINE)));
+
+/**
+ * The loader registry struct publishes a view of the modules whose exports
+ * are visible to the process; lookups take no lock, and only record the
+ * epoch they started in in their reader slot; writers are serialized by a
+ * spin lock, publish a new view, and scan reader slots until lookups of the
+ * previous epoch complete before returning the previous view to the caller;
+ * a view can also be prepared without the lock and committed without
+ * waiting, the wait being deferred to loader_registry_retire;
+ */
+struct loader_registry {
+	
+	/*The published view;*/
+	struct loader_registry_view *r_view;
+	
+	/*The reader slots, one per thread or cpu that searches the registry;*/
+	struct loader_registry_reader *r_readers;
+	
+	/*The number of reader slots;*/
+	u32 r_nb_readers;
+	
+	/*The epoch, incremented by each publication;*/
+	u32 r_epoch;
+	
+	/*The writers lock;*/
+	u32 r_lock;
+	
+};
+
+/**
+ * The loader addr struct describes the location of an address in the code
+ * of a registered module;
+ */
+struct loader_addr {
+	
+	/*The module whose code contains the address;*/
+	struct loader_module *a_module;
+	
+	/*The name of the function containing the address, null if unknown;*/
+	const char *a_function;
+	
+	/*The offset of the address in the function, or in its code range;*/
+	u64 a_offset;
+	
+};
+
+/**
+ * loader_registry_init : initializes @registry and publishes @view;
+ * @param registry : the registry to initialize;
+ * @param view : the initial view, its modules must be initialized and
+ * sorted, and its code ranges sorted and disjoint;
+ * @param readers : the reader slots, that lookups record themselves in;
+ * @param nb_readers : the number of reader slots;
+ */
+void loader_registry_init(
+	struct loader_registry *registry,
+	struct loader_registry_view *view,
+	struct loader_registry_reader *readers,
+	u32 nb_readers
+);
+
+/**
+ * loader_registry_add : publishes @view, filled with the modules of the
+ * current view followed by @module;
+ * @param registry : the registry;
+ * @param view : the view to fill and publish;
+ * @param module : the module to add, whose exports are indexed;
+ * @return the previous view, that lookups do not reference anymore, or null
+ * if @view is too small, or if a code range of @module intersects a
+ * module's, in which case nothing is published;
+ */
+struct loader_registry_view *loader_registry_add(
+	struct loader_registry *registry,
+	struct loader_registry_view *view,
+	struct loader_module *module
+);
+
+/**
+ * loader_registry_prepare : fills @view with the modules of the current view
+ * followed by @module, without publishing it; takes no lock and can run on
+ * a worker, concurrently with lookups and writers;
+ * @param registry : the registry;
+ * @param reader : the reader slot of the calling thread;
+ * @param view : the view to fill, neither published nor used by lookups;
+ * @param module : the module to add, whose exports are indexed;
+ * @param epoch : updated with the epoch of the view @view was filled from,
+ * to provide to loader_registry_commit;
+ * @return 0 if @view was filled, LOADER_REGISTRY_FULL if it is too small,
+ * or LOADER_REGISTRY_OVERLAP if a code range of @module intersects a
+ * module's;
+ */
+u8 loader_registry_prepare(
+	struct loader_registry *registry,
+	struct loader_registry_reader *reader,
+	struct loader_registry_view *view,
+	struct loader_module *module,
+	u32 *epoch
+);
+
+/**
+ * loader_registry_commit : publishes @view, prepared by
+ * loader_registry_prepare, if no view was published since; views are
+ * compared by epoch, not by address, as view buffers are reused; does not
+ * wait for lookups, and completes in constant time if the previous commit
+ * was retired;
+ * @param registry : the registry;
+ * @param view : the prepared view;
+ * @param epoch : the epoch of the view @view was prepared from;
+ * @return the previous view, that lookups may reference until
+ * loader_registry_retire completes, or null if another view was published
+ * since the preparation, in which case nothing is published;
+ */
+struct loader_registry_view *loader_registry_commit(
+	struct loader_registry *registry,
+	struct loader_registry_view *view,
+	u32 epoch
+);
+
+/**
+ * loader_registry_retire : waits for lookups that may reference the view
+ * replaced by the last publication; the view returned by
+ * loader_registry_commit can then be reused;
+ * @param registry : the registry;
+ */
+void loader_registry_retire(
+	struct loader_registry *registry
+);
+
+/**
+ * loader_registry_remove : publishes @view, filled with the modules of the
+ * current view except @module; group, merge and fold tables shared by loads
+ * are not updated : before the module's memory is freed, the caller removes
+ * its entries with loader_group_table_remove, loader_merge_pool_remove and
+ * loader_fold_table_remove;
+ * @param registry : the registry;
+ * @param view : the view to fill and publish;
+ * @param module : the module to remove;
+ * @return the previous view, that lookups do not reference anymore, or null
+ * if @view is too small, in which case nothing is published;
+ */
+struct loader_registry_view *loader_registry_remove(
+	struct loader_registry *registry,
+	struct loader_registry_view *view,
+	struct loader_module *module
+);
+
+/**
+ * loader_registry_lookup : searches the modules of @registry for the export
+ * @name, in order; may be called concurrently with lookups and writers;
+ * @param registry : the registry to search;
+ * @param reader : the reader slot of the calling thread;
+ * @param name : the name of the definition;
+ * @return the address of the definition, null if it is not exported;
+ */
+void *loader_registry_lookup(
+	struct loader_registry *registry,
+	struct loader_registry_reader *reader,
+	const char *name
+);
+
+/**
+ * loader_addr_lookup : searches the code ranges of @registry for the one
+ * containing @pc, then its module's function containing @pc, in O(log n);
+ * performs no lock nor allocation and can be called from a signal handler,
+ * even if it interrupted a lookup or a writer; names remain valid until the
+ * module is removed;
+ * @param registry : the registry to search;
+ * @param reader : the reader slot of the calling thread, possibly in use by
+ * the lookup the caller interrupted;
+ * @param pc : the address to locate;
+ * @param addr : the location where to save the location of @pc;
+ * @return 1 if a module contains @pc, 0 if not;
+ */
+u8 loader_addr_lookup(
+	struct loader_registry *registry,
+	struct loader_registry_reader *reader,
+	u64 pc,
+	struct loader_addr *addr
+);
+
+#endif /*KERNEL_TK_REGISTRY_H*/
@@ -0,0 +1,69 @@
+/*stats.h - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#ifndef KERNEL_TK_STATS_H
+#define KERNEL_TK_STATS_H
+
+#include <types.h>
+
+/*The number of relocation types counted separately; others share the last;*/
+#define LOADER_STATS_REL_TYPES 64
+
+/*The number of timed phases : init, sections, symbols and relocations;*/
+#define LOADER_STATS_PHASES 4
+
+/*The index of the init phase in phase timings;*/
+#define LOADER_STATS_INIT 0
+
+/**
+ * The loader stats struct is filled by a load with counters and phase
+ * timings; timings are expressed in processor-defined timestamp units
+ * (cycles on x86); phases other than init are indexed by their
+ * LOADER_PHASE_ value;
+ */
+struct loader_stats {
+	
+	/*The duration of each phase;*/
+	u64 st_time[LOADER_STATS_PHASES];
+	
+	/*The number of code bytes not used, because they were folded;*/
+	u64 st_folded_bytes;
+	
+	/*The number of symbols assigned;*/
+	u32 st_symbols;
+	
+	/*The number of lookups in definition or query lists;*/
+	u32 st_lookups;
+	
+	/*The number of string comparisons made by lookups;*/
+	u32 st_compares;
+	
+	/*The number of hash table probes made by lookups;*/
+	u32 st_probes;
+	
+	/*The number of relocations applied;*/
+	u32 st_relocations;
+	
+	/*The number of relocation values that overflowed their field;*/
+	u32 st_overflows;
+	
+	/*The number of merge entries resolved to an identical pooled entry;*/
+	u32 st_merged;
+	
+	/*The number of code sections folded into an identical copy;*/
+	u32 st_folded;
+	
+	/*The number of relocations applied, by type;*/
+	u32 st_rel_types[LOADER_STATS_REL_TYPES];
+	
+};
+
+/**
+ * loader_timestamp : returns the current value of a monotonic,
+ * high-resolution counter;
+ * This function is processor-defined;
+ * @return the current timestamp;
+ */
+u64 loader_timestamp(void);
+
+
+#endif /*KERNEL_TK_STATS_H*/
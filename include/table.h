@@ -0,0 +1,173 @@
+/*table.h - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#ifndef KERNEL_TK_TABLE_H
+#define KERNEL_TK_TABLE_H
+
+#include <types.h>
+
+/*The 32 bits FNV-1a offset basis, that hashes start from;*/
+#define LOADER_HASH_BASIS 2166136261u
+
+/**
+ * The loader hash slot struct is the header of each slot of a hash table; it
+ * must be the first member of the slot;
+ */
+struct loader_hash_slot {
+	
+	/*The hash of the slot's key;*/
+	u32 s_hash;
+	
+	/*Set if the slot is used;*/
+	u32 s_used;
+	
+};
+
+/**
+ * The loader hash table struct is an open addressing hash table of slots of
+ * a caller defined struct, probed linearly; the table is refused new slots
+ * once 3/4 full, so that probe sequences stay short;
+ */
+struct loader_hash_table {
+	
+	/*The slot array;*/
+	void *h_slots;
+	
+	/*The size of a slot;*/
+	u32 h_bsize;
+	
+	/*The number of slots minus one; the number of slots is a power of 2;*/
+	u32 h_mask;
+	
+	/*The number of used slots;*/
+	u32 h_used;
+	
+};
+
+/**
+ * loader_hash_slot_at : returns the slot at @index in @table;
+ */
+#define loader_hash_slot_at(table, index) \
+	((void *) ((u8 *) (table)->h_slots + (usize) (index) * (table)->h_bsize))
+
+/**
+ * loader_hash_bytes : returns @hash updated with the @size bytes at @data,
+ * as in FNV-1a;
+ * @param hash : the hash to update, LOADER_HASH_BASIS to start a hash;
+ * @param data : the bytes to hash;
+ * @param size : the number of bytes to hash;
+ * @return the updated hash;
+ */
+u32 loader_hash_bytes(
+	u32 hash,
+	const void *data,
+	u64 size
+);
+
+/**
+ * loader_hash_string : returns the FNV-1a hash of the string @str;
+ * @param str : the string to hash;
+ * @return the hash;
+ */
+u32 loader_hash_string(
+	const char *str
+);
+
+/**
+ * loader_hash_slots : returns the number of slots of a table that stays
+ * half empty with @count used slots;
+ * @param count : the number of slots to use;
+ * @return the smallest power of 2 greater than or equal to 2 * @count;
+ */
+u32 loader_hash_slots(
+	u32 count
+);
+
+/**
+ * loader_hash_init : initializes @table with the slot array @slots, and
+ * frees all slots;
+ * @param table : the table to initialize;
+ * @param slots : the slot array;
+ * @param bsize : the size of a slot;
+ * @param mask : the number of slots minus one; must be 2^n - 1;
+ */
+void loader_hash_init(
+	struct loader_hash_table *table,
+	void *slots,
+	u32 bsize,
+	u32 mask
+);
+
+/**
+ * loader_hash_find : probes @table linearly from @hash until a free slot or
+ * a used slot with hash @hash that @match accepts; @match is called only for
+ * slots with hash @hash; performs no write, and can be called from a signal
+ * handler;
+ * @param table : the table to search;
+ * @param hash : the hash of the key;
+ * @param match : returns 1 if the slot holds the key, 0 if not;
+ * @param key : the key to provide to @match;
+ * @param probes : incremented with the number of slots probed;
+ * @return the matching slot, or the free slot that ends the probe sequence;
+ */
+void *loader_hash_find(
+	const struct loader_hash_table *table,
+	u32 hash,
+	u8 (*match)(const void *slot, const void *key),
+	const void *key,
+	u32 *probes
+);
+
+/**
+ * loader_hash_claim : uses the free slot @slot, returned by loader_hash_find
+ * for @hash, if the table is less than 3/4 full;
+ * @param table : the table;
+ * @param slot : the free slot;
+ * @param hash : the hash of the slot's key;
+ * @return 1 if the slot is used, 0 if the table is full;
+ */
+u8 loader_hash_claim(
+	struct loader_hash_table *table,
+	void *slot,
+	u32 hash
+);
+
+/**
+ * loader_hash_release : frees the used slot @slot of @table; following slots
+ * are moved back so that no probe sequence is broken;
+ * @param table : the table;
+ * @param slot : the slot to free;
+ */
+void loader_hash_release(
+	struct loader_hash_table *table,
+	void *slot
+);
+
+/**
+ * loader_hash_remove : frees each used slot of @table that @drop accepts;
+ * following slots are moved back so that no probe sequence is broken;
+ * @param table : the table;
+ * @param drop : returns 1 if the slot must be freed, 0 if not;
+ * @param key : the key to provide to @drop;
+ * @return the number of slots freed;
+ */
+u32 loader_hash_remove(
+	struct loader_hash_table *table,
+	u8 (*drop)(const void *slot, const void *key),
+	const void *key
+);
+
+/**
+ * loader_sort : sorts @count records of @bsize bytes at @records in place,
+ * by increasing value of their first 64 bits word, with a heapsort;
+ * @param records : the records, aligned on 8 bytes;
+ * @param count : the number of records;
+ * @param bsize : the size of a record, a multiple of 8;
+ */
+void loader_sort(
+	void *records,
+	usize count,
+	u32 bsize
+);
+
+
+#endif /*KERNEL_TK_TABLE_H*/
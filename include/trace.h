@@ -0,0 +1,176 @@
+/*trace.h - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#ifndef KERNEL_TK_TRACE_H
+#define KERNEL_TK_TRACE_H
+
+#include <types.h>
+
+/*
+ * Trace levels; events of a level above LOADER_TRACE_LEVEL are compiled out;
+ */
+
+/*No event is traced;*/
+#define LOADER_TRACE_NONE 0
+
+/*Phase boundaries and errors are traced;*/
+#define LOADER_TRACE_PHASES 1
+
+/*Section and table events are traced;*/
+#define LOADER_TRACE_SECTIONS 2
+
+/*Symbol and relocation events are traced;*/
+#define LOADER_TRACE_ENTRIES 3
+
+/*By default, tracing is compiled out;*/
+#ifndef LOADER_TRACE_LEVEL
+#define LOADER_TRACE_LEVEL LOADER_TRACE_NONE
+#endif
+
+/**
+ * The loader event struct is the fixed size record of a loading event;
+ * fields that are irrelevant to an event's kind are null;
+ */
+struct loader_event {
+	
+	/*The kind of event;*/
+	u8 ev_kind;
+	
+	/*The loading phase the event occurred in;*/
+	u8 ev_phase;
+	
+	/*The index of the section concerned;*/
+	u16 ev_section;
+	
+	/*The index of the symbol concerned;*/
+	u32 ev_symbol;
+	
+	/*The relocation type, or the error code;*/
+	u32 ev_type;
+	
+	/*Padding, null;*/
+	u32 ev_reserved;
+	
+	/*The value concerned : an address, a symbol value or a count;*/
+	u64 ev_value;
+	
+};
+
+/*
+ * Event kinds;
+ */
+
+/*A phase started; value is null;*/
+#define LOADER_EVENT_PHASE_START ((u8) 1)
+
+/*A phase ended; type is the phase's error code;*/
+#define LOADER_EVENT_PHASE_END ((u8) 2)
+
+/*A section was assigned; value is its address;*/
+#define LOADER_EVENT_SECTION ((u8) 3)
+
+/*A symbol was assigned; value is its address;*/
+#define LOADER_EVENT_SYMBOL ((u8) 4)
+
+/*A relocation was applied; value is its address;*/
+#define LOADER_EVENT_RELOCATION ((u8) 5)
+
+/*A section was removed from the load; type is the option removing it;*/
+#define LOADER_EVENT_DROP ((u8) 6)
+
+/*A COMDAT group was met; symbol is its signature's, type is 1 if kept;*/
+#define LOADER_EVENT_GROUP ((u8) 7)
+
+/*A section was folded; value is the address of its identical copy;*/
+#define LOADER_EVENT_FOLD ((u8) 8)
+
+/*The number of event kinds;*/
+#define LOADER_EVENT_KINDS 9
+
+/**
+ * The loader trace struct describes a ring buffer of events; when the buffer
+ * is full, the oldest events are overwritten;
+ */
+struct loader_trace {
+	
+	/*The event buffer;*/
+	struct loader_event *t_events;
+	
+	/*The number of events in the buffer minus one; must be 2^n - 1;*/
+	u32 t_mask;
+	
+	/*The number of events ever recorded;*/
+	u32 t_count;
+	
+};
+
+/**
+ * loader_trace_record : records an event in @trace;
+ */
+static __inline__ void loader_trace_record(
+	struct loader_trace *trace,
+	u8 kind,
+	u8 phase,
+	u16 section,
+	u32 symbol,
+	u32 type,
+	u64 value
+)
+{
+	
+	struct loader_event *event;
+	
+	/*Fetch the next slot, and count the event;*/
+	event = trace->t_events + (trace->t_count++ & trace->t_mask);
+	
+	/*Save the event;*/
+	event->ev_kind = kind;
+	event->ev_phase = phase;
+	event->ev_section = section;
+	event->ev_symbol = symbol;
+	event->ev_type = type;
+	event->ev_reserved = 0;
+	event->ev_value = value;
+	
+}
+
+/**
+ * LOADER_TRACE : records an event in the trace of @env if its level is
+ * compiled in and if the environment has a trace; compiles to nothing if not;
+ */
+#define LOADER_TRACE(level, env, kind, phase, section, symbol, type, value) \
+	do { \
+		if (((level) <= LOADER_TRACE_LEVEL) && ((env)->r_trace)) \
+			loader_trace_record((env)->r_trace, (kind), (phase), \
+				(u16) (section), (u32) (symbol), (u32) (type), \
+				(u64) (value)); \
+	} while (0)
+
+/**
+ * loader_trace_init : initializes @trace with the event buffer @events;
+ * @param trace : the trace to initialize;
+ * @param events : the event buffer;
+ * @param mask : the number of events in the buffer minus one; must be
+ * 2^n - 1;
+ */
+void loader_trace_init(
+	struct loader_trace *trace,
+	struct loader_event *events,
+	u32 mask
+);
+
+/**
+ * loader_trace_decode : calls @render on each event still in @trace, from the
+ * oldest to the newest, providing the name of the event's kind;
+ * @param trace : the trace to decode;
+ * @param render : the function rendering an event;
+ * @param handle : the renderer's private data, provided to each call;
+ * @return the number of events lost because the buffer was full;
+ */
+u32 loader_trace_decode(
+	struct loader_trace *trace,
+	void (*render)(void *handle, const struct loader_event *, const char *),
+	void *handle
+);
+
+
+#endif /*KERNEL_TK_TRACE_H*/
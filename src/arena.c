@@ -0,0 +1,66 @@
+/*arena.c - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#include <arena.h>
+
+/**
+ * loader_arena_init : initializes @arena in the block [@start, @start + @size[;
+ * @param arena : the arena to initialize;
+ * @param start : the first byte of the block;
+ * @param size : the size of the block;
+ */
+void loader_arena_init(
+	struct loader_arena *arena,
+	void *start,
+	usize size
+)
+{
+	
+	arena->a_start = start;
+	arena->a_size = size;
+	arena->a_used = 0;
+	arena->a_peak = 0;
+	
+}
+
+/**
+ * loader_arena_alloc : allocates @size bytes aligned on @align in the arena
+ * @handle; the signature matches a loader allocator's, flags are ignored;
+ * @param handle : the arena;
+ * @param size : the number of bytes to allocate;
+ * @param align : the alignment, a power of 2, null for no alignment;
+ * @param flags : ignored;
+ * @return the allocated memory, null if the arena is full;
+ */
+void *loader_arena_alloc(
+	void *handle,
+	usize size,
+	usize align,
+	u64 flags
+)
+{
+	
+	struct loader_arena *arena;
+	usize start;
+	
+	arena = handle;
+	
+	if (!align)
+		align = 1;
+	
+	/*Align the address, not the offset, as the block may be unaligned;*/
+	start = (usize) ((((usize) arena->a_start + arena->a_used + align - 1) &
+		~(align - 1)) - (usize) arena->a_start);
+	
+	/*If the block is too small, fail;*/
+	if ((start > arena->a_size) || (size > arena->a_size - start))
+		return 0;
+	
+	arena->a_used = start + size;
+	
+	if (arena->a_used > arena->a_peak) {
+		arena->a_peak = arena->a_used;
+	}
+	
+	return arena->a_start + start;
+	
+}
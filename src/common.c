@@ -0,0 +1,158 @@
+/*common.c - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#include <string.h>
+
+#include <common.h>
+
+/**
+ * common_match : determines whether the common symbol @slot is named @key;
+ */
+static u8 common_match(
+	const void *slot,
+	const void *key
+)
+{
+	
+	return (u8) !str_cmp(((const struct loader_common *) slot)->c_name,
+		(const char *) key);
+	
+}
+
+/**
+ * common_in_range : determines whether the common symbol @slot is placed in
+ * the range @key;
+ */
+static u8 common_in_range(
+	const void *slot,
+	const void *key
+)
+{
+	
+	const u64 *range;
+	u64 addr;
+	
+	range = key;
+	addr = (u64) ((const struct loader_common *) slot)->c_addr;
+	
+	return (u8) ((addr >= range[0]) && (addr < range[1]));
+	
+}
+
+/**
+ * loader_common_table_init : initializes @table with the slot array
+ * @commons;
+ * @param table : the table to initialize;
+ * @param commons : the slot array;
+ * @param mask : the number of slots minus one; must be 2^n - 1;
+ */
+void loader_common_table_init(
+	struct loader_common_table *table,
+	struct loader_common *commons,
+	u32 mask
+)
+{
+	
+	loader_hash_init(&table->t_commons, commons,
+		sizeof(struct loader_common), mask);
+	
+}
+
+/**
+ * loader_common_find : searches @table for the common symbol named @name;
+ * if none is found, and the table is less than 3/4 full, a symbol is
+ * inserted, with the name @name, that the caller may replace with a copy, and
+ * a null size and alignment;
+ * @param table : the table to search;
+ * @param name : the symbol's name;
+ * @param inserted : set if the symbol was inserted, cleared if not;
+ * @param probes : incremented with the number of slots probed;
+ * @return the symbol, null if it is not in the table and the table is full;
+ */
+struct loader_common *loader_common_find(
+	struct loader_common_table *table,
+	const char *name,
+	u8 *inserted,
+	u32 *probes
+)
+{
+	
+	struct loader_common *common;
+	u32 hash;
+	
+	hash = loader_hash_string(name);
+	*inserted = 0;
+	
+	common = loader_hash_find(&table->t_commons, hash, &common_match, name,
+		probes);
+	
+	/*If the name matches, the symbol is already declared;*/
+	if (common->c_slot.s_used)
+		return common;
+	
+	/*If the slot is free, the symbol is new; insert it if possible;*/
+	if (!loader_hash_claim(&table->t_commons, common, hash))
+		return 0;
+	
+	common->c_name = name;
+	common->c_size = 0;
+	common->c_align = 0;
+	common->c_addr = 0;
+	*inserted = 1;
+	
+	return common;
+	
+}
+
+/**
+ * loader_common_declare : merges a declaration of @common with @size bytes
+ * and the alignment @align;
+ * @param common : the common symbol;
+ * @param size : the declared size;
+ * @param align : the declared alignment;
+ * @return 0 if the declaration was merged, 1 if @common is already placed,
+ * and smaller or less aligned than declared;
+ */
+u8 loader_common_declare(
+	struct loader_common *common,
+	u64 size,
+	u64 align
+)
+{
+	
+	/*A placed symbol can't grow;*/
+	if (common->c_addr)
+		return (u8) ((size > common->c_size) || (align > common->c_align));
+	
+	if (size > common->c_size)
+		common->c_size = size;
+	
+	if (align > common->c_align)
+		common->c_align = align;
+	
+	return 0;
+	
+}
+
+/**
+ * loader_common_table_remove : removes from @table the common symbols placed
+ * in [@start, @end[, so that their memory can be freed;
+ * @param table : the table;
+ * @param start : the first byte of the memory to free;
+ * @param end : the byte following the memory to free;
+ * @return the number of symbols removed;
+ */
+u32 loader_common_table_remove(
+	struct loader_common_table *table,
+	u64 start,
+	u64 end
+)
+{
+	
+	u64 range[2];
+	
+	range[0] = start;
+	range[1] = end;
+	
+	return loader_hash_remove(&table->t_commons, &common_in_range, range);
+	
+}
@@ -0,0 +1,174 @@
+/*fold.c - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#include <fold.h>
+
+/**
+ * fold_match : determines whether the entry @slot is identical to the entry
+ * @key : both have the same size and relocations, and the same bytes out of
+ * relocated fields;
+ */
+static u8 fold_match(
+	const void *slot,
+	const void *key
+)
+{
+	
+	const struct loader_fold_entry *entry;
+	const struct loader_fold_entry *section;
+	const struct loader_fold_relocation *a;
+	const struct loader_fold_relocation *b;
+	const u8 *copy;
+	const u8 *data;
+	u64 byte;
+	u64 end;
+	u32 index;
+	
+	entry = slot;
+	section = key;
+	
+	if ((entry->f_size != section->f_size) ||
+		(entry->f_nb_relocations != section->f_nb_relocations))
+		return 0;
+	
+	/*Compare relocations, sorted by offset;*/
+	for (index = 0; index < section->f_nb_relocations; index++) {
+		
+		a = entry->f_relocations + index;
+		b = section->f_relocations + index;
+		
+		if ((a->r_offset != b->r_offset) || (a->r_target != b->r_target) ||
+			(a->r_addend != b->r_addend) || (a->r_type != b->r_type) ||
+			(a->r_width != b->r_width) || (a->r_self != b->r_self))
+			return 0;
+		
+	}
+	
+	copy = (const u8 *) entry->f_addr;
+	data = (const u8 *) section->f_addr;
+	byte = 0;
+	
+	/*Compare bytes before each relocated field, then after the last one;*/
+	for (index = 0; index <= section->f_nb_relocations; index++) {
+		
+		end = (index < section->f_nb_relocations) ?
+			section->f_relocations[index].r_offset : section->f_size;
+		
+		for (; byte < end; byte++) {
+			if (copy[byte] != data[byte])
+				return 0;
+		}
+		
+		/*Skip the field; fields may overlap;*/
+		if ((index < section->f_nb_relocations) &&
+			(byte < end + section->f_relocations[index].r_width))
+			byte = end + section->f_relocations[index].r_width;
+		
+	}
+	
+	return 1;
+	
+}
+
+/**
+ * fold_in_range : determines whether the entry @slot is in the range @key;
+ */
+static u8 fold_in_range(
+	const void *slot,
+	const void *key
+)
+{
+	
+	const u64 *range;
+	u64 addr;
+	
+	range = key;
+	addr = ((const struct loader_fold_entry *) slot)->f_addr;
+	
+	return (u8) ((addr >= range[0]) && (addr < range[1]));
+	
+}
+
+/**
+ * loader_fold_table_init : initializes @table with the slot array @entries;
+ * @param table : the table to initialize;
+ * @param entries : the slot array;
+ * @param mask : the number of slots minus one; must be 2^n - 1;
+ */
+void loader_fold_table_init(
+	struct loader_fold_table *table,
+	struct loader_fold_entry *entries,
+	u32 mask
+)
+{
+	
+	loader_hash_init(&table->t_entries, entries,
+		sizeof(struct loader_fold_entry), mask);
+	
+}
+
+/**
+ * loader_fold_find : searches @table for an entry identical to @section :
+ * with the same size and relocations, and the same bytes out of relocated
+ * fields, as the first copy may be relocated; if none is found, and the
+ * table is less than 3/4 full, @section is inserted; the caller must then
+ * make its relocations outlive the table;
+ * @param table : the table to search;
+ * @param hash : the section's hash;
+ * @param section : the section to search for, whose slot header is unused;
+ * @param probes : incremented with the number of slots probed;
+ * @return the identical entry, the inserted entry, whose address is the
+ * section's, or null if the table is full;
+ */
+struct loader_fold_entry *loader_fold_find(
+	struct loader_fold_table *table,
+	u32 hash,
+	const struct loader_fold_entry *section,
+	u32 *probes
+)
+{
+	
+	struct loader_fold_entry *entry;
+	
+	entry = loader_hash_find(&table->t_entries, hash, &fold_match, section,
+		probes);
+	
+	/*If an identical section is found, return its entry;*/
+	if (entry->f_slot.s_used)
+		return entry;
+	
+	/*If the slot is free, the section is new; insert it if possible;*/
+	if (!loader_hash_claim(&table->t_entries, entry, hash))
+		return 0;
+	
+	entry->f_addr = section->f_addr;
+	entry->f_size = section->f_size;
+	entry->f_relocations = section->f_relocations;
+	entry->f_nb_relocations = section->f_nb_relocations;
+	
+	return entry;
+	
+}
+
+/**
+ * loader_fold_table_remove : removes from @table the sections in
+ * [@start, @end[, so that their memory can be freed;
+ * @param table : the table;
+ * @param start : the first byte of the memory to free;
+ * @param end : the byte following the memory to free;
+ * @return the number of sections removed;
+ */
+u32 loader_fold_table_remove(
+	struct loader_fold_table *table,
+	u64 start,
+	u64 end
+)
+{
+	
+	u64 range[2];
+	
+	range[0] = start;
+	range[1] = end;
+	
+	return loader_hash_remove(&table->t_entries, &fold_in_range, range);
+	
+}
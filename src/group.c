@@ -0,0 +1,134 @@
+/*group.c - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#include <string.h>
+
+#include <loader.h>
+
+#include <group.h>
+
+/**
+ * group_match : determines whether the group @slot has the signature @key;
+ */
+static u8 group_match(
+	const void *slot,
+	const void *key
+)
+{
+	
+	return (u8) !str_cmp(((const struct loader_group *) slot)->g_signature,
+		(const char *) key);
+	
+}
+
+/**
+ * group_in_range : determines whether the group @slot defines a symbol in
+ * the range @key;
+ */
+static u8 group_in_range(
+	const void *slot,
+	const void *key
+)
+{
+	
+	const struct loader_symbol *symbol;
+	const u64 *range;
+	
+	range = key;
+	
+	for (symbol = ((const struct loader_group *) slot)->g_symbols; symbol;
+		symbol = symbol->s_next) {
+		if (((u64) symbol->s_addr >= range[0]) &&
+			((u64) symbol->s_addr < range[1]))
+			return 1;
+	}
+	
+	return 0;
+	
+}
+
+/**
+ * loader_group_table_init : initializes @table with the slot array @groups;
+ * @param table : the table to initialize;
+ * @param groups : the slot array;
+ * @param mask : the number of slots minus one; must be 2^n - 1;
+ */
+void loader_group_table_init(
+	struct loader_group_table *table,
+	struct loader_group *groups,
+	u32 mask
+)
+{
+	
+	loader_hash_init(&table->t_groups, groups, sizeof(struct loader_group),
+		mask);
+	
+}
+
+/**
+ * loader_group_find : searches @table for the group with the signature
+ * @signature; if none is found, and the table is less than 3/4 full, a group
+ * is inserted, with the signature @signature, that the caller may replace
+ * with a copy;
+ * @param table : the table to search;
+ * @param signature : the group's signature;
+ * @param inserted : set if the group was inserted, cleared if not;
+ * @param probes : incremented with the number of slots probed;
+ * @return the group, null if it is not in the table and the table is full;
+ */
+struct loader_group *loader_group_find(
+	struct loader_group_table *table,
+	const char *signature,
+	u8 *inserted,
+	u32 *probes
+)
+{
+	
+	struct loader_group *group;
+	u32 hash;
+	
+	hash = loader_hash_string(signature);
+	*inserted = 0;
+	
+	group = loader_hash_find(&table->t_groups, hash, &group_match, signature,
+		probes);
+	
+	/*If the signature matches, the group is already loaded;*/
+	if (group->g_slot.s_used)
+		return group;
+	
+	/*If the slot is free, the group is new; insert it if possible;*/
+	if (!loader_hash_claim(&table->t_groups, group, hash))
+		return 0;
+	
+	group->g_signature = signature;
+	group->g_symbols = 0;
+	*inserted = 1;
+	
+	return group;
+	
+}
+
+/**
+ * loader_group_table_remove : removes from @table the groups whose first
+ * copy defines a symbol in [@start, @end[, so that the memory of the copy can
+ * be freed;
+ * @param table : the table;
+ * @param start : the first byte of the memory to free;
+ * @param end : the byte following the memory to free;
+ * @return the number of groups removed;
+ */
+u32 loader_group_table_remove(
+	struct loader_group_table *table,
+	u64 start,
+	u64 end
+)
+{
+	
+	u64 range[2];
+	
+	range[0] = start;
+	range[1] = end;
+	
+	return loader_hash_remove(&table->t_groups, &group_in_range, range);
+	
+}
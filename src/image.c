@@ -0,0 +1,157 @@
+/*image.c - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#include <image.h>
+
+/**
+ * loader_relr_encode : encodes sorted offsets of 64 bits words in relr
+ * words : an even word is the offset of a word, and each following odd word
+ * is a bitmap of the LOADER_RELR_BITS next words;
+ * @param offsets : the sorted offsets, multiple of 8;
+ * @param count : the number of offsets;
+ * @param words : the relr words, at most @count; may be @offsets;
+ * @return the number of relr words;
+ */
+u32 loader_relr_encode(
+	const u64 *offsets,
+	u32 count,
+	u64 *words
+)
+{
+	
+	u64 bitmap;
+	u64 next;
+	u32 index;
+	u32 used;
+	
+	index = used = 0;
+	
+	while (index < count) {
+		
+		/*Locate the first word;*/
+		words[used++] = offsets[index];
+		next = offsets[index++] + 8;
+		
+		/*Locate following words with bitmaps, until a gap;*/
+		for (;;) {
+			
+			bitmap = 0;
+			
+			while ((index < count) &&
+				(offsets[index] - next < LOADER_RELR_BITS * 8)) {
+				bitmap |= (u64) 1 << ((offsets[index++] - next) >> 3);
+			}
+			
+			if (!bitmap)
+				break;
+			
+			words[used++] = (bitmap << 1) | 1;
+			next += LOADER_RELR_BITS * 8;
+			
+		}
+		
+	}
+	
+	return used;
+	
+}
+
+/**
+ * loader_relr_check : verifies that words located by @words are in an image
+ * of @size bytes;
+ * @param words : the relr words;
+ * @param count : the number of relr words;
+ * @param size : the size of the image;
+ * @return 1 if all words are in the image, 0 if not;
+ */
+u8 loader_relr_check(
+	const u64 *words,
+	u32 count,
+	u64 size
+)
+{
+	
+	u64 next;
+	u64 word;
+	u64 bitmap;
+	
+	/*The first word must locate a word;*/
+	if ((count) && (*words & 1))
+		return 0;
+	
+	next = 0;
+	
+	while (count--) {
+		
+		word = *(words++);
+		
+		/*An even word must locate an aligned word of the image;*/
+		if (!(word & 1)) {
+			
+			if ((word & 7) || (word >= size) || (size - word < 8))
+				return 0;
+			
+			next = word + 8;
+			continue;
+			
+		}
+		
+		/*The last word located by a bitmap must be in the image;*/
+		for (bitmap = word >> 1, word = next; bitmap >>= 1;) {
+			word += 8;
+		}
+		
+		if ((next >= size) || (word >= size) || (size - word < 8))
+			return 0;
+		
+		next += LOADER_RELR_BITS * 8;
+		
+	}
+	
+	return 1;
+	
+}
+
+/**
+ * loader_relr_apply : adds @base to each 64 bits word of the image at @base
+ * located by @words;
+ * @param base : the image;
+ * @param words : the relr words;
+ * @param count : the number of relr words;
+ */
+void loader_relr_apply(
+	u8 *base,
+	const u64 *words,
+	u32 count
+)
+{
+	
+	u64 *next;
+	u64 *word;
+	u64 bitmap;
+	
+	next = 0;
+	
+	while (count--) {
+		
+		bitmap = *(words++);
+		
+		/*An even word locates a word;*/
+		if (!(bitmap & 1)) {
+			
+			next = (u64 *) (base + bitmap);
+			*(next++) += (u64) base;
+			continue;
+			
+		}
+		
+		/*An odd word is a bitmap of the next words;*/
+		for (word = next, bitmap >>= 1; bitmap; bitmap >>= 1, word++) {
+			if (bitmap & 1)
+				*word += (u64) base;
+		}
+		
+		next += LOADER_RELR_BITS;
+		
+	}
+	
+}
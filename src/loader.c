@@ -7,8 +7,6 @@
 
 #include <string.h>
 
-#define DEBUG 1
-
 #include <debug.h>
 
 /*TODO CHECKS*/
@@ -31,6 +29,65 @@
         (entry_p) = ptr_sum_byte_offset(entry_p,(table).t_bsize)\
     )
 
+/**
+ * SECTIONS_ITERATE : iterates on each section index of the section cache
+ * @sections, saving the current index in @index;
+ */
+#define SECTIONS_ITERATE(sections, index) \
+    for ((index) = 0; (index) < (sections)->s_count; (index)++)
+
+/**
+ * loader_apply_relocation : apply the relocation @rel_type to @rel_addr,
+ * regarding symbol at @sym_addr and @addend; If the relocation fails to be
+ * applied, the function stops throws the related error;
+ * This function is processor-defined;
+ * @param rel_addr : the address to apply the relocation to;
+ * @param sym_addr : the address of the symbol the relocation concerns;
+ * @param addend : the relocation addend, null if none;
+ * @param rel_type : the relocation type;
+ * @return 0 if the relocation was applied correctly, LOADER_ERROR_REL_BAD_TYPE
+ * if bad relocation type, LOADER_ERROR_REL_VALUE_OVERFLOW if relocation value
+ * overflow.
+ */
+u8 loader_apply_relocation(
+	u64 rel_addr,
+	u64 sym_addr,
+	s64 addend,
+	u32 rel_type
+);
+
+/**
+ * loader_relocation_width : returns the number of bytes written by a
+ * relocation of type @rel_type;
+ * This function is processor-defined;
+ * @param rel_type : the relocation type;
+ * @return the number of bytes written, 0 if the type is not supported;
+ */
+u8 loader_relocation_width(
+	u32 rel_type
+);
+
+/**
+ * loader_thunk_size : returns the size in bytes of a counting thunk;
+ * This function is processor-defined;
+ * @return the size of a thunk, a multiple of its alignment;
+ */
+u8 loader_thunk_size(void);
+
+/**
+ * loader_write_thunk : writes at @thunk a thunk that atomically increments
+ * the counter at @counter, then jumps to @target;
+ * This function is processor-defined;
+ * @param thunk : the location of the thunk, loader_thunk_size bytes;
+ * @param counter : the counter to increment;
+ * @param target : the function to jump to;
+ */
+void loader_write_thunk(
+	u8 *thunk,
+	u64 *counter,
+	u64 target
+);
+
 /**
  * check_section_index : verifies the provided index is undefined or reserved;
  * @param index : the index to check;
@@ -52,74 +109,258 @@ static __inline__ void loading_error(struct loading_env *env, u8 err_type)
 	throw_error(env->r_error_ctx, err_type);
 }
 
-/*----------------------------------------------------------------- debug only*/
+/**
+ * __error_locate : saves the phase and the section being processed, to locate
+ * an eventual error; the entry index is reset;
+ * @param env : the loading environment;
+ * @param phase : the current loading phase;
+ * @param section : the index of the section being processed;
+ */
+static __inline__ void __error_locate(
+	struct loading_env *env,
+	u8 phase,
+	u16 section
+)
+{
+	env->r_error.e_phase = phase;
+	env->r_error.e_section = section;
+	env->r_error.e_entry = 0;
+}
+
+/**
+ * __error_reset : resets the environment's error descriptor;
+ * @param env : the loading environment;
+ */
+static __inline__ void __error_reset(struct loading_env *env)
+{
+	env->r_error.e_code = 0;
+	__error_locate(env, 0, 0);
+}
+
+/**
+ * __section_data : returns the address in RAM of the first byte of the
+ * section at @index; a mapped file holds the section at its file offset, a
+ * streamed one at the location it was read to, if it was read;
+ * @param env : the loading environment;
+ * @param index : the index of the section to get the data of;
+ * @return the address of the section's first byte, 0 if it is not in RAM;
+ */
+static __inline__ void *__section_data(
+	struct loading_env *env,
+	u16 index
+)
+{
+	return (void *) env->r_sections.s_addr[index];
+}
+
+/*-------------------------------------------------------------- section names*/
 
 
 static const char *section_name(
-	struct loading_env *env, struct elf64_shdr *shdr
+	struct loading_env *env, u16 index
 )
 {
 	
-	struct elf64_hdr *hdr;
-	struct elf64_shdr *str_hdr;
+	struct loader_sections *sections;
+	u16 str_index;
 	
-	/*Cache the elf header;*/
-	hdr = env->r_hdr;
+	/*Cache the section cache and the section names table index;*/
+	sections = &env->r_sections;
+	str_index = env->r_hdr->e_shstrndx;
 	
-	/*Cache the string section header;*/
-	str_hdr = ptr_sum_byte_offset(
-		hdr,
-		hdr->e_shoff + hdr->e_shstrndx * hdr->e_shentsize
-	);
+	/*If the section names table is not available, use a placeholder;*/
+	if ((str_index >= sections->s_count) || (!sections->s_addr[str_index]))
+		return "?";
 	
-	return ptr_sum_byte_offset(hdr, str_hdr->sh_offset + shdr->sh_name);
+	return ptr_sum_byte_offset(
+		__section_data(env, str_index), sections->s_name[index]
+	);
 	
 }
 
 
-static const char *symbol_name(
-	struct loading_env *env, struct elf64_shdr *shdr, struct elf64_sym *sym
-) {
+/**
+ * __name_size : returns the size of @name, including its terminator;
+ */
+static u32 __name_size(
+	const char *name
+)
+{
 	
+	u32 size;
 	
-	struct elf64_hdr *hdr;
-	struct elf64_shdr *str_hdr;
+	for (size = 1; *name; name++) {
+		size++;
+	}
 	
-	/*Cache the elf header;*/
-	hdr = env->r_hdr;
+	return size;
 	
-	/*Cache the string section header;*/
-	str_hdr = ptr_sum_byte_offset(
-		hdr,
-		hdr->e_shoff + shdr->sh_link * hdr->e_shentsize
-	);
+}
+
+/**
+ * __copy_name : copies @name with the data allocator, so that it outlives
+ * the string tables of the load, that may be scratch memory;
+ * @param env : the loading environment;
+ * @param name : the name to copy;
+ * @return the copy, null if the allocation failed;
+ */
+static const char *__copy_name(
+	struct loading_env *env,
+	const char *name
+)
+{
 	
-	return ptr_sum_byte_offset(hdr, str_hdr->sh_offset + sym->sy_name);
+	struct loader_allocator *alloc;
+	char *copy;
+	u32 size;
 	
+	size = __name_size(name);
+	alloc = env->r_data;
+	copy = (*alloc->a_alloc)(alloc->a_handle, size, 1, 0);
+	
+	if (copy) {
+		while (size--) {
+			copy[size] = name[size];
+		}
+	}
+	
+	return copy;
 	
 }
 
 /*---------------------------------------------------------------- loader init*/
 
 /**
- * loader_init : initializes the loading environment for the provided elf file;
+ * __build_section_cache : allocates and fills the section cache from the
+ * section header table; sections of a mapped file are in RAM at their file
+ * offset, sections of a streamed file are not in RAM until they are read;
+ * @param env : the loading environment;
+ * @param alloc : the allocator providing memory to the cache;
+ * @return 0 if the cache was built, LOADER_ERROR_ALLOCATION if not;
+ */
+static u8 __build_section_cache(
+	struct loading_env *env,
+	struct loader_allocator *alloc
+)
+{
+	
+	struct loader_sections *sections;
+	struct elf64_shdr *shdr;
+	u16 count;
+	u16 index;
+	u64 *words;
+	
+	/*Cache the section cache and the number of sections;*/
+	sections = &env->r_sections;
+	sections->s_count = count = env->r_hdr->e_shnum;
+	
+	/*Allocate all arrays at once; 4 arrays of words and 4 of half words;*/
+	words = (*alloc->a_alloc)(alloc->a_handle, (usize) count * 48, 8, 0);
+	
+	/*If the allocation failed, fail;*/
+	if (!words) {
+		return LOADER_ERROR_ALLOCATION;
+	}
+	
+	/*Split the block in arrays;*/
+	sections->s_addr = words;
+	sections->s_size = words + count;
+	sections->s_flags = words + 2 * count;
+	sections->s_entsize = words + 3 * count;
+	sections->s_type = (u32 *) (words + 4 * count);
+	sections->s_link = sections->s_type + count;
+	sections->s_info = sections->s_link + count;
+	sections->s_name = sections->s_info + count;
+	
+	/*Fill the cache;*/
+	index = 0;
+	TABLE_ITERATE(env->r_shtable, shdr) {
+		
+		sections->s_addr[index] = (env->r_stream) ? 0 :
+			(u64) ptr_sum_byte_offset(env->r_hdr, shdr->sh_offset);
+		sections->s_size[index] = shdr->sh_size;
+		sections->s_flags[index] = shdr->sh_flags;
+		sections->s_entsize[index] = shdr->sh_entsize;
+		sections->s_type[index] = shdr->sh_type;
+		sections->s_link[index] = shdr->sh_link;
+		sections->s_info[index] = shdr->sh_info;
+		sections->s_name[index] = shdr->sh_name;
+		
+		index++;
+		
+	}
+	
+	/*Complete;*/
+	return 0;
+	
+}
+
+/**
+ * __reset_env : resets options, trace, stats, roots, pools, tables and
+ * errors of @env, that the caller sets after initialization;
+ * @param env : the environment to reset;
+ */
+static void __reset_env(
+	struct loading_env *env
+)
+{
+	
+	env->r_flags = 0;
+	env->r_trace = 0;
+	env->r_stats = 0;
+	env->r_roots = 0;
+	env->r_merge = 0;
+	env->r_maps = 0;
+	env->r_groups = 0;
+	env->r_members = 0;
+	env->r_folds = 0;
+	env->r_module = 0;
+	env->r_registry = 0;
+	env->r_reader = 0;
+	env->r_hook = 0;
+	env->r_counters = 0;
+	env->r_profile = 0;
+	env->r_commons = 0;
+	env->r_common_block = 0;
+	__error_reset(env);
+	
+}
+
+/**
+ * loader_init : initializes the loading environment for the provided elf file,
+ * and builds the section cache;
  * @param env : the environment to initialize;
  * @param ram_start : the address of the file's first byte in RAM;
- * @param file_size : the size in bytes of the file in RAM;
+ * @param alloc : the allocator providing memory to the section cache;
+ * @return 0 if the environment was initialized, LOADER_ERROR_ALLOCATION if
+ * not;
  */
-void loader_init(
+u8 loader_init(
 	struct loading_env *env,
-	void *ram_start
+	void *ram_start,
+	struct loader_allocator *alloc
 )
 {
 	
 	struct elf64_hdr *hdr;
 	u8 *shtable;
 	usize shentry_size;
+	u64 start;
+	u8 error;
+	
+	/*Save the initialization start;*/
+	start = loader_timestamp();
 	
 	/*Initialize the elf header;*/
 	env->r_hdr = hdr = ram_start;
 	
+	/*The file is mapped, no stream is required;*/
+	env->r_stream = 0;
+	env->r_code = env->r_data = env->r_scratch = alloc;
+	
+	/*Reset options, trace, stats, roots, pools and errors;*/
+	__reset_env(env);
+	
 	/*Determine the address of the section table;*/
 	env->r_shtable.t_start = shtable =
 		ptr_sum_byte_offset(ram_start, hdr->e_shoff);
@@ -131,399 +372,4691 @@ void loader_init(
 	env->r_shtable.t_end =
 		ptr_sum_byte_offset(shtable, shentry_size * hdr->e_shnum);
 	
+	/*Build the section cache;*/
+	error = __build_section_cache(env, alloc);
+	
+	/*Save the initialization duration;*/
+	env->r_init_time = loader_timestamp() - start;
+	
+	/*Complete;*/
+	return error;
+	
 }
 
-/*-------------------------------------------------------- sections assignment*/
-
 /**
- * loader_assign_sections : update all section's values to their RAM addresses;
+ * __stream_section_at : reads the content of the section at @index from the
+ * stream to @dst; no-bits sections are zero-filled; the section's address is
+ * updated to @dst;
  * @param env : the loading environment;
- * @return 0 if all section were assigned correctly, 1 if an error occurred;
- * if the latter occurs, @err will be initialized with the error context for
- * further debug; any error should halt the loading;
-*/
-u8 loader_assign_sections(
-	struct loading_env *env
+ * @param index : the index of the section to read;
+ * @param dst : the final location of the section;
+ * @return 0 if the section was read, LOADER_ERROR_STREAM_READ if not;
+ */
+static u8 __stream_section_at(
+	struct loading_env *env,
+	u16 index,
+	u8 *dst
 )
 {
-	void *hdr;
-	struct elf_table shtable;
+	
+	struct loader_stream *stream;
 	struct elf64_shdr *shdr;
+	usize size;
 	
-	/*Fetch vars;*/
-	hdr = env->r_hdr;
-	shtable = env->r_shtable;
+	/*Cache the stream;*/
+	stream = env->r_stream;
 	
-	debug_("loader assigning sections");
+	/*The file offset is only required here;*/
+	shdr = ptr_sum_byte_offset(
+		env->r_shtable.t_start, index * env->r_shtable.t_bsize
+	);
 	
-	/*Iterate over the section table :*/
-	TABLE_ITERATE(shtable, shdr) {
-		
-		void *address;
-		u64 offset;
-		
-		debug("assigning section %s", section_name(env, shdr));
-		
-		/*If the section is of type nobits, with non-null size, fail;*/
-		if ((shdr->sh_type == SHT_NOBITS) && (shdr->sh_size != 0))
-			return LOADER_ERROR_NON_EMPTY_NOBITS_SECTION;
-		
-		/*Fetch the offset and size of the section;*/
-		offset = shdr->sh_offset;
+	/*Cache the section size;*/
+	size = (usize) shdr->sh_size;
+	
+	/*If the section occupies no space in the file, zero it :*/
+	if (shdr->sh_type == SHT_NOBITS) {
 		
-		/*Use the section address;*/
-		address = ptr_sum_byte_offset(hdr, offset);
+		while (size--) {
+			dst[size] = 0;
+		}
 		
-		/*Update the section's address;*/
-		shdr->sh_addr = (u64) address;
+	} else {
 		
-		debug("assigned at %h", address);
+		/*If the section content can't be read, fail;*/
+		if ((*stream->s_read)(stream->s_handle, dst, shdr->sh_offset, size))
+			return LOADER_ERROR_STREAM_READ;
 		
 	}
 	
-	debug_("loader done assigning sections");
+	/*Update the section's address;*/
+	env->r_sections.s_addr[index] = (u64) dst;
 	
 	/*Complete;*/
 	return 0;
 	
 }
 
-/*------------------------------------------------------------------ internals*/
+/**
+ * __section_allocator : selects the allocator of a section whose header flags
+ * are @flags : sections that are not loaded are only read during the load;
+ */
+#define __section_allocator(env, flags) \
+	((!((flags) & SHF_ALLOC)) ? (env)->r_scratch : \
+		((flags) & SHF_EXECINSTR) ? (env)->r_code : (env)->r_data)
 
 /**
- * table_get_entry : if @index is a valid subscript of @table, returns the
- * related entry; if not, throws a loading error;
+ * __stream_section : allocates memory for the section at @index, and reads
+ * its content from the stream, see __stream_section_at;
  * @param env : the loading environment;
- * @param table : the table to query the entry of;
- * @param index : the required table subscript;
- * @return the entry at @index.
+ * @param index : the index of the section to read;
+ * @return 0 if the section was read, LOADER_ERROR_ALLOCATION or
+ * LOADER_ERROR_STREAM_READ if not;
  */
-static void *__get_table_entry(
+static u8 __stream_section(
 	struct loading_env *env,
-	struct elf_table *table,
-	usize index
+	u16 index
 )
 {
-	/*Fetch the block ref;*/
-	void *bref = ptr_sum_byte_offset(table->t_start, index * table->t_bsize);
 	
-	/*If bad index, fail;*/
-	if (bref >= table->t_end) {
-		loading_error(env, LOADER_ERROR_BAD_TABLE_INDEX);
+	struct loader_allocator *alloc;
+	struct elf64_shdr *shdr;
+	u8 *dst;
+	
+	/*The alignment is only required here;*/
+	shdr = ptr_sum_byte_offset(
+		env->r_shtable.t_start, index * env->r_shtable.t_bsize
+	);
+	
+	/*Select the allocator the section's flags route to;*/
+	alloc = __section_allocator(env, shdr->sh_flags);
+	
+	/*Allocate the section at its final location;*/
+	dst = (*alloc->a_alloc)(
+		alloc->a_handle, (usize) shdr->sh_size, (usize) shdr->sh_addralign,
+		shdr->sh_flags
+	);
+	
+	/*If the allocation failed, fail;*/
+	if (!dst) {
+		return LOADER_ERROR_ALLOCATION;
 	}
 	
-	/*If the index was valid, complete;*/
-	return bref;
+	return __stream_section_at(env, index, dst);
 	
 }
 
 /**
- * get_section_header : if @section_id is a valid subscript in the section
- * header table, and if the related header has the required type, returns this
- * header; if one of these checks fail, throws an loading error;
- * @param section_id : a subscript if the section header table;
- * @param section_type : the expected type of the section, 0 to ignore check;
- * @return the ref of the section header at subscript @index;
+ * __init_stream : initializes the loading environment for an elf file that
+ * is not mapped in RAM; see loader_init_stream;
+ * @param env : the environment to initialize;
+ * @param stream : the stream to read the file from;
+ * @param alloc : the allocator providing memory to the load;
+ * @return 0 if the environment was initialized, LOADER_ERROR_STREAM_READ or
+ * LOADER_ERROR_ALLOCATION if not;
  */
-static struct elf64_shdr *__get_section_header(
+static u8 __init_stream(
 	struct loading_env *env,
-	u16 section_id,
-	u32 section_type
+	struct loader_stream *stream,
+	struct loader_allocator *alloc
 )
 {
 	
-	struct elf64_shdr *shdr;
+	struct elf64_hdr *hdr;
+	usize shtable_size;
+	void *shtable;
+	u8 error;
 	
-	/*Fetch the ref of the section header;*/
-	shdr = __get_table_entry(env, &env->r_shtable, section_id);
+	/*Save the stream and the allocator;*/
+	env->r_stream = stream;
+	env->r_code = env->r_data = env->r_scratch = alloc;
 	
-	/*If type check is enabled and bad type, fail;*/
-	if (section_type && (shdr->sh_type != section_type)) {
-		loading_error(env, LOADER_ERR_BAD_SECTION_TYPE);
+	/*Reset options, trace, stats, roots, pools and errors;*/
+	__reset_env(env);
+	
+	/*The elf header is copied in the environment;*/
+	env->r_hdr = hdr = &env->r_ehdr;
+	
+	/*Read the elf header;*/
+	if ((*stream->s_read)(stream->s_handle, hdr, 0, sizeof(struct elf64_hdr)))
+		return LOADER_ERROR_STREAM_READ;
+	
+	/*Determine the size of the section header table;*/
+	shtable_size = (usize) hdr->e_shentsize * hdr->e_shnum;
+	
+	/*Allocate the section header table;*/
+	shtable = (*alloc->a_alloc)(alloc->a_handle, shtable_size, 8, 0);
+	
+	/*If the allocation failed, fail;*/
+	if (!shtable) {
+		return LOADER_ERROR_ALLOCATION;
 	}
 	
-	/*Complete;*/
-	return shdr;
+	/*Read the section header table;*/
+	if ((*stream->s_read)(stream->s_handle, shtable, hdr->e_shoff, shtable_size))
+		return LOADER_ERROR_STREAM_READ;
+	
+	/*Initialize the section table descriptor;*/
+	env->r_shtable.t_start = shtable;
+	env->r_shtable.t_bsize = hdr->e_shentsize;
+	env->r_shtable.t_end = ptr_sum_byte_offset(shtable, shtable_size);
+	
+	/*Build the section cache; no section is read yet;*/
+	error = __build_section_cache(env, alloc);
+	
+	/*If the cache could not be built, fail;*/
+	if (error) {
+		return error;
+	}
+	
+	/*If there is no section name table, complete;*/
+	if ((hdr->e_shstrndx == SHN_UNDEF) || (hdr->e_shstrndx >= hdr->e_shnum))
+		return 0;
+	
+	/*Read the section names table, so that sections can be named;*/
+	return __stream_section(env, hdr->e_shstrndx);
 	
 }
 
 /**
- * __section_header_to_table : updates @table with information regarding on
- * the section referred by section header @hdr; if the entry size is null, a
- * loading error is thrown;
- * @param env : the loading environment;
- * @param hdr : the header of the section to get the table of;
- * @param table : the location where to save table data;
+ * loader_init_stream : initializes the loading environment for an elf file
+ * that is not mapped in RAM; the elf header, the section header table and the
+ * section header string table are read from @stream, and the section cache is
+ * built; other sections will be read by loader_assign_sections, only if the
+ * load requires them;
+ * @param env : the environment to initialize;
+ * @param stream : the stream to read the file from;
+ * @param alloc : the allocator providing memory to the load;
+ * @return 0 if the environment was initialized, LOADER_ERROR_STREAM_READ or
+ * LOADER_ERROR_ALLOCATION if not;
  */
-static void __section_header_to_table(
+u8 loader_init_stream(
 	struct loading_env *env,
-	struct elf64_shdr *hdr,
-	struct elf_table *table,
-	u8 byte_table
+	struct loader_stream *stream,
+	struct loader_allocator *alloc
 )
 {
 	
-	void *start;
-	usize ent_size;
+	u64 start;
+	u8 error;
 	
-	/*Cache the entry size;*/
-	ent_size = hdr->sh_entsize;
+	/*Save the initialization start;*/
+	start = loader_timestamp();
 	
-	/*If the entry size is null, fail or set it to 1;*/
-	if (!ent_size) {
-		if (byte_table) {
-			ent_size = 1;
-		} else {
-			loading_error(env, LOADER_ERR_TYPE_SECT_ENTSIZE_NULL);
-		}
-	}
+	/*Initialize the environment;*/
+	error = __init_stream(env, stream, alloc);
 	
-	/*Initialize the table;*/
-	table->t_start = start = ptr_sum_byte_offset(env->r_hdr, hdr->sh_offset);
-	table->t_end = ptr_sum_byte_offset(start, hdr->sh_size);
-	table->t_bsize = ent_size;
+	/*Save the initialization duration;*/
+	env->r_init_time = loader_timestamp() - start;
+	
+	/*Complete;*/
+	return error;
 	
 }
 
-/*---------------------------------------------------------- symbol definition*/
-
-/*Search a symbol table for a symbol definition;*/
-void *sym_def_find(struct loader_symbol *defs, const char *name)
+/**
+ * loader_stats_start : resets @stats and attaches them to @env, so that
+ * loading phases update them; the duration of the initialization is saved;
+ * must be called after the environment is initialized;
+ * @param env : the loading environment;
+ * @param stats : the stats to reset and attach;
+ */
+void loader_stats_start(
+	struct loading_env *env,
+	struct loader_stats *stats
+)
 {
 	
-	while (defs) {
-		
-		/*If undefined or names do not match, skip;*/
-		if ((!defs->s_defined) || (str_cmp(name, defs->s_name) != 0)) {
-			
-			defs = defs->s_next;
-			continue;
-			
-		}
-		
-		/*If names match, return the defined value;*/
-		return defs->s_addr;
-		
+	u8 *byte;
+	usize size;
+	
+	/*Reset all stats;*/
+	byte = (u8 *) stats;
+	for (size = sizeof(struct loader_stats); size--;) {
+		byte[size] = 0;
 	}
 	
-	/*If no def was found, return 0;*/
-	return 0;
+	/*Save the initialization duration;*/
+	stats->st_time[LOADER_STATS_INIT] = env->r_init_time;
+	
+	/*Attach stats;*/
+	env->r_stats = stats;
 	
 }
 
-/*--------------------------------------------------------- symbols assignment*/
+/*-------------------------------------------------------- sections assignment*/
 
 /**
- * symbol_update_address : attempts to determine the address (value) of a
- * symbol, from its related section; If the index of the symbol's section is
- * undefined or reserved, the symbol's value is reset to 0.
- * If a file format / access error is detected, the provided context is
- * restored with value 1.
- * @param env : a the loading environment.
- * @param sym : the symbol to update the value of.
- * @param rest : the context to restore in case of elf error.
+ * __stream_section_required : determines whether the section at @index must
+ * be read for the load of a streamed file to complete;
+ * @param env : the loading environment;
+ * @param index : the index of the section to check;
+ * @return 1 if the section must be read, 0 if not;
  */
-static void update_symbol_address(
+static u8 __stream_section_required(
 	struct loading_env *env,
-	struct elf64_sym *sym
+	u16 index
 )
 {
 	
-	u16 section_id;
-	struct elf64_shdr *shdr;
-	u8 bad_index;
-	usize value;
-	
-	/*Reset the value;*/
-	value = 0;
-	
-	/*Fetch the symbol's section's index;*/
-	section_id = sym->sy_shndx;
+	struct loader_sections *sections;
+	u32 target;
+	u16 symtab;
 	
-	debug("related to section at index %h", section_id);
+	/*Cache the section cache;*/
+	sections = &env->r_sections;
 	
-	/*Check the section index;*/
-	bad_index = check_section_index(section_id);
+	/*Sections occupying memory during execution are required;*/
+	if (sections->s_flags[index] & SHF_ALLOC)
+		return 1;
 	
-	/*If the index is invalid :*/
-	if (bad_index) {
+	switch (sections->s_type[index]) {
 		
-		debug("bad section index : %d", section_id);
+		/*Symbol tables are required to resolve symbols;*/
+		case SHT_SYMTAB:
+			return 1;
 		
-	} else {
+		/*Relocation tables are required if their target is loaded;*/
+		case SHT_REL:
+		case SHT_RELA:
+			
+			/*Fetch the target section index;*/
+			target = sections->s_info[index];
+			
+			/*If the target index is invalid, let relocation report;*/
+			if (target >= sections->s_count)
+				return 1;
+			
+			return (u8) ((sections->s_flags[target] & SHF_ALLOC) != 0);
+		
+		/*String tables are required if a symbol table uses them;*/
+		case SHT_STRTAB:
+			
+			SECTIONS_ITERATE(sections, symtab) {
+				if ((sections->s_type[symtab] == SHT_SYMTAB) &&
+					(sections->s_link[symtab] == index))
+					return 1;
+			}
+			
+			return 0;
+		
+		/*Other sections, like debug info, are not required;*/
+		default:
+			return 0;
+		
+	}
+	
+}
+
+/**
+ * PROFILE_NONE : the rank of sections that are not ordered by the profile;
+ */
+#define PROFILE_NONE ((u32) -1)
+
+/**
+ * __name_suffix : returns the part of @name following @prefix, 0 if @name
+ * does not start with @prefix;
+ */
+static const char *__name_suffix(
+	const char *name,
+	const char *prefix
+)
+{
+	
+	while (*prefix) {
+		if (*name++ != *prefix++)
+			return 0;
+	}
+	
+	return name;
+	
+}
+
+/**
+ * The profile function struct is the slot of a function of the profile, in
+ * the hash table of the profile's functions;
+ */
+struct __profile_function {
+	
+	/*The slot header, that holds the hash of the function's name;*/
+	struct loader_hash_slot f_slot;
+	
+	/*The function's name;*/
+	const char *f_name;
+	
+	/*The function's rank in the profile;*/
+	u32 f_rank;
+	
+};
+
+/**
+ * __profile_match : determines whether the profile function @slot has the
+ * name @key;
+ */
+static u8 __profile_match(
+	const void *slot,
+	const void *key
+)
+{
+	
+	return (u8) !str_cmp(((const struct __profile_function *) slot)->f_name,
+		(const char *) key);
+	
+}
+
+/**
+ * __profile_table : initializes @table with the functions of env->r_profile,
+ * in slots allocated by the scratch allocator; a function listed twice keeps
+ * its first rank;
+ * @param env : the loading environment;
+ * @param table : the table to initialize;
+ * @return 0 if the table was initialized, LOADER_ERROR_ALLOCATION if not;
+ */
+static u8 __profile_table(
+	struct loading_env *env,
+	struct loader_hash_table *table
+)
+{
+	
+	struct loader_allocator *alloc;
+	struct loader_profile *profile;
+	struct __profile_function *function;
+	u32 slots;
+	u32 probes;
+	u32 hash;
+	u32 rank;
+	
+	/*Size the table to stay half empty;*/
+	profile = env->r_profile;
+	slots = loader_hash_slots(profile->p_count);
+	
+	alloc = env->r_scratch;
+	function = (*alloc->a_alloc)(alloc->a_handle,
+		slots * sizeof(struct __profile_function), sizeof(u64), 0);
+	
+	if (!function)
+		return LOADER_ERROR_ALLOCATION;
+	
+	loader_hash_init(table, function, sizeof(struct __profile_function),
+		slots - 1);
+	
+	probes = 0;
+	
+	for (rank = 0; rank < profile->p_count; rank++) {
+		
+		hash = loader_hash_string(profile->p_functions[rank]);
+		function = loader_hash_find(table, hash, &__profile_match,
+			profile->p_functions[rank], &probes);
+		
+		if ((function->f_slot.s_used) || (!loader_hash_claim(table, function,
+			hash)))
+			continue;
+		
+		function->f_name = profile->p_functions[rank];
+		function->f_rank = rank;
+		
+	}
+	
+	/*If required, count probes;*/
+	if (env->r_stats) {
+		env->r_stats->st_probes += probes;
+	}
+	
+	return 0;
+	
+}
+
+/**
+ * __profile_rank : returns the rank of the code section at @index : the rank
+ * in env->r_profile of the function it holds, or the number of functions of
+ * the profile for unlikely and cold code;
+ * @param env : the loading environment;
+ * @param index : the index of the section;
+ * @param table : the functions of the profile, see __profile_table;
+ * @return the rank of the section, PROFILE_NONE if the section is not read
+ * by the load, is not code, or holds no function of the profile;
+ */
+static u32 __profile_rank(
+	struct loading_env *env,
+	u16 index,
+	struct loader_hash_table *table
+)
+{
+	
+	struct loader_sections *sections;
+	struct __profile_function *function;
+	const char *name;
+	const char *suffix;
+	u32 probes;
+	
+	/*Cache the section cache;*/
+	sections = &env->r_sections;
+	
+	/*Only code sections that are read by the load are ordered;*/
+	if ((sections->s_type[index] != SHT_PROGBITS) ||
+		(!(sections->s_flags[index] & SHF_EXECINSTR)) ||
+		(sections->s_addr[index]) || (!__stream_section_required(env, index)))
+		return PROFILE_NONE;
+	
+	/*Function sections are named .text.<function>;*/
+	name = __name_suffix(section_name(env, index), ".text.");
+	if (!name)
+		return PROFILE_NONE;
+	
+	/*Unlikely and cold code are ranked after all hot functions;*/
+	if (((suffix = __name_suffix(name, "unlikely")) ||
+		(suffix = __name_suffix(name, "cold"))) &&
+		((!*suffix) || (*suffix == '.')))
+		return env->r_profile->p_count;
+	
+	probes = 0;
+	function = loader_hash_find(table, loader_hash_string(name),
+		&__profile_match, name, &probes);
+	
+	/*If required, count probes;*/
+	if (env->r_stats) {
+		env->r_stats->st_probes += probes;
+	}
+	
+	return (function->f_slot.s_used) ? function->f_rank : PROFILE_NONE;
+	
+}
+
+/**
+ * __stream_region : allocates a region for @count code sections and reads
+ * them, packed in the order of @entries;
+ * @param env : the loading environment;
+ * @param entries : the sections to read, as section indexes in low 16 bits;
+ * @param count : the number of sections to read;
+ * @return 0 if all sections were read, LOADER_ERROR_STREAM_READ or
+ * LOADER_ERROR_ALLOCATION if not;
+ */
+static u8 __stream_region(
+	struct loading_env *env,
+	const u64 *entries,
+	u32 count
+)
+{
+	
+	struct loader_allocator *alloc;
+	struct elf64_shdr *shdr;
+	u8 *region;
+	usize size;
+	usize align;
+	usize section_align;
+	u64 flags;
+	u32 entry;
+	u16 index;
+	u8 error;
+	
+	/*If the region is empty, complete;*/
+	if (!count)
+		return 0;
+	
+	/*Determine the size, alignment and flags of the region;*/
+	size = 0;
+	align = 1;
+	flags = 0;
+	
+	for (entry = 0; entry < count; entry++) {
+		
+		index = (u16) entries[entry];
+		shdr = ptr_sum_byte_offset(
+			env->r_shtable.t_start, index * env->r_shtable.t_bsize
+		);
+		
+		section_align = (shdr->sh_addralign) ? (usize) shdr->sh_addralign : 1;
+		size = (size + section_align - 1) & ~(section_align - 1);
+		size += (usize) shdr->sh_size;
+		
+		if (section_align > align)
+			align = section_align;
+		
+		flags |= shdr->sh_flags;
+		
+	}
+	
+	/*Allocate the region;*/
+	alloc = __section_allocator(env, flags);
+	region = (*alloc->a_alloc)(alloc->a_handle, size, align, flags);
+	
+	/*If the allocation failed, fail;*/
+	if (!region) {
+		__error_locate(env, LOADER_PHASE_SECTIONS, (u16) entries[0]);
+		return env->r_error.e_code = LOADER_ERROR_ALLOCATION;
+	}
+	
+	debug("%d bytes of ordered code at %h", size, region);
+	
+	/*Read sections at their offset in the region;*/
+	size = 0;
+	
+	for (entry = 0; entry < count; entry++) {
+		
+		index = (u16) entries[entry];
+		shdr = ptr_sum_byte_offset(
+			env->r_shtable.t_start, index * env->r_shtable.t_bsize
+		);
+		
+		section_align = (shdr->sh_addralign) ? (usize) shdr->sh_addralign : 1;
+		size = (size + section_align - 1) & ~(section_align - 1);
+		
+		error = __stream_section_at(env, index, region + size);
+		
+		if (error) {
+			__error_locate(env, LOADER_PHASE_SECTIONS, index);
+			return env->r_error.e_code = error;
+		}
+		
+		size += (usize) shdr->sh_size;
+		
+		LOADER_TRACE(LOADER_TRACE_SECTIONS, env, LOADER_EVENT_SECTION,
+			LOADER_PHASE_SECTIONS, index, 0, 0, env->r_sections.s_addr[index]);
+		
+	}
+	
+	/*Complete;*/
+	return 0;
+	
+}
+
+/**
+ * __stream_ordered_sections : reads code sections of functions of
+ * env->r_profile packed in a hot region, hottest first, then unlikely and
+ * cold code sections packed in a cold region; other sections are read at
+ * their own location by __stream_assign_sections;
+ * @param env : the loading environment;
+ * @return 0 if ordered sections were read, LOADER_ERROR_STREAM_READ or
+ * LOADER_ERROR_ALLOCATION if not;
+ */
+static u8 __stream_ordered_sections(
+	struct loading_env *env
+)
+{
+	
+	struct loader_sections *sections;
+	struct loader_allocator *alloc;
+	struct loader_hash_table table;
+	u64 *entries;
+	u32 count;
+	u32 hot;
+	u32 rank;
+	u16 index;
+	u8 error;
+	
+	/*Cache the section cache;*/
+	sections = &env->r_sections;
+	
+	/*Allocate the ordered sections list, and hash the profile once;*/
+	alloc = env->r_scratch;
+	entries = (*alloc->a_alloc)(
+		alloc->a_handle, (usize) sections->s_count * sizeof(u64), sizeof(u64), 0
+	);
+	
+	if ((!entries) || (__profile_table(env, &table))) {
+		__error_locate(env, LOADER_PHASE_SECTIONS, 0);
+		return env->r_error.e_code = LOADER_ERROR_ALLOCATION;
+	}
+	
+	/*List ranked sections, then sort them by rank then index;*/
+	count = hot = 0;
+	
+	SECTIONS_ITERATE(sections, index) {
+		
+		rank = __profile_rank(env, index, &table);
+		
+		if (rank == PROFILE_NONE)
+			continue;
+		
+		hot += (u32) (rank < env->r_profile->p_count);
+		entries[count++] = ((u64) rank << 16) | index;
+		
+	}
+	
+	loader_sort(entries, count, sizeof(u64));
+	
+	debug("%d hot and %d cold code sections", hot, count - hot);
+	
+	/*Read the hot region, then the cold region;*/
+	error = __stream_region(env, entries, hot);
+	
+	if (!error) {
+		error = __stream_region(env, entries + hot, count - hot);
+	}
+	
+	return error;
+	
+}
+
+/**
+ * __is_mergeable : determines whether the section at @index can be split in
+ * entries that are merged : it must be loaded, hold entries of sh_entsize
+ * bytes, and be targeted by no relocation table, as its entries move;
+ * @param env : the loading environment;
+ * @param index : the index of the section;
+ * @return 1 if the section can be merged, 0 if not;
+ */
+static u8 __is_mergeable(
+	struct loading_env *env,
+	u16 index
+)
+{
+	
+	struct loader_sections *sections;
+	u16 table;
+	
+	/*Cache the section cache;*/
+	sections = &env->r_sections;
+	
+	if ((sections->s_type[index] != SHT_PROGBITS) ||
+		(!(sections->s_flags[index] & SHF_ALLOC)) ||
+		(!(sections->s_flags[index] & SHF_MERGE)) ||
+		(!sections->s_entsize[index]) ||
+		(sections->s_size[index] % sections->s_entsize[index]))
+		return 0;
+	
+	SECTIONS_ITERATE(sections, table) {
+		if (((sections->s_type[table] == SHT_REL) ||
+			(sections->s_type[table] == SHT_RELA)) &&
+			(sections->s_info[table] == index))
+			return 0;
+	}
+	
+	return 1;
+	
+}
+
+/**
+ * __stream_assign_sections : reads each section required by the load of a
+ * streamed file to its final location; if a profile is provided, code
+ * sections it orders are read first, see __stream_ordered_sections;
+ * @param env : the loading environment;
+ * @return 0 if all sections were read, LOADER_ERROR_STREAM_READ or
+ * LOADER_ERROR_ALLOCATION if not;
+ */
+static u8 __stream_assign_sections(
+	struct loading_env *env
+)
+{
+	struct loader_sections *sections;
+	u16 index;
+	u8 error;
+	
+	/*Cache the section cache;*/
+	sections = &env->r_sections;
+	
+	/*If a profile is provided, read hot and cold code first;*/
+	if (env->r_profile) {
+		
+		error = __stream_ordered_sections(env);
+		
+		if (error)
+			return error;
+		
+	}
+	
+	/*Iterate over sections :*/
+	SECTIONS_ITERATE(sections, index) {
+		
+		/*If the section is already read, or not required, skip;
+		 * sections to merge are read by __merge_sections;*/
+		if ((sections->s_addr[index]) ||
+			(!__stream_section_required(env, index)) ||
+			((env->r_flags & LOADER_FLAG_MERGE_SECTIONS) &&
+				(__is_mergeable(env, index))))
+			continue;
+		
+		/*Read the section;*/
+		error = __stream_section(env, index);
+		
+		/*If the read failed, fail;*/
+		if (error) {
+			__error_locate(env, LOADER_PHASE_SECTIONS, index);
+			return env->r_error.e_code = error;
+		}
+		
+		LOADER_TRACE(LOADER_TRACE_SECTIONS, env, LOADER_EVENT_SECTION,
+			LOADER_PHASE_SECTIONS, index, 0, 0, sections->s_addr[index]);
+		
+	}
+	
+	/*Complete;*/
+	return 0;
+	
+}
+
+/**
+ * __mapped_assign_sections : checks sections of a mapped file, that are used
+ * at their file offset;
+ * @param env : the loading environment;
+ * @return 0 if all sections are valid, LOADER_ERROR_NON_EMPTY_NOBITS_SECTION
+ * if not;
+ */
+static u8 __mapped_assign_sections(
+	struct loading_env *env
+)
+{
+	struct loader_sections *sections;
+	u16 index;
+	
+	/*Cache the section cache;*/
+	sections = &env->r_sections;
+	
+	/*Iterate over sections :*/
+	SECTIONS_ITERATE(sections, index) {
+		
+		/*If the section is of type nobits, with non-null size, fail;*/
+		if ((sections->s_type[index] == SHT_NOBITS) &&
+			(sections->s_size[index] != 0)) {
+			__error_locate(env, LOADER_PHASE_SECTIONS, index);
+			return env->r_error.e_code = LOADER_ERROR_NON_EMPTY_NOBITS_SECTION;
+		}
+		
+		LOADER_TRACE(LOADER_TRACE_SECTIONS, env, LOADER_EVENT_SECTION,
+			LOADER_PHASE_SECTIONS, index, 0, 0, sections->s_addr[index]);
+		
+	}
+	
+	/*Complete;*/
+	return 0;
+	
+}
+
+/**
+ * __merge_entry_size : returns the size of the entry at @data, in a merge
+ * section of @entsize bytes entries with @size bytes left; a string includes
+ * its terminator;
+ * @return the size of the entry, 0 if a string is not terminated;
+ */
+static u64 __merge_entry_size(
+	const u8 *data,
+	u64 size,
+	u64 entsize,
+	u8 strings
+)
+{
+	
+	u64 entry;
+	u64 byte;
+	
+	/*Constants have a fixed size;*/
+	if (!strings)
+		return entsize;
+	
+	/*Strings end with a null char, that must be in the section;*/
+	for (entry = 0; entry + entsize <= size;) {
+		
+		for (byte = 0; (byte < entsize) && (!data[entry + byte]);)
+			byte++;
+		
+		entry += entsize;
+		
+		if (byte == entsize)
+			return entry;
+		
+	}
+	
+	return 0;
+	
+}
+
+/**
+ * __merge_count : returns the number of entries of the mergeable section at
+ * @index, that must be in RAM;
+ * @return the number of entries, 0 if the section is not made of entries;
+ */
+static u64 __merge_count(
+	struct loading_env *env,
+	u16 index
+)
+{
+	
+	struct loader_sections *sections;
+	const u8 *data;
+	u64 offset;
+	u64 entry;
+	u64 count;
+	
+	/*Cache the section cache and the section's content;*/
+	sections = &env->r_sections;
+	data = (const u8 *) sections->s_addr[index];
+	
+	for (count = offset = 0; offset < sections->s_size[index];
+		offset += entry, count++) {
+		
+		entry = __merge_entry_size(data + offset,
+			sections->s_size[index] - offset, sections->s_entsize[index],
+			(u8) ((sections->s_flags[index] & SHF_STRINGS) != 0));
+		
+		if (!entry)
+			return 0;
+		
+	}
+	
+	return count;
+	
+}
+
+/**
+ * __merge_pool : returns the pool entries are merged in; if the caller
+ * provided no process-wide pool, one is allocated for the load, with twice as
+ * many slots as @entries;
+ * @param env : the loading environment;
+ * @param entries : the number of entries of merged sections;
+ * @param pool : the pool to initialize if the load has its own;
+ * @return the pool to use, null if it could not be allocated;
+ */
+static struct loader_merge_pool *__merge_pool(
+	struct loading_env *env,
+	u64 entries,
+	struct loader_merge_pool *pool
+)
+{
+	
+	struct loader_allocator *alloc;
+	struct loader_merge_entry *slots;
+	u32 count;
+	
+	/*If a process-wide pool is provided, use it;*/
+	if (env->r_merge)
+		return env->r_merge;
+	
+	/*Size the pool to stay half empty;*/
+	count = loader_hash_slots((u32) entries);
+	
+	alloc = env->r_scratch;
+	slots = (*alloc->a_alloc)(
+		alloc->a_handle, count * sizeof(struct loader_merge_entry),
+		sizeof(u64), 0
+	);
+	
+	if (!slots)
+		return 0;
+	
+	loader_merge_pool_init(pool, slots, count - 1);
+	
+	return pool;
+	
+}
+
+/**
+ * __merge_section : maps each of the @count entries of the section at @index
+ * to the first identical entry of @pool; entries of a streamed file, read in
+ * scratch memory, that are not pooled yet are copied to a block allocated for
+ * them, that becomes the section; entries of a mapped file are pooled in
+ * place;
+ * @param env : the loading environment;
+ * @param index : the index of the section;
+ * @param pool : the merge pool;
+ * @param count : the number of entries of the section;
+ * @param probes : incremented with the number of slots probed;
+ * @param merged : incremented with the number of entries already pooled;
+ * @return 0 if the section was merged, LOADER_ERROR_ALLOCATION if not;
+ */
+static u8 __merge_section(
+	struct loading_env *env,
+	u16 index,
+	struct loader_merge_pool *pool,
+	u64 count,
+	u32 *probes,
+	u32 *merged
+)
+{
+	
+	struct loader_sections *sections;
+	struct loader_allocator *alloc;
+	struct loader_merge_map *map;
+	struct elf64_shdr *shdr;
+	const u8 *data;
+	const u8 *entry;
+	const u8 *pooled;
+	u8 *dst;
+	u64 offset;
+	u64 size;
+	u64 used;
+	u64 byte;
+	u64 piece;
+	u8 strings;
+	
+	/*Cache the section cache and the section's content;*/
+	sections = &env->r_sections;
+	data = (const u8 *) sections->s_addr[index];
+	strings = (u8) ((sections->s_flags[index] & SHF_STRINGS) != 0);
+	
+	/*Allocate the section's pieces;*/
+	map = env->r_maps + index;
+	alloc = env->r_scratch;
+	map->m_pieces = (*alloc->a_alloc)(alloc->a_handle,
+		(usize) count * sizeof(struct loader_merge_piece), sizeof(u64), 0);
+	
+	if (!map->m_pieces)
+		return LOADER_ERROR_ALLOCATION;
+	
+	map->m_count = count;
+	dst = 0;
+	used = 0;
+	
+	/*If the file is streamed, size the entries that are not pooled yet,
+	 * then allocate them;*/
+	if (env->r_stream) {
+		
+		for (offset = 0; offset < sections->s_size[index]; offset += size) {
+			
+			size = __merge_entry_size(data + offset,
+				sections->s_size[index] - offset, sections->s_entsize[index],
+				strings);
+			
+			if (!loader_merge_lookup(pool, data + offset, size, probes))
+				used += size;
+			
+		}
+		
+		shdr = ptr_sum_byte_offset(
+			env->r_shtable.t_start, index * env->r_shtable.t_bsize
+		);
+		
+		alloc = env->r_data;
+		dst = (used) ? (*alloc->a_alloc)(alloc->a_handle, (usize) used,
+			(usize) shdr->sh_addralign, shdr->sh_flags) : 0;
+		
+		if ((used) && (!dst))
+			return LOADER_ERROR_ALLOCATION;
+		
+		used = 0;
+		
+	}
+	
+	/*Map each entry to the first identical one;*/
+	for (piece = offset = 0; offset < sections->s_size[index];
+		offset += size, piece++) {
+		
+		size = __merge_entry_size(data + offset,
+			sections->s_size[index] - offset, sections->s_entsize[index],
+			strings);
+		
+		entry = data + offset;
+		
+		/*A new entry of a streamed file is copied to the block;*/
+		if ((env->r_stream) &&
+			(!loader_merge_lookup(pool, entry, size, probes))) {
+			
+			for (byte = 0; byte < size; byte++) {
+				dst[used + byte] = entry[byte];
+			}
+			
+			entry = dst + used;
+			used += size;
+			
+		}
+		
+		/*Use the first identical entry, or insert the entry;*/
+		pooled = loader_merge_find(pool, entry, size, probes);
+		*merged += (u32) (pooled != entry);
+		
+		map->m_pieces[piece].p_offset = offset;
+		map->m_pieces[piece].p_addr = (u64) pooled;
+		
+	}
+	
+	/*The section of a streamed file only holds its new entries;*/
+	if (env->r_stream) {
+		sections->s_addr[index] = (dst) ? (u64) dst : map->m_pieces[0].p_addr;
+		sections->s_size[index] = used;
+	}
+	
+	/*Complete;*/
+	return 0;
+	
+}
+
+/**
+ * __merge_sections : splits mergeable sections in entries, see
+ * __is_mergeable, and maps their entries to the first identical entry of
+ * env->r_merge, or of a pool of the load; mergeable sections of a streamed
+ * file are read in scratch memory, and only their new entries are loaded;
+ * sections that are not made of entries are loaded whole;
+ * @param env : the loading environment;
+ * @return 0 if sections were merged, LOADER_ERROR_STREAM_READ or
+ * LOADER_ERROR_ALLOCATION if not;
+ */
+static u8 __merge_sections(
+	struct loading_env *env
+)
+{
+	
+	struct loader_sections *sections;
+	struct loader_allocator *alloc;
+	struct loader_merge_pool load_pool;
+	struct loader_merge_pool *pool;
+	u64 entries;
+	u64 count;
+	u32 probes;
+	u32 merged;
+	u16 index;
+	u8 *dst;
+	u8 error;
+	
+	/*Cache the section cache;*/
+	sections = &env->r_sections;
+	entries = 0;
+	error = 0;
+	
+	/*Read mergeable sections in scratch memory, and count their entries;*/
+	SECTIONS_ITERATE(sections, index) {
+		
+		if (!__is_mergeable(env, index))
+			continue;
+		
+		/*Sections are only read here if they are mergeable;*/
+		if (!sections->s_addr[index]) {
+			
+			alloc = env->r_scratch;
+			dst = (*alloc->a_alloc)(alloc->a_handle,
+				(usize) sections->s_size[index], sizeof(u64), 0);
+			
+			error = (dst) ? __stream_section_at(env, index, dst) :
+				LOADER_ERROR_ALLOCATION;
+			
+			/*If the section is not made of entries, load it whole;*/
+			if ((!error) && (!(count = __merge_count(env, index)))) {
+				error = __stream_section(env, index);
+			}
+			
+			if (error) {
+				__error_locate(env, LOADER_PHASE_SECTIONS, index);
+				return env->r_error.e_code = error;
+			}
+			
+		}
+		
+		entries += __merge_count(env, index);
+		
+	}
+	
+	/*If no section is made of entries, complete;*/
+	if (!entries)
+		return 0;
+	
+	/*Allocate section maps and fetch the pool;*/
+	alloc = env->r_scratch;
+	env->r_maps = (*alloc->a_alloc)(alloc->a_handle,
+		(usize) sections->s_count * sizeof(struct loader_merge_map),
+		sizeof(u64), 0);
+	
+	pool = (env->r_maps) ? __merge_pool(env, entries, &load_pool) : 0;
+	
+	if (!pool) {
+		__error_locate(env, LOADER_PHASE_SECTIONS, 0);
+		return env->r_error.e_code = LOADER_ERROR_ALLOCATION;
+	}
+	
+	SECTIONS_ITERATE(sections, index) {
+		env->r_maps[index].m_pieces = 0;
+		env->r_maps[index].m_count = 0;
+	}
+	
+	probes = merged = 0;
+	
+	/*Merge each section made of entries;*/
+	SECTIONS_ITERATE(sections, index) {
+		
+		if ((!__is_mergeable(env, index)) ||
+			(!(count = __merge_count(env, index))))
+			continue;
+		
+		error = __merge_section(env, index, pool, count, &probes, &merged);
+		
+		if (error) {
+			__error_locate(env, LOADER_PHASE_SECTIONS, index);
+			return env->r_error.e_code = error;
+		}
+		
+		LOADER_TRACE(LOADER_TRACE_SECTIONS, env, LOADER_EVENT_SECTION,
+			LOADER_PHASE_SECTIONS, index, 0, 0, sections->s_addr[index]);
+		
+	}
+	
+	/*If required, update stats;*/
+	if (env->r_stats) {
+		env->r_stats->st_probes += probes;
+		env->r_stats->st_merged += merged;
+	}
+	
+	/*Complete;*/
+	return 0;
+	
+}
+
+/**
+ * __section_in_ram : ensures that the section at @index is in RAM, reading it
+ * if the file is streamed;
+ * @param env : the loading environment;
+ * @param index : the index of the section;
+ * @return 0 if the section is in RAM, LOADER_ERROR_STREAM_READ or
+ * LOADER_ERROR_ALLOCATION if not;
+ */
+static u8 __section_in_ram(
+	struct loading_env *env,
+	u16 index
+)
+{
+	
+	/*Mapped sections and sections already read are in RAM;*/
+	if (env->r_sections.s_addr[index])
+		return 0;
+	
+	return __stream_section(env, index);
+	
+}
+
+/**
+ * __is_root : checks whether the symbol named @name is queried by @roots;
+ * @return 1 if the symbol is queried, 0 if not;
+ */
+static u8 __is_root(
+	struct loader_symbol *roots,
+	const char *name
+)
+{
+	
+	/*Queries that are already defined do not require a section;*/
+	for (; roots; roots = roots->s_next) {
+		if ((!roots->s_defined) && (!str_cmp(name, roots->s_name)))
+			return 1;
+	}
+	
+	return 0;
+	
+}
+
+/**
+ * __collect_sections : marks SHF_ALLOC sections that define symbols of
+ * env->r_roots live, then sections referenced by relocations of live sections,
+ * until no section is added; relocation tables of a streamed file are read
+ * when their target becomes live; other SHF_ALLOC sections are dead : their
+ * SHF_ALLOC flag is cleared in the section cache, so that they are neither
+ * read nor relocated, and their address and the address of the relocation
+ * tables targeting them are reset;
+ * If the file has no symbol table, all sections are kept;
+ * @param env : the loading environment;
+ * @return 0 if sections were collected, LOADER_ERROR_ALLOCATION,
+ * LOADER_ERROR_STREAM_READ or LOADER_ERROR_BAD_TABLE_INDEX if not;
+ */
+static u8 __collect_sections(
+	struct loading_env *env
+)
+{
+	
+	struct loader_sections *sections;
+	struct loader_allocator *alloc;
+	struct elf64_sym *sym;
+	struct elf64_rela *rel;
+	u16 *stack;
+	u16 *first;
+	u16 *next;
+	u8 *live;
+	u64 nb_syms;
+	u64 entry;
+	u32 sym_index;
+	u16 count;
+	u16 depth;
+	u16 symtab;
+	u16 strtab;
+	u16 index;
+	u16 target;
+	u8 error;
+	
+	/*Cache the section cache;*/
+	sections = &env->r_sections;
+	count = sections->s_count;
+	
+	/*Find the symbol table; if there is none, keep all sections;*/
+	SECTIONS_ITERATE(sections, symtab) {
+		if (sections->s_type[symtab] == SHT_SYMTAB)
+			break;
+	}
+	
+	if (symtab == count)
+		return 0;
+	
+	/*Check the string table and entry sizes;*/
+	strtab = (u16) sections->s_link[symtab];
+	if ((strtab >= count) || (!sections->s_entsize[symtab])) {
+		__error_locate(env, LOADER_PHASE_SECTIONS, symtab);
+		return env->r_error.e_code = LOADER_ERROR_BAD_TABLE_INDEX;
+	}
+	
+	/*Allocate the work stack, relocation table lists and live flags;*/
+	alloc = env->r_scratch;
+	stack = (*alloc->a_alloc)(
+		alloc->a_handle, (usize) count * 7, sizeof(u16), 0
+	);
+	
+	if (!stack) {
+		__error_locate(env, LOADER_PHASE_SECTIONS, 0);
+		return env->r_error.e_code = LOADER_ERROR_ALLOCATION;
+	}
+	
+	first = stack + count;
+	next = first + count;
+	live = (u8 *) (next + count);
+	
+	SECTIONS_ITERATE(sections, index) {
+		first[index] = 0;
+		live[index] = 0;
+	}
+	
+	/*Chain relocation tables by target; the null section is never one;*/
+	SECTIONS_ITERATE(sections, index) {
+		
+		target = (u16) sections->s_info[index];
+		
+		if (((sections->s_type[index] == SHT_REL) ||
+			(sections->s_type[index] == SHT_RELA)) &&
+			(sections->s_info[index] < count) && (sections->s_entsize[index])) {
+			next[index] = first[target];
+			first[target] = index;
+		}
+		
+	}
+	
+	/*Read the symbol table and its string table;*/
+	index = symtab;
+	error = __section_in_ram(env, index);
+	if (!error) {
+		error = __section_in_ram(env, index = strtab);
+	}
+	
+	if (error) {
+		__error_locate(env, LOADER_PHASE_SECTIONS, index);
+		return env->r_error.e_code = error;
+	}
+	
+	nb_syms = sections->s_size[symtab] / sections->s_entsize[symtab];
+	depth = 0;
+	
+	/*Sections defining queried symbols are live;*/
+	for (entry = 1; entry < nb_syms; entry++) {
+		
+		sym = (struct elf64_sym *) (sections->s_addr[symtab] +
+			entry * sections->s_entsize[symtab]);
+		
+		index = sym->sy_shndx;
+		
+		if ((check_section_index(index)) || (index >= count) ||
+			(live[index]) || (!(sections->s_flags[index] & SHF_ALLOC)) ||
+			(sym->sy_name >= sections->s_size[strtab]))
+			continue;
+		
+		if (__is_root(env->r_roots,
+			(const char *) sections->s_addr[strtab] + sym->sy_name)) {
+			live[index] = 1;
+			stack[depth++] = index;
+		}
+		
+	}
+	
+	/*Sections referenced by relocations of live sections are live;*/
+	while (depth) {
+		
+		target = stack[--depth];
+		
+		for (index = first[target]; index; index = next[index]) {
+			
+			/*Read the relocation table;*/
+			error = __section_in_ram(env, index);
+			if (error) {
+				__error_locate(env, LOADER_PHASE_SECTIONS, index);
+				return env->r_error.e_code = error;
+			}
+			
+			for (entry = 0; entry < sections->s_size[index];
+				entry += sections->s_entsize[index]) {
+				
+				rel = (struct elf64_rela *) (sections->s_addr[index] + entry);
+				sym_index = ELF64_R_SYM(rel->r_info);
+				
+				/*Invalid indexes are reported by relocation;*/
+				if (sym_index >= nb_syms)
+					continue;
+				
+				sym = (struct elf64_sym *) (sections->s_addr[symtab] +
+					sym_index * sections->s_entsize[symtab]);
+				
+				if ((check_section_index(sym->sy_shndx)) ||
+					(sym->sy_shndx >= count) || (live[sym->sy_shndx]) ||
+					(!(sections->s_flags[sym->sy_shndx] & SHF_ALLOC)))
+					continue;
+				
+				live[sym->sy_shndx] = 1;
+				stack[depth++] = sym->sy_shndx;
+				
+			}
+			
+		}
+		
+	}
+	
+	/*Drop dead sections and the relocation tables targeting them;*/
+	SECTIONS_ITERATE(sections, index) {
+		
+		if ((!(sections->s_flags[index] & SHF_ALLOC)) || (live[index]))
+			continue;
+		
+		LOADER_TRACE(LOADER_TRACE_SECTIONS, env, LOADER_EVENT_DROP,
+			LOADER_PHASE_SECTIONS, index, 0, LOADER_FLAG_GC_SECTIONS, 0);
+		
+		sections->s_flags[index] &= ~(u64) SHF_ALLOC;
+		sections->s_addr[index] = 0;
+		
+		for (target = first[index]; target; target = next[target]) {
+			sections->s_addr[target] = 0;
+		}
+		
+	}
+	
+	/*Complete;*/
+	return 0;
+	
+}
+
+/**
+ * __drop_section : removes the section at @index from the load : its
+ * SHF_ALLOC flag is cleared in the section cache, so that it is not read, and
+ * its address and the address of relocation tables targeting it are reset;
+ * @param env : the loading environment;
+ * @param index : the index of the section;
+ * @param option : the loading option removing the section;
+ */
+static void __drop_section(
+	struct loading_env *env,
+	u16 index,
+	u32 option
+)
+{
+	
+	struct loader_sections *sections;
+	u16 table;
+	
+	/*Cache the section cache;*/
+	sections = &env->r_sections;
+	
+	LOADER_TRACE(LOADER_TRACE_SECTIONS, env, LOADER_EVENT_DROP,
+		env->r_error.e_phase, index, 0, option, 0);
+	
+	sections->s_flags[index] &= ~(u64) SHF_ALLOC;
+	sections->s_addr[index] = 0;
+	
+	SECTIONS_ITERATE(sections, table) {
+		if (((sections->s_type[table] == SHT_REL) ||
+			(sections->s_type[table] == SHT_RELA)) &&
+			(sections->s_info[table] == index))
+			sections->s_addr[table] = 0;
+	}
+	
+}
+
+/**
+ * __dedupe_groups : registers COMDAT groups of the file in env->r_groups;
+ * member sections of groups that were already registered are dropped; the
+ * group of each member section is saved in env->r_members, for symbols to be
+ * published or resolved;
+ * Groups are ignored if no table is provided, if the file has no symbol
+ * table, or if the table is full;
+ * @param env : the loading environment;
+ * @return 0 if groups were processed, LOADER_ERROR_ALLOCATION,
+ * LOADER_ERROR_STREAM_READ or LOADER_ERROR_BAD_TABLE_INDEX if not;
+ */
+static u8 __dedupe_groups(
+	struct loading_env *env
+)
+{
+	
+	struct loader_sections *sections;
+	struct loader_allocator *alloc;
+	struct loader_group *group;
+	struct elf64_sym *sym;
+	u32 *members;
+	u32 *words;
+	u64 nb_words;
+	u64 word;
+	u32 member;
+	u32 probes;
+	u16 count;
+	u16 symtab;
+	u16 strtab;
+	u16 index;
+	u8 inserted;
+	u8 error;
+	
+	/*Cache the section cache;*/
+	sections = &env->r_sections;
+	count = sections->s_count;
+	
+	/*Find the symbol table; if there is none, groups have no signature;*/
+	SECTIONS_ITERATE(sections, symtab) {
+		if (sections->s_type[symtab] == SHT_SYMTAB)
+			break;
+	}
+	
+	if ((!env->r_groups) || (symtab == count))
+		return 0;
+	
+	/*Check the string table and entry sizes;*/
+	strtab = (u16) sections->s_link[symtab];
+	if ((strtab >= count) || (!sections->s_entsize[symtab])) {
+		__error_locate(env, LOADER_PHASE_SECTIONS, symtab);
+		return env->r_error.e_code = LOADER_ERROR_BAD_TABLE_INDEX;
+	}
+	
+	/*Allocate the member map;*/
+	alloc = env->r_scratch;
+	members = (*alloc->a_alloc)(
+		alloc->a_handle, (usize) count * sizeof(u32), sizeof(u32), 0
+	);
+	
+	if (!members) {
+		__error_locate(env, LOADER_PHASE_SECTIONS, 0);
+		return env->r_error.e_code = LOADER_ERROR_ALLOCATION;
+	}
+	
+	SECTIONS_ITERATE(sections, index) {
+		members[index] = 0;
+	}
+	
+	env->r_members = members;
+	probes = 0;
+	
+	SECTIONS_ITERATE(sections, index) {
+		
+		/*Only COMDAT groups of the symbol table are deduplicated;*/
+		if ((sections->s_type[index] != SHT_GROUP) ||
+			(sections->s_link[index] != symtab) ||
+			(sections->s_info[index] * sections->s_entsize[symtab] >=
+				sections->s_size[symtab]))
+			continue;
+		
+		/*Read the group, the symbol table and its string table;*/
+		if ((error = __section_in_ram(env, index)) ||
+			(error = __section_in_ram(env, symtab)) ||
+			(error = __section_in_ram(env, strtab))) {
+			__error_locate(env, LOADER_PHASE_SECTIONS, index);
+			return env->r_error.e_code = error;
+		}
+		
+		words = (u32 *) sections->s_addr[index];
+		nb_words = sections->s_size[index] / sizeof(u32);
+		
+		if ((!nb_words) || (!(words[0] & GRP_COMDAT)))
+			continue;
+		
+		/*The signature is the name of the group's symbol;*/
+		sym = (struct elf64_sym *) (sections->s_addr[symtab] +
+			sections->s_info[index] * sections->s_entsize[symtab]);
+		
+		if (sym->sy_name >= sections->s_size[strtab])
+			continue;
+		
+		group = loader_group_find(env->r_groups,
+			(const char *) sections->s_addr[strtab] + sym->sy_name,
+			&inserted, &probes);
+		
+		/*If the table is full, keep the group;*/
+		if (!group)
+			continue;
+		
+		/*The table outlives the string table, save a copy of the signature;
+		 * if it can't be allocated, free the slot;*/
+		if ((inserted) &&
+			(!(group->g_signature = __copy_name(env, group->g_signature)))) {
+			loader_hash_release(&env->r_groups->t_groups, group);
+			__error_locate(env, LOADER_PHASE_SECTIONS, index);
+			return env->r_error.e_code = LOADER_ERROR_ALLOCATION;
+		}
+		
+		LOADER_TRACE(LOADER_TRACE_SECTIONS, env, LOADER_EVENT_GROUP,
+			LOADER_PHASE_SECTIONS, index, sections->s_info[index], inserted,
+			0);
+		
+		/*Map members to the group; drop members of a known group;*/
+		for (word = 1; word < nb_words; word++) {
+			
+			member = words[word];
+			
+			if (member >= count)
+				continue;
+			
+			members[member] = ((u32) (group -
+				loader_group_at(env->r_groups, 0) + 1) << 1) | !inserted;
+			
+			if (!inserted)
+				__drop_section(env, (u16) member, LOADER_FLAG_DEDUPE_GROUPS);
+			
+		}
+		
+	}
+	
+	/*If required, count probes;*/
+	if (env->r_stats) {
+		env->r_stats->st_probes += probes;
+	}
+	
+	/*Complete;*/
+	return 0;
+	
+}
+
+/**
+ * __publish_group : adds a symbol named @name, at @addr, to the symbols of
+ * @group, that later copies of the group resolve to; the symbol and a copy
+ * of its name are allocated with the data allocator, they outlive the load;
+ * @param env : the loading environment;
+ * @param group : the group;
+ * @param name : the name of the symbol;
+ * @param addr : the address of the symbol;
+ * @return 0 if the symbol was added, LOADER_ERROR_ALLOCATION if not;
+ */
+static u8 __publish_group(
+	struct loading_env *env,
+	struct loader_group *group,
+	const char *name,
+	u64 addr
+)
+{
+	
+	struct loader_allocator *alloc;
+	struct loader_symbol *symbol;
+	
+	alloc = env->r_data;
+	symbol = (*alloc->a_alloc)(
+		alloc->a_handle, sizeof(struct loader_symbol), sizeof(void *), 0
+	);
+	
+	if ((!symbol) || (!(name = __copy_name(env, name))))
+		return LOADER_ERROR_ALLOCATION;
+	
+	symbol->s_name = name;
+	symbol->s_addr = (void *) addr;
+	symbol->s_defined = 1;
+	symbol->s_next = group->g_symbols;
+	group->g_symbols = symbol;
+	
+	return 0;
+	
+}
+
+/**
+ * __publish_group_sections : publishes the address of each loaded member
+ * section of groups registered by the load, named after the section, so that
+ * section symbols of later copies resolve to them;
+ * @param env : the loading environment;
+ * @return 0 if sections were published, LOADER_ERROR_ALLOCATION if not;
+ */
+static u8 __publish_group_sections(
+	struct loading_env *env
+)
+{
+	
+	struct loader_sections *sections;
+	u32 member;
+	u16 index;
+	u8 error;
+	
+	/*Cache the section cache;*/
+	sections = &env->r_sections;
+	
+	SECTIONS_ITERATE(sections, index) {
+		
+		member = env->r_members[index];
+		
+		/*Only loaded members of kept groups are published;*/
+		if ((!member) || (member & 1) || (!sections->s_addr[index]) ||
+			(!(sections->s_flags[index] & SHF_ALLOC)))
+			continue;
+		
+		error = __publish_group(env,
+			loader_group_at(env->r_groups, (member >> 1) - 1),
+			section_name(env, index), sections->s_addr[index]);
+		
+		if (error) {
+			__error_locate(env, LOADER_PHASE_SECTIONS, index);
+			return env->r_error.e_code = error;
+		}
+		
+	}
+	
+	/*Complete;*/
+	return 0;
+	
+}
+
+/**
+ * loader_assign_sections : update all section's values to their RAM addresses;
+ * for a streamed load, SHF_ALLOC sections, symbol tables, their string tables
+ * and relocation tables that apply to SHF_ALLOC sections are allocated and
+ * read to their final location; other sections are not read;
+ * @param env : the loading environment;
+ * @return 0 if all section were assigned correctly, a loading error code if
+ * not; the error is located by env->r_error; any error should halt the
+ * loading;
+*/
+u8 loader_assign_sections(
+	struct loading_env *env
+)
+{
+	u64 start;
+	u8 error;
+	
+	debug_("loader assigning sections");
+	
+	LOADER_TRACE(LOADER_TRACE_PHASES, env, LOADER_EVENT_PHASE_START,
+		LOADER_PHASE_SECTIONS, 0, 0, 0, 0);
+	
+	LOADER_PROBE2(phase_start, env, LOADER_PHASE_SECTIONS);
+	
+	/*Save the phase start;*/
+	start = loader_timestamp();
+	
+	/*If required, drop copies of known groups;*/
+	error = (env->r_flags & LOADER_FLAG_DEDUPE_GROUPS) ?
+		__dedupe_groups(env) : 0;
+	
+	/*If required, drop sections unreachable from queries;*/
+	if ((!error) && (env->r_flags & LOADER_FLAG_GC_SECTIONS)) {
+		error = __collect_sections(env);
+	}
+	
+	/*Read required sections of a streamed file, or check mapped sections;*/
+	if (!error) {
+		error = (env->r_stream) ?
+			__stream_assign_sections(env) : __mapped_assign_sections(env);
+	}
+	
+	/*If required, merge entries of SHF_MERGE sections;*/
+	if ((!error) && (env->r_flags & LOADER_FLAG_MERGE_SECTIONS)) {
+		error = __merge_sections(env);
+	}
+	
+	/*If groups were registered, publish their sections;*/
+	if ((!error) && (env->r_members)) {
+		error = __publish_group_sections(env);
+	}
+	
+	/*If required, update the phase duration;*/
+	if (env->r_stats) {
+		env->r_stats->st_time[LOADER_PHASE_SECTIONS] +=
+			loader_timestamp() - start;
+	}
+	
+	debug_("loader done assigning sections");
+	
+	LOADER_TRACE(LOADER_TRACE_PHASES, env, LOADER_EVENT_PHASE_END,
+		LOADER_PHASE_SECTIONS, 0, 0, error, 0);
+	
+	LOADER_PROBE4(phase_end, env, LOADER_PHASE_SECTIONS, error,
+		env->r_sections.s_count);
+	
+	/*Complete;*/
+	return error;
+	
+}
+
+/*------------------------------------------------------------------ internals*/
+
+/**
+ * table_get_entry : if @index is a valid subscript of @table, returns the
+ * related entry; if not, throws a loading error;
+ * @param env : the loading environment;
+ * @param table : the table to query the entry of;
+ * @param index : the required table subscript;
+ * @return the entry at @index.
+ */
+static void *__get_table_entry(
+	struct loading_env *env,
+	struct elf_table *table,
+	usize index
+)
+{
+	/*Fetch the block ref;*/
+	void *bref = ptr_sum_byte_offset(table->t_start, index * table->t_bsize);
+	
+	/*If bad index, fail;*/
+	if (bref >= table->t_end) {
+		loading_error(env, LOADER_ERROR_BAD_TABLE_INDEX);
+	}
+	
+	/*If the index was valid, complete;*/
+	return bref;
+	
+}
+
+/**
+ * __get_section : if @section_id is a valid section index, and if the related
+ * section has the required type, returns this index; if one of these checks
+ * fail, throws an loading error;
+ * @param section_id : a subscript if the section header table;
+ * @param section_type : the expected type of the section, 0 to ignore check;
+ * @return @section_id;
+ */
+static u16 __get_section(
+	struct loading_env *env,
+	u32 section_id,
+	u32 section_type
+)
+{
+	
+	/*If bad index, fail;*/
+	if (section_id >= env->r_sections.s_count) {
+		loading_error(env, LOADER_ERROR_BAD_TABLE_INDEX);
+	}
+	
+	/*If type check is enabled and bad type, fail;*/
+	if (section_type &&
+		(env->r_sections.s_type[section_id] != section_type)) {
+		loading_error(env, LOADER_ERR_BAD_SECTION_TYPE);
+	}
+	
+	/*Complete;*/
+	return (u16) section_id;
+	
+}
+
+/**
+ * __section_to_table : updates @table with information regarding on the
+ * section at @index; if the entry size is null, a loading error is thrown;
+ * @param env : the loading environment;
+ * @param index : the index of the section to get the table of;
+ * @param table : the location where to save table data;
+ */
+static void __section_to_table(
+	struct loading_env *env,
+	u16 index,
+	struct elf_table *table,
+	u8 byte_table
+)
+{
+	
+	void *start;
+	usize ent_size;
+	
+	/*Cache the entry size;*/
+	ent_size = env->r_sections.s_entsize[index];
+	
+	/*If the entry size is null, fail or set it to 1;*/
+	if (!ent_size) {
+		if (byte_table) {
+			ent_size = 1;
+		} else {
+			loading_error(env, LOADER_ERR_TYPE_SECT_ENTSIZE_NULL);
+		}
+	}
+	
+	/*Initialize the table;*/
+	table->t_start = start = __section_data(env, index);
+	table->t_end = ptr_sum_byte_offset(start, env->r_sections.s_size[index]);
+	table->t_bsize = ent_size;
+	
+}
+
+/*---------------------------------------------------------- symbol definition*/
+
+/*Search a symbol table for a symbol definition; count string comparisons;*/
+void *sym_def_find(
+	struct loader_symbol *defs,
+	const char *name,
+	u32 *compares
+)
+{
+	
+	while (defs) {
+		
+		/*If undefined, skip;*/
+		if (!defs->s_defined) {
+			defs = defs->s_next;
+			continue;
+		}
+		
+		/*If names do not match, skip;*/
+		(*compares)++;
+		if (str_cmp(name, defs->s_name) != 0) {
+			
+			defs = defs->s_next;
+			continue;
+			
+		}
+		
+		/*If names match, return the defined value;*/
+		return defs->s_addr;
+		
+	}
+	
+	/*If no def was found, return 0;*/
+	return 0;
+	
+}
+
+/*--------------------------------------------------------- symbols assignment*/
+
+/**
+ * symbol_update_address : attempts to determine the address (value) of a
+ * symbol, from its related section; If the index of the symbol's section is
+ * undefined or reserved, the symbol's value is reset to 0.
+ * If a file format / access error is detected, the provided context is
+ * restored with value 1.
+ * @param env : a the loading environment.
+ * @param sym : the symbol to update the value of.
+ * @param rest : the context to restore in case of elf error.
+ */
+static void update_symbol_address(
+	struct loading_env *env,
+	struct elf64_sym *sym
+)
+{
+	
+	u16 section_id;
+	struct loader_sections *sections;
+	u8 bad_index;
+	usize value;
+	
+	/*Reset the value;*/
+	value = 0;
+	
+	/*Fetch the symbol's section's index;*/
+	section_id = sym->sy_shndx;
+	
+	/*Check the section index;*/
+	bad_index = check_section_index(section_id);
+	
+	/*If the index is valid :*/
+	if (!bad_index) {
+		
+		/*Check the section; the section should contain program data*/
+		section_id = __get_section(env, section_id, 0);
+		sections = &env->r_sections;
+		
+		/*Symbols of merged sections designate pooled entries;*/
+		if ((env->r_maps) && (env->r_maps[section_id].m_count)) {
+			
+			value = loader_merge_map_addr(env->r_maps + section_id,
+				sym->sy_value);
+			
+		/*Program data and zero-filled data of a streamed file are in RAM,
+		 * unless they were not loaded;*/
+		} else if (((sections->s_type[section_id] == SHT_PROGBITS) ||
+			(sections->s_type[section_id] == SHT_NOBITS)) &&
+			(sections->s_addr[section_id])) {
+			
+			/*If the offset is valid determine the symbol's address;*/
+			value = sym->sy_value + sections->s_addr[section_id];
+			
+		}
+		
+	}
+	
+	/*Save the symbol's value;*/
+	sym->sy_value = value;
+	
+}
+
+/**
+ * __common : returns the symbol of env->r_commons that the common symbol
+ * @sym named @name is, inserted with a copy of @name if it is new, after
+ * merging the declaration of @sym in it;
+ * @param env : the loading environment;
+ * @param sym : the common symbol, whose value is its alignment;
+ * @param name : the symbol's name;
+ * @param probes : incremented with the number of slots probed;
+ * @return the symbol, null if there is no table or if it is full;
+ */
+static struct loader_common *__common(
+	struct loading_env *env,
+	struct elf64_sym *sym,
+	const char *name,
+	u32 *probes
+)
+{
+	
+	struct loader_common *common;
+	u8 inserted;
+	
+	if (!env->r_commons)
+		return 0;
+	
+	common = loader_common_find(env->r_commons, name, &inserted, probes);
+	
+	/*If the table is full, the symbol is the load's;*/
+	if (!common)
+		return 0;
+	
+	/*The table outlives the string table, save a copy of the name; if it
+	 * can't be allocated, free the slot;*/
+	if ((inserted) && (!(common->c_name = __copy_name(env, name)))) {
+		loader_hash_release(&env->r_commons->t_commons, common);
+		loading_error(env, LOADER_ERROR_ALLOCATION);
+	}
+	
+	/*If the symbol is placed and can't hold the declaration, fail;*/
+	if (loader_common_declare(common, sym->sy_size, sym->sy_value))
+		loading_error(env, LOADER_ERROR_BAD_COMMON_SIZE);
+	
+	return common;
+	
+}
+
+/**
+ * __allocate_commons : lays out common symbols of @symtable densely, in
+ * declaration order and with their required alignment, in a single
+ * zero-filled block allocated like a .bss section, and assigns each symbol
+ * its address in the block; if env->r_commons is set, common symbols merge
+ * by name with those of the link set : a symbol placed by a previous load
+ * resolves to it, others are laid out with their largest declared size and
+ * alignment, and recorded as placed; if the symbol table was already
+ * assigned, common symbols are already placed, and are left unchanged;
+ * @param env : the loading environment;
+ * @param symtable : the symbol table;
+ * @param str_table : the symbol table's string table;
+ * @param probes : incremented with the number of slots probed;
+ */
+static void __allocate_commons(
+	struct loading_env *env,
+	struct elf_table *symtable,
+	struct elf_table *str_table,
+	u32 *probes
+)
+{
+	
+	struct loader_allocator *alloc;
+	struct loader_common *common;
+	struct elf64_sym *sym;
+	const char *name;
+	u64 size;
+	u64 align;
+	u64 max_align;
+	u8 commons;
+	u8 inserted;
+	u8 *block;
+	
+	/*If common symbols are already placed, their value is their address;*/
+	if (env->r_common_block)
+		return;
+	
+	size = 0;
+	max_align = 1;
+	commons = 0;
+	
+	/*Lay out common symbols, their value is their alignment;*/
+	TABLE_ITERATE((*symtable), sym) {
+		
+		if (sym->sy_shndx != SHN_COMMON)
+			continue;
+		
+		align = sym->sy_value;
+		commons = 1;
+		
+		/*If the alignment is not a power of 2, fail;*/
+		if ((!align) || (align & (align - 1)))
+			loading_error(env, LOADER_ERROR_BAD_COMMON_ALIGN);
+		
+		name = __get_table_entry(env, str_table, sym->sy_name);
+		common = __common(env, sym, name, probes);
+		
+		/*A symbol placed by a previous load resolves to it;*/
+		if ((common) && (common->c_addr)) {
+			sym->sy_value = (u64) common->c_addr;
+			continue;
+		}
+		
+		/*A symbol of the link set uses its largest declaration;*/
+		if (common) {
+			align = common->c_align;
+		}
+		
+		if (align > max_align)
+			max_align = align;
+		
+		/*Save the symbol's offset in the block;*/
+		size = (size + align - 1) & ~(align - 1);
+		sym->sy_value = size;
+		size += (common) ? common->c_size : sym->sy_size;
+		
+	}
+	
+	/*If no common symbol is declared, complete;*/
+	if (!commons)
+		return;
+	
+	/*Allocate the block as a zero-filled writable section;*/
+	alloc = env->r_data;
+	block = (*alloc->a_alloc)(
+		alloc->a_handle, (usize) (size ? size : 1), (usize) max_align,
+		SHF_ALLOC | SHF_WRITE
+	);
+	
+	/*If the allocation failed, fail;*/
+	if (!block)
+		loading_error(env, LOADER_ERROR_ALLOCATION);
+	
+	debug("%d bytes of common symbols at %h", size, block);
+	
+	env->r_common_block = block;
+	
+	while (size--) {
+		block[size] = 0;
+	}
+	
+	/*Relocate common symbols to the block, and record symbols of the link
+	 * set as placed;*/
+	TABLE_ITERATE((*symtable), sym) {
+		
+		if (sym->sy_shndx != SHN_COMMON)
+			continue;
+		
+		common = (env->r_commons) ? loader_common_find(env->r_commons,
+			__get_table_entry(env, str_table, sym->sy_name), &inserted,
+			probes) : 0;
+		
+		if (!common) {
+			sym->sy_value += (u64) block;
+			continue;
+		}
+		
+		if (!common->c_addr) {
+			common->c_addr = block + sym->sy_value;
+		}
+		
+		sym->sy_value = (u64) common->c_addr;
+		
+	}
+	
+}
+
+/**
+ * __merge_target : returns the address a relocation against @sym with the
+ * addend at @addend designates; assemblers only use the section symbol of a
+ * SHF_MERGE section if the addend is the offset of the entry : if @sym is the
+ * section symbol of a merged section, the pooled entry at that offset is
+ * returned, and the addend is reset; otherwise, the symbol's value is;
+ * @param env : the loading environment;
+ * @param sym : the symbol, whose value is its address;
+ * @param addend : the relocation's addend;
+ * @return the address of the relocation's target;
+ */
+static u64 __merge_target(
+	struct loading_env *env,
+	struct elf64_sym *sym,
+	s64 *addend
+)
+{
+	
+	u64 target;
+	
+	/*Only section symbols of merged sections are rewritten;*/
+	if ((!env->r_maps) || (*addend < 0) ||
+		(ELF_SY_INFO_TO_TYPE(sym->sy_info) != SYT_SECTION) ||
+		(check_section_index(sym->sy_shndx)) ||
+		(sym->sy_shndx >= env->r_sections.s_count) ||
+		(!env->r_maps[sym->sy_shndx].m_count))
+		return sym->sy_value;
+	
+	target = loader_merge_map_addr(env->r_maps + sym->sy_shndx, (u64) *addend);
+	*addend = 0;
+	
+	return target;
+	
+}
+
+/**
+ * __group_symbol : if the section of @sym belongs to a dropped group copy,
+ * resolves @sym in the symbols of the first copy, by name, or by section name
+ * for a section symbol; if it belongs to a group registered by the load, and
+ * is global, publishes it;
+ * @param env : the loading environment;
+ * @param sym : the symbol, whose value is its address;
+ * @param name : the symbol's name;
+ * @param compares : incremented with the number of string comparisons;
+ */
+static void __group_symbol(
+	struct loading_env *env,
+	struct elf64_sym *sym,
+	const char *name,
+	u32 *compares
+)
+{
+	
+	struct loader_group *group;
+	u32 member;
+	u8 error;
+	
+	/*If the symbol is not defined in a group member, nothing to do;*/
+	if ((check_section_index(sym->sy_shndx)) ||
+		(sym->sy_shndx >= env->r_sections.s_count) ||
+		(!(member = env->r_members[sym->sy_shndx])))
+		return;
+	
+	group = loader_group_at(env->r_groups, (member >> 1) - 1);
+	
+	/*If the copy was dropped, resolve to the first copy;*/
+	if (member & 1) {
+		
+		if (ELF_SY_INFO_TO_TYPE(sym->sy_info) == SYT_SECTION)
+			name = section_name(env, sym->sy_shndx);
+		
+		sym->sy_value = (u64) sym_def_find(group->g_symbols, name, compares);
+		
+		return;
+		
+	}
+	
+	/*If the symbol is visible from other objects, publish it;*/
+	if ((sym->sy_value) &&
+		(ELF_SY_INFO_TO_BIND(sym->sy_info) != SYB_LOCAL) &&
+		(ELF_SY_INFO_TO_TYPE(sym->sy_info) != SYT_SECTION)) {
+		
+		error = __publish_group(env, group, name, sym->sy_value);
+		
+		if (error)
+			loading_error(env, error);
+		
+	}
+	
+}
+
+/*------------------------------------------------------------- code folding */
+
+/**
+ * __fold_candidate : determines whether the section at @index can be folded :
+ * it must hold loaded read-only code, not belong to a group, and all
+ * relocation tables targeting it, chained from @first by @next, must be
+ * loaded and use the symbol table at @symtab;
+ * @return 1 if the section can be folded, 0 if not;
+ */
+static u8 __fold_candidate(
+	struct loading_env *env,
+	u16 index,
+	u16 symtab,
+	u16 *first,
+	u16 *next
+)
+{
+	
+	struct loader_sections *sections;
+	u16 table;
+	
+	/*Cache the section cache;*/
+	sections = &env->r_sections;
+	
+	if ((sections->s_type[index] != SHT_PROGBITS) ||
+		((sections->s_flags[index] & (SHF_ALLOC | SHF_EXECINSTR | SHF_WRITE))
+			!= (SHF_ALLOC | SHF_EXECINSTR)) ||
+		(!sections->s_addr[index]) || (!sections->s_size[index]) ||
+		((env->r_members) && (env->r_members[index])))
+		return 0;
+	
+	for (table = first[index]; table; table = next[table]) {
+		if ((!sections->s_addr[table]) || (sections->s_link[table] != symtab))
+			return 0;
+	}
+	
+	return 1;
+	
+}
+
+/**
+ * __fold_signature : describes the section at @index in @section : its
+ * relocations are saved in @relocations, sorted by offset, with symbols
+ * inside the section as offsets, so that sections referencing themselves
+ * fold, other symbols as addresses; its hash covers its unrelocated bytes
+ * and its relocations;
+ * @param env : the loading environment;
+ * @param index : the index of the section;
+ * @param symtable : the symbol table, whose symbols are assigned;
+ * @param first : the first relocation table targeting each section;
+ * @param next : the next relocation table targeting the same section;
+ * @param relocations : the relocation array, large enough for the section;
+ * @param section : the entry to describe the section in;
+ * @param hash : the location where to save the hash;
+ * @return 1 if the section was described, 0 if a relocation is invalid;
+ */
+static u8 __fold_signature(
+	struct loading_env *env,
+	u16 index,
+	struct elf_table *symtable,
+	u16 *first,
+	u16 *next,
+	struct loader_fold_relocation *relocations,
+	struct loader_fold_entry *section,
+	u32 *hash
+)
+{
+	
+	struct loader_sections *sections;
+	struct loader_fold_relocation *relocation;
+	struct elf64_rela *rel;
+	struct elf64_sym *sym;
+	const u8 *data;
+	u64 start;
+	u64 size;
+	u64 entry;
+	u16 table;
+	u8 width;
+	u8 byte;
+	
+	/*Cache the section cache and the section's range;*/
+	sections = &env->r_sections;
+	start = sections->s_addr[index];
+	size = sections->s_size[index];
+	data = (const u8 *) start;
+	relocation = relocations;
+	
+	for (table = first[index]; table; table = next[table]) {
+		
+		for (entry = 0; entry < sections->s_size[table];
+			entry += sections->s_entsize[table]) {
+			
+			rel = (struct elf64_rela *) (sections->s_addr[table] + entry);
+			width = loader_relocation_width(ELF64_R_TYPE(rel->r_info));
+			sym = ptr_sum_byte_offset(symtable->t_start,
+				(usize) ELF64_R_SYM(rel->r_info) * symtable->t_bsize);
+			
+			/*Invalid relocations are reported by relocation;*/
+			if ((!ELF64_R_SYM(rel->r_info)) || ((void *) sym >= symtable->t_end) ||
+				(!sym->sy_value) || (!width) || (rel->r_offset > size) ||
+				(rel->r_offset + width > size))
+				return 0;
+			
+			/*Save the offset, the type, the target and the addend;*/
+			relocation->r_offset = rel->r_offset;
+			relocation->r_target = sym->sy_value;
+			relocation->r_addend = 0;
+			relocation->r_type = (u32) ELF64_R_TYPE(rel->r_info);
+			relocation->r_width = width;
+			relocation->r_self = 0;
+			
+			if (sections->s_type[table] == SHT_RELA) {
+				relocation->r_addend = rel->r_addend;
+				relocation->r_target = __merge_target(env, sym,
+					&relocation->r_addend);
+			} else {
+				for (byte = 0; byte < width; byte++) {
+					((u8 *) &relocation->r_addend)[byte] =
+						data[rel->r_offset + byte];
+				}
+			}
+			
+			if ((relocation->r_target >= start) &&
+				(relocation->r_target <= start + size)) {
+				relocation->r_self = 1;
+				relocation->r_target -= start;
+			}
+			
+			relocation++;
+			
+		}
+		
+	}
+	
+	/*Relocations start with their offset;*/
+	section->f_addr = start;
+	section->f_size = size;
+	section->f_relocations = relocations;
+	section->f_nb_relocations = (u32) (relocation - relocations);
+	loader_sort(relocations, section->f_nb_relocations,
+		sizeof(struct loader_fold_relocation));
+	
+	*hash = loader_hash_bytes(
+		loader_hash_bytes(LOADER_HASH_BASIS, &size, sizeof(u64)),
+		data, size
+	);
+	
+	*hash = loader_hash_bytes(*hash, relocations,
+		section->f_nb_relocations * sizeof(struct loader_fold_relocation));
+	
+	return 1;
+	
+}
+
+/**
+ * __fold_register : saves the relocations of the first copy @entry, so that
+ * they outlive @table; if they can't be allocated, the entry is freed, and
+ * an allocation error is thrown;
+ * @param env : the loading environment;
+ * @param table : the table; allocations are scratch if it is the load's;
+ * @param entry : the entry of the first copy;
+ * @param local : set if the table is the load's;
+ */
+static void __fold_register(
+	struct loading_env *env,
+	struct loader_fold_table *table,
+	struct loader_fold_entry *entry,
+	u8 local
+)
+{
+	
+	struct loader_allocator *alloc;
+	struct loader_fold_relocation *relocations;
+	u32 index;
+	
+	if (!entry->f_nb_relocations) {
+		entry->f_relocations = 0;
+		return;
+	}
+	
+	alloc = (local) ? env->r_scratch : env->r_data;
+	relocations = (*alloc->a_alloc)(alloc->a_handle,
+		entry->f_nb_relocations * sizeof(struct loader_fold_relocation),
+		sizeof(u64), 0);
+	
+	if (!relocations) {
+		loader_hash_release(&table->t_entries, entry);
+		loading_error(env, LOADER_ERROR_ALLOCATION);
+	}
+	
+	for (index = 0; index < entry->f_nb_relocations; index++) {
+		relocations[index] = entry->f_relocations[index];
+	}
+	
+	entry->f_relocations = relocations;
+	
+}
+
+/**
+ * __fold_section : folds the section at @index into the identical code at
+ * @addr : symbols of @symtable it defines and queries resolved in it are
+ * moved to the same offset of the copy, and the section is dropped;
+ * @param env : the loading environment;
+ * @param index : the index of the section to fold;
+ * @param addr : the address of the first copy;
+ * @param symtable : the symbol table;
+ * @param queries : the queries resolved by the symbol table;
+ */
+static void __fold_section(
+	struct loading_env *env,
+	u16 index,
+	u64 addr,
+	struct elf_table *symtable,
+	struct loader_symbol *queries
+)
+{
+	
+	struct elf64_sym *sym;
+	u64 start;
+	u64 end;
+	
+	/*Cache the section's range;*/
+	start = env->r_sections.s_addr[index];
+	end = start + env->r_sections.s_size[index];
+	
+	LOADER_TRACE(LOADER_TRACE_SECTIONS, env, LOADER_EVENT_FOLD,
+		LOADER_PHASE_SYMBOLS, index, 0, 0, addr);
+	
+	TABLE_ITERATE((*symtable), sym) {
+		if ((sym->sy_shndx == index) && (sym->sy_value)) {
+			sym->sy_value = sym->sy_value - start + addr;
+		}
+	}
+	
+	for (; queries; queries = queries->s_next) {
+		if ((queries->s_defined) && ((u64) queries->s_addr >= start) &&
+			((u64) queries->s_addr < end))
+			queries->s_addr = (void *) ((u64) queries->s_addr - start + addr);
+	}
+	
+	__drop_section(env, index, LOADER_FLAG_FOLD_CODE);
+	
+}
+
+/**
+ * __fold_sections : folds each read-only code section of the file into the
+ * first identical copy of env->r_folds, or of a table allocated for the load
+ * if it is null; copies are identical if they have the same bytes out of
+ * relocated fields, and the same relocations, compared by offset, type,
+ * target and addend, so that they behave the same from any address;
+ * sections that are not folded are registered, with their relocations;
+ * Must be called once symbols are assigned, before relocations are applied;
+ * @param env : the loading environment;
+ * @param symtab : the index of the symbol table;
+ * @param symtable : the symbol table;
+ * @param queries : the queries resolved by the symbol table;
+ */
+static void __fold_sections(
+	struct loading_env *env,
+	u16 symtab,
+	struct elf_table *symtable,
+	struct loader_symbol *queries
+)
+{
+	
+	struct loader_sections *sections;
+	struct loader_allocator *alloc;
+	struct loader_fold_table load_table;
+	struct loader_fold_table *folds;
+	struct loader_fold_entry *entry;
+	struct loader_fold_entry section;
+	struct loader_fold_relocation *relocations;
+	u16 *first;
+	u16 *next;
+	u64 bytes;
+	u32 hash;
+	u32 candidates;
+	u32 largest;
+	u32 nb_relocations;
+	u32 slots;
+	u32 probes;
+	u32 folded;
+	u16 count;
+	u16 index;
+	u16 target;
+	
+	/*Cache the section cache and the allocator;*/
+	sections = &env->r_sections;
+	count = sections->s_count;
+	alloc = env->r_scratch;
+	
+	/*Allocate relocation table lists;*/
+	first = (*alloc->a_alloc)(
+		alloc->a_handle, (usize) count * 2 * sizeof(u16), sizeof(u16), 0
+	);
+	
+	if (!first)
+		loading_error(env, LOADER_ERROR_ALLOCATION);
+	
+	next = first + count;
+	
+	SECTIONS_ITERATE(sections, index) {
+		first[index] = 0;
+	}
+	
+	/*Chain relocation tables by target; the null section is never one;*/
+	SECTIONS_ITERATE(sections, index) {
+		
+		target = (u16) sections->s_info[index];
+		
+		if (((sections->s_type[index] == SHT_REL) ||
+			(sections->s_type[index] == SHT_RELA)) &&
+			(sections->s_info[index] < count) && (sections->s_entsize[index])) {
+			next[index] = first[target];
+			first[target] = index;
+		}
+		
+	}
+	
+	/*Count candidates, and relocations of the most relocated one;*/
+	candidates = largest = 0;
+	SECTIONS_ITERATE(sections, index) {
+		
+		if (!__fold_candidate(env, index, symtab, first, next))
+			continue;
+		
+		candidates++;
+		nb_relocations = 0;
+		
+		for (target = first[index]; target; target = next[target]) {
+			nb_relocations +=
+				(u32) (sections->s_size[target] / sections->s_entsize[target]);
+		}
+		
+		if (nb_relocations > largest)
+			largest = nb_relocations;
+		
+	}
+	
+	if (!candidates)
+		return;
+	
+	/*Allocate the relocations of a candidate;*/
+	relocations = (*alloc->a_alloc)(alloc->a_handle,
+		(largest + 1) * sizeof(struct loader_fold_relocation), sizeof(u64), 0);
+	
+	if (!relocations)
+		loading_error(env, LOADER_ERROR_ALLOCATION);
+	
+	/*If no process-wide table is provided, size one to stay half empty;*/
+	folds = env->r_folds;
+	if (!folds) {
+		
+		slots = loader_hash_slots(candidates);
+		
+		entry = (*alloc->a_alloc)(
+			alloc->a_handle, slots * sizeof(struct loader_fold_entry),
+			sizeof(u64), 0
+		);
+		
+		if (!entry)
+			loading_error(env, LOADER_ERROR_ALLOCATION);
+		
+		loader_fold_table_init(folds = &load_table, entry, slots - 1);
+		
+	}
+	
+	bytes = 0;
+	probes = folded = 0;
+	
+	/*Fold each candidate into its first copy, or register it;*/
+	SECTIONS_ITERATE(sections, index) {
+		
+		if ((!__fold_candidate(env, index, symtab, first, next)) ||
+			(!__fold_signature(env, index, symtable, first, next, relocations,
+				&section, &hash)))
+			continue;
+		
+		entry = loader_fold_find(folds, hash, &section, &probes);
+		
+		/*If the table is full, keep the section;*/
+		if (!entry)
+			continue;
+		
+		/*If the section is the first copy, keep it, and its relocations;*/
+		if (entry->f_addr == section.f_addr) {
+			__fold_register(env, folds, entry, (u8) (folds == &load_table));
+			continue;
+		}
+		
+		folded++;
+		bytes += sections->s_size[index];
+		
+		__fold_section(env, index, entry->f_addr, symtable, queries);
+		
+	}
+	
+	/*If required, update stats;*/
+	if (env->r_stats) {
+		env->r_stats->st_probes += probes;
+		env->r_stats->st_folded += folded;
+		env->r_stats->st_folded_bytes += bytes;
+	}
+	
+}
+
+/**
+ * __is_export : determines whether @sym is a global definition, that is
+ * exported by the module;
+ */
+#define __is_export(sym) \
+	(((sym)->sy_value) && ((sym)->sy_shndx != SHN_UNDEF) && \
+		(ELF_SY_INFO_TO_BIND((sym)->sy_info) != SYB_LOCAL) && \
+		(ELF_SY_INFO_TO_TYPE((sym)->sy_info) != SYT_SECTION) && \
+		(ELF_SY_INFO_TO_TYPE((sym)->sy_info) != SYT_FILE))
+
+/**
+ * __is_function : determines whether @sym is a function of a loaded section,
+ * that is indexed by address;
+ */
+#define __is_function(env, sym) \
+	(((sym)->sy_value) && (!check_section_index((sym)->sy_shndx)) && \
+		((sym)->sy_shndx < (env)->r_sections.s_count) && \
+		((env)->r_sections.s_addr[(sym)->sy_shndx]) && \
+		(ELF_SY_INFO_TO_TYPE((sym)->sy_info) == SYT_FUNC))
+
+/**
+ * __is_code : determines whether the section at @index is loaded executable
+ * code;
+ */
+#define __is_code(sections, index) \
+	(((sections)->s_flags[index] & SHF_EXECINSTR) && \
+		((sections)->s_addr[index]) && ((sections)->s_size[index]))
+
+/**
+ * __index_module : indexes global definitions of @symtable in env->r_module,
+ * and its functions and code ranges by address; each loaded executable
+ * section is a code range, as the code allocator may place other modules'
+ * code between them; export slots, functions, ranges and the name block are
+ * allocated by the data allocator; the table has at least twice as many slots
+ * as exports;
+ * @param env : the loading environment;
+ * @param symtable : the symbol table, whose symbols are assigned;
+ * @param str_table : the string table of the symbol table;
+ */
+static void __index_module(
+	struct loading_env *env,
+	struct elf_table *symtable,
+	struct elf_table *str_table
+)
+{
+	
+	struct loader_sections *sections;
+	struct loader_allocator *alloc;
+	struct loader_module *module;
+	struct loader_export *exports;
+	struct loader_function *functions;
+	struct loader_code_range *ranges;
+	struct elf64_sym *sym;
+	const char *name;
+	char *names;
+	usize length;
+	u32 count;
+	u32 nb_functions;
+	u32 nb_ranges;
+	u32 slots;
+	u8 copies;
+	u16 index;
+	
+	/*Cache the section cache and the module;*/
+	sections = &env->r_sections;
+	module = env->r_module;
+	
+	/*Count exports, functions, and the size of their names;*/
+	count = nb_functions = 0;
+	length = 0;
+	TABLE_ITERATE((*symtable), sym) {
+		
+		copies = (u8) (__is_export(sym) + __is_function(env, sym));
+		
+		if (!copies)
+			continue;
+		
+		count += (u32) __is_export(sym);
+		nb_functions += (u32) __is_function(env, sym);
+		name = __get_table_entry(env, str_table, sym->sy_name);
+		
+		/*Count the name and its terminator, once per copy;*/
+		do {
+			length += copies;
+		} while (*(name++));
+		
+	}
+	
+	/*Count loaded executable sections;*/
+	nb_ranges = 0;
+	SECTIONS_ITERATE(sections, index) {
+		nb_ranges += (u32) (__is_code(sections, index));
+	}
+	
+	/*Size the table to stay half empty;*/
+	slots = loader_hash_slots(count);
+	
+	alloc = env->r_data;
+	exports = (*alloc->a_alloc)(
+		alloc->a_handle, slots * sizeof(struct loader_export), sizeof(u64), 0
+	);
+	
+	functions = (exports) ? (*alloc->a_alloc)(alloc->a_handle,
+		nb_functions * sizeof(struct loader_function), sizeof(u64), 0) : 0;
+	
+	ranges = (exports) ? (*alloc->a_alloc)(alloc->a_handle,
+		nb_ranges * sizeof(struct loader_code_range), sizeof(u64), 0) : 0;
+	
+	names = (exports) ? (*alloc->a_alloc)(alloc->a_handle, length, 1, 0) : 0;
+	
+	if ((!exports) || ((nb_functions) && (!functions)) ||
+		((nb_ranges) && (!ranges)) || ((length) && (!names)))
+		loading_error(env, LOADER_ERROR_ALLOCATION);
+	
+	loader_module_init(module, exports, slots - 1, functions, ranges, names);
+	
+	/*Export definitions and index functions;*/
+	TABLE_ITERATE((*symtable), sym) {
+		
+		name = __get_table_entry(env, str_table, sym->sy_name);
+		
+		if (__is_export(sym)) {
+			loader_module_export(module, name, (void *) sym->sy_value);
+		}
+		
+		if (__is_function(env, sym)) {
+			loader_module_function(module, name, sym->sy_value, sym->sy_size);
+		}
+		
+	}
+	
+	/*Each loaded executable section is a code range;*/
+	SECTIONS_ITERATE(sections, index) {
+		
+		if (__is_code(sections, index)) {
+			loader_module_code(module, sections->s_addr[index],
+				sections->s_addr[index] + sections->s_size[index]);
+		}
+		
+	}
+	
+	loader_module_sort(module);
+	
+}
+
+/**
+ * __counter_target : returns the function whose calls @counter counts : the
+ * value of a resolved import of the function, or else the address of its
+ * query;
+ * @param env : the loading environment;
+ * @param symtable : the symbol table, whose symbols are assigned;
+ * @param str_table : the string table of the symbol table;
+ * @param queries : the queries resolved by the symbol table;
+ * @param counter : the counter;
+ * @return the function's address, 0 if it is neither imported nor queried;
+ */
+static u64 __counter_target(
+	struct loading_env *env,
+	struct elf_table *symtable,
+	struct elf_table *str_table,
+	struct loader_symbol *queries,
+	struct loader_counter *counter
+)
+{
+	
+	struct loader_symbol *query;
+	struct elf64_sym *sym;
+	
+	TABLE_ITERATE((*symtable), sym) {
+		if ((sym->sy_shndx == SHN_UNDEF) && (sym->sy_value) &&
+			(!str_cmp(__get_table_entry(env, str_table, sym->sy_name),
+				counter->c_name)))
+			return sym->sy_value;
+	}
+	
+	for (query = queries; query; query = query->s_next) {
+		if ((query->s_defined) && (!str_cmp(query->s_name, counter->c_name)))
+			return (u64) query->s_addr;
+	}
+	
+	return 0;
+	
+}
+
+/**
+ * __count_calls : routes imports and exported queries of functions of
+ * env->r_counters through counting thunks; thunks are written in an island,
+ * allocated as executable memory, with a slot per counter of a function
+ * that is imported or queried; definitions keep their value so that the
+ * module's index and its code hook see functions at their address, calls
+ * from inside the module are not counted;
+ * @param env : the loading environment;
+ * @param symtable : the symbol table, whose symbols are assigned;
+ * @param str_table : the string table of the symbol table;
+ * @param queries : the queries resolved by the symbol table;
+ */
+static void __count_calls(
+	struct loading_env *env,
+	struct elf_table *symtable,
+	struct elf_table *str_table,
+	struct loader_symbol *queries
+)
+{
+	
+	struct loader_allocator *alloc;
+	struct loader_counter *counter;
+	struct loader_symbol *query;
+	struct elf64_sym *sym;
+	u8 *island;
+	u8 *thunk;
+	u64 target;
+	usize size;
+	u8 thunk_size;
+	
+	/*Determine the island's size, a thunk per routed function;*/
+	thunk_size = loader_thunk_size();
+	size = 0;
+	for (counter = env->r_counters; counter; counter = counter->c_next) {
+		if (__counter_target(env, symtable, str_table, queries, counter))
+			size += thunk_size;
+	}
+	
+	/*If no function is routed, complete;*/
+	if (!size)
+		return;
+	
+	/*Allocate the island as executable memory;*/
+	alloc = env->r_code;
+	island = (*alloc->a_alloc)(
+		alloc->a_handle, size, thunk_size, SHF_ALLOC | SHF_EXECINSTR
+	);
+	
+	/*If the allocation failed, fail;*/
+	if (!island)
+		loading_error(env, LOADER_ERROR_ALLOCATION);
+	
+	debug("%d bytes of thunks at %h", size, island);
+	
+	thunk = island;
+	for (counter = env->r_counters; counter; counter = counter->c_next) {
+		
+		target = __counter_target(env, symtable, str_table, queries, counter);
+		
+		/*If the function is neither imported nor queried, skip;*/
+		if (!target)
+			continue;
+		
+		/*Route resolved imports of the function through the thunk;*/
+		TABLE_ITERATE((*symtable), sym) {
+			
+			if ((sym->sy_shndx != SHN_UNDEF) || (!sym->sy_value) ||
+				(str_cmp(__get_table_entry(env, str_table, sym->sy_name),
+					counter->c_name) != 0))
+				continue;
+			
+			sym->sy_value = (u64) thunk;
+			
+		}
+		
+		/*Route the query of the function through the thunk;*/
+		for (query = queries; query; query = query->s_next) {
+			
+			if ((!query->s_defined) ||
+				(str_cmp(query->s_name, counter->c_name) != 0))
+				continue;
+			
+			if ((u64) query->s_addr == target) {
+				query->s_addr = thunk;
+			}
+			
+		}
+		
+		loader_write_thunk(thunk, &counter->c_count, target);
+		counter->c_thunks++;
+		thunk += thunk_size;
+		
+	}
+	
+}
+
+/**
+ * assing_symbol_table : places common symbols in a zero-filled block, then
+ * for each symbol in the symbol table :
+ * - if the symbol is defined updates the symbol's address internally and
+ *   updated the list of symbol queries if required;
+ * - if the symbol is not defined, search the list of external definitons
+ *   for an eventual matching symbol, then the registry if provided;
+ * If folding is enabled, identical code sections are then folded; if a
+ * module is provided, global definitions and functions are then indexed in
+ * it;
+ * It it possible that undefined symbols remain after the execution of this
+ * function. Those will have their value assigned to 0;
+ * @param env : the loading environment
+ * @param sym_table_index : symbol table's section index;
+ * @param definitions : a list of defined symbols, that are accessible to the
+ * executable; if undefined symbols with matching names are found in the
+ * executable, their value will be set to the value provided in the list;
+ * @param queries : a set of symbols the executable may define; if defined
+ * symbols with matching names are found in the executable, the list will be
+ * updated with the value of the symbol in the executable;
+ */
+static void assing_symbol_table(
+	struct loading_env *env,
+	u16 sym_table_index,
+	struct loader_symbol *definitions,
+	struct loader_symbol *queries
+)
+{
+	
+	struct elf_table symtable;
+	
+	u16 str_table_index;
+	struct elf_table str_table;
+	struct elf64_sym *sym;
+	
+	u64 start;
+	u32 lookups;
+	u32 compares;
+	u32 probes;
+	
+	debug("assigning symbols in %s", section_name(env, sym_table_index));
+	
+	/*Save the table start, reset counters;*/
+	start = loader_timestamp();
+	lookups = compares = probes = 0;
+	
+	/*Locate eventual errors;*/
+	__error_locate(env, LOADER_PHASE_SYMBOLS, sym_table_index);
+	
+	/*Fetch the symbol table;*/
+	__section_to_table(env, sym_table_index, &symtable, 0);
+	
+	/*Fetch and check the string table id;*/
+	str_table_index = __get_section(
+		env, env->r_sections.s_link[sym_table_index], SHT_STRTAB
+	);
+	
+	/*Fetch table data;*/
+	__section_to_table(env, str_table_index, &str_table, 1);
+	
+	/*Place common symbols;*/
+	__allocate_commons(env, &symtable, &str_table, &probes);
+	
+	/*Iterate over the symbol table;*/
+	TABLE_ITERATE(symtable, sym) {
+		
+		const char *s_name;
+		struct loader_symbol *ext_sym;
+		
+		/*Locate eventual errors;*/
+		env->r_error.e_entry++;
+		
+		/*Fetch the name start;*/
+		s_name = __get_table_entry(env, &str_table, sym->sy_name);
+		
+		/*
+		 * Internal symbol definition;
+		 */
+		
+		/*If the symbol is undefined :*/
+		if (sym->sy_shndx == SHN_UNDEF) {
+			
+			/*If a definition exists, update the value;
+			 * if not, search the registry, or set the symbol's value to 0;*/
+			lookups++;
+			sym->sy_value = (u64) sym_def_find(definitions, s_name, &compares);
+			
+			if ((!sym->sy_value) && (env->r_registry)) {
+				sym->sy_value = (u64) loader_registry_lookup(env->r_registry,
+					env->r_reader, s_name);
+			}
+			
+		} else if (sym->sy_shndx != SHN_COMMON) {
+			
+			/*If the symbol is defined, update its value;
+			 * common symbols are already in their block;*/
+			update_symbol_address(env, sym);
+			
+			/*If required, resolve or publish group symbols;*/
+			if (env->r_members) {
+				__group_symbol(env, sym, s_name, &compares);
+			}
+			
+		}
+		
+		LOADER_TRACE(LOADER_TRACE_ENTRIES, env, LOADER_EVENT_SYMBOL,
+			LOADER_PHASE_SYMBOLS, sym->sy_shndx, env->r_error.e_entry - 1, 0,
+			sym->sy_value);
+		
+		/*If the symbol's value is null, stop here;*/
+		if (!sym->sy_value) {
+			
+			continue;
+		}
+		
+		/*
+		 * External symbols definition;
+		 */
+		
+		/*Initialise the current symbol;*/
+		ext_sym = queries;
+		lookups++;
+		
+		/*For each external symbol:*/
+		while (ext_sym) {
+			
+			/*If the symbol is already defined, skip;*/
+			if (ext_sym->s_defined) {
+				ext_sym = ext_sym->s_next;
+				continue;
+			}
+			
+			/*If symbols names do not match, skip;*/
+			compares++;
+			if (str_cmp(s_name, ext_sym->s_name) != 0) {
+				ext_sym = ext_sym->s_next;
+				continue;
+				
+			}
+			
+			/*Define the external symbol;*/
+			ext_sym->s_defined = 1;
+			ext_sym->s_addr = (void *) sym->sy_value;
+			
+			/*Stop here;*/
+			break;
+			
+		}
+		
+	}
+	
+	/*If required, fold identical code, now that targets are known;*/
+	if (env->r_flags & LOADER_FLAG_FOLD_CODE) {
+		__fold_sections(env, sym_table_index, &symtable, queries);
+	}
+	
+	/*If required, index the module, now that addresses are final;*/
+	if (env->r_module) {
+		__index_module(env, &symtable, &str_table);
+	}
+	
+	/*If required, count calls of imported and queried functions;*/
+	if (env->r_counters) {
+		__count_calls(env, &symtable, &str_table, queries);
+	}
+	
+	/*If required, update stats;*/
+	if (env->r_stats) {
+		env->r_stats->st_time[LOADER_PHASE_SYMBOLS] += loader_timestamp() - start;
+		env->r_stats->st_symbols += env->r_error.e_entry;
+		env->r_stats->st_lookups += lookups;
+		env->r_stats->st_compares += compares;
+		env->r_stats->st_probes += probes;
+	}
+	
+}
+
+/**
+ * loader_declare_commons : declares the common symbols of the file in
+ * env->r_commons, so that each common symbol of a link set is placed with its
+ * largest size and alignment; the loads of the link set must all declare
+ * their common symbols before any of them places its own; the symbol table
+ * and its string table of a streamed file are read;
+ * @param env : the loading environment, whose r_commons is set;
+ * @return 0 if common symbols were declared, a loading error code if not;
+ * the error is located by env->r_error;
+ */
+u8 loader_declare_commons(
+	struct loading_env *env
+)
+{
+	
+	struct loader_sections *sections;
+	struct elf_table symtable;
+	struct elf_table str_table;
+	struct elf64_sym *sym;
+	u32 probes;
+	u16 index;
+	u16 strtab;
+	u8 error_id;
+	
+	probes = 0;
+	
+	try(ctx, error_id) {
+			
+			/*Update the internal error context;*/
+			/*Reset at exception exit, to avoid scope escapism;*/
+			env->r_error_ctx = &ctx;
+			
+			/*Fetch the section cache;*/
+			sections = &env->r_sections;
+			
+			/*Iterate over symbol tables :*/
+			SECTIONS_ITERATE(sections, index) {
+				
+				if (sections->s_type[index] != SHT_SYMTAB)
+					continue;
+				
+				/*Locate eventual errors;*/
+				__error_locate(env, LOADER_PHASE_SYMBOLS, index);
+				
+				/*Fetch the symbol table and its string table;*/
+				strtab = __get_section(env, sections->s_link[index],
+					SHT_STRTAB);
+				
+				if ((error_id = __section_in_ram(env, index)) ||
+					(error_id = __section_in_ram(env, strtab)))
+					loading_error(env, error_id);
+				
+				__section_to_table(env, index, &symtable, 0);
+				__section_to_table(env, strtab, &str_table, 1);
+				
+				/*Declare common symbols, their value is their alignment;*/
+				TABLE_ITERATE(symtable, sym) {
+					
+					env->r_error.e_entry++;
+					
+					if (sym->sy_shndx != SHN_COMMON)
+						continue;
+					
+					if ((!sym->sy_value) ||
+						(sym->sy_value & (sym->sy_value - 1)))
+						loading_error(env, LOADER_ERROR_BAD_COMMON_ALIGN);
+					
+					__common(env, sym,
+						__get_table_entry(env, &str_table, sym->sy_name),
+						&probes);
+					
+				}
+				
+			}
+			
+		}
+	
+	try_end
+	
+	/*If required, update stats;*/
+	if (env->r_stats) {
+		env->r_stats->st_probes += probes;
+	}
+	
+	/*Reset the internal error context to avoid scope escapism;*/
+	env->r_error_ctx = 0;
+	
+	/*Return the error id;*/
+	return env->r_error.e_code = error_id;
+	
+}
+
+/**
+ * loader_assign_symbols : for each symbol in the environment :
+ * - if the symbol is defined updates the symbol's address internally and
+ *   updated the list of symbol queries if required;
+ * - if the symbol is not defined, search the list of external definitions
+ *   for an eventual matching symbol;
+ * It it possible that undefined symbols remain after the execution of this
+ * function. Those will have their value assigned to 0;
+ * @param env : the loading environment
+ * @param definitions : a list of defined symbols, that are accessible to the
+ * executable; if undefined symbols with matching names are found in the
+ * executable, their value will be set to the value provided in the list;
+ * @param queries : a set of symbols the executable may define; if defined
+ * symbols with matching names are found in the executable, the list will be
+ * updated with the value of the symbol in the executable;
+ * @return 0 if all symbols had their value assigned, a loading error code if
+ * not; the error is located by env->r_error; any error should halt the
+ * loading;
+ */
+u8 loader_assign_symbols(
+	struct loading_env *env,
+	struct loader_symbol *defs,
+	struct loader_symbol *undefs
+)
+{
+	
+	struct loader_sections *sections;
+	u32 symbols;
+	u16 index;
+	u8 error_id;
+	
+	debug_("loader assigning symbols");
+	
+	LOADER_TRACE(LOADER_TRACE_PHASES, env, LOADER_EVENT_PHASE_START,
+		LOADER_PHASE_SYMBOLS, 0, 0, 0, 0);
+	
+	LOADER_PROBE2(phase_start, env, LOADER_PHASE_SYMBOLS);
+	
+	symbols = 0;
+	
+	try(ctx, error_id) {
+			
+			/*Update the internal error context;*/
+			/*Reset at exception exit, to avoid scope escapism;*/
+			env->r_error_ctx = &ctx;
+			
+			/*Fetch the section cache;*/
+			sections = &env->r_sections;
+			
+			/*Iterate over sections :*/
+			SECTIONS_ITERATE(sections, index) {
+				
+				/*If the section holds a symbol table :*/
+				if (sections->s_type[index] == SHT_SYMTAB) {
+					
+					/*Assign symbols in the symbol table;*/
+					assing_symbol_table(env, index, defs, undefs);
+					
+					/*If probes are compiled in, count symbols;*/
+					if (LOADER_PROBES) {
+						symbols += env->r_error.e_entry;
+					}
+					
+				}
+				
+			}
+			
+		}
+	
+	
+	try_end
+	
+	debug_("loader done assigning symbols");
+	
+	LOADER_TRACE(LOADER_TRACE_PHASES, env, LOADER_EVENT_PHASE_END,
+		LOADER_PHASE_SYMBOLS, 0, 0, error_id, 0);
+	
+	LOADER_PROBE4(phase_end, env, LOADER_PHASE_SYMBOLS, error_id, symbols);
+	
+	/*Reset the internal error context to avoid scope escapism;*/
+	env->r_error_ctx = 0;
+	
+	/*Return the error id;*/
+	return env->r_error.e_code = error_id;
+	
+}
+
+/*--------------------------------------------------------------- relocations */
+
+/**
+ * __relocation_offset : returns the offset of the @index-th relocation of
+ * @table; rel and rela entries both start with their offset;
+ */
+#define __relocation_offset(table, index) \
+	(((struct elf64_rel *) \
+		ptr_sum_byte_offset((table)->t_start, (index) * (table)->t_bsize)) \
+			->r_offset)
+
+/**
+ * __relocations_sorted : checks whether relocations in @table are ordered by
+ * offset;
+ * @param table : the relocation table to check;
+ * @return 1 if relocations are sorted, 0 if not;
+ */
+static u8 __relocations_sorted(
+	struct elf_table *table
+)
+{
+	
+	usize count;
+	usize index;
+	
+	/*Determine the number of relocations;*/
+	count = ((usize) table->t_end - (usize) table->t_start) / table->t_bsize;
+	
+	/*If any relocation precedes its predecessor, the table is not sorted;*/
+	for (index = 1; index < count; index++) {
+		if (__relocation_offset(table, index) <
+			__relocation_offset(table, index - 1))
+			return 0;
+	}
+	
+	/*Complete;*/
+	return 1;
+	
+}
+
+/**
+ * sort_relocation_table : sorts the relocations of @table by offset, in place,
+ * so that relocations applied to the same page are applied together; tables
+ * already sorted, as emitted by most compilers, are not written to;
+ * @param table : the relocation table to sort;
+ */
+static void sort_relocation_table(
+	struct elf_table *table
+)
+{
+	
+	/*Entries are swapped per 8 bytes word; other sizes stay unsorted;*/
+	if ((table->t_bsize & 7) || (__relocations_sorted(table)))
+		return;
+	
+	/*Rel and rela entries both start with their offset;*/
+	loader_sort(table->t_start,
+		((usize) table->t_end - (usize) table->t_start) / table->t_bsize,
+		(u32) table->t_bsize);
+	
+}
+
+/**
+ * __check_relocation : checks that the relocation @rel can be applied without
+ * further checks : its symbol index is not null and in the symbol table
+ * @sym_table, its symbol is defined, its type is supported and it writes in
+ * the @size bytes of the section to relocate;
+ * @return 0 if the relocation is valid, the related loading error if not;
+ */
+static u8 __check_relocation(
+	struct elf64_rela *rel,
+	struct elf_table *sym_table,
+	u64 size
+)
+{
+	
+	u32 sym_index;
+	u8 width;
+	
+	/*Fetch the symbol index and the relocation width;*/
+	sym_index = ELF64_R_SYM(rel->r_info);
+	width = loader_relocation_width(ELF64_R_TYPE(rel->r_info));
+	
+	if (!sym_index)
+		return LOADER_ERROR_REL_SYMBOL_NULL_INDEX;
+	
+	if (ptr_sum_byte_offset(sym_table->t_start,
+		(usize) sym_index * sym_table->t_bsize) >= sym_table->t_end)
+		return LOADER_ERROR_BAD_TABLE_INDEX;
+	
+	if (!width)
+		return LOADER_ERROR_REL_BAD_TYPE;
+	
+	if ((rel->r_offset > size) || (rel->r_offset + width > size))
+		return LOADER_ERROR_REL_BAD_OFFSET;
+	
+	if (!((struct elf64_sym *) ptr_sum_byte_offset(sym_table->t_start,
+		(usize) sym_index * sym_table->t_bsize))->sy_value)
+		return LOADER_ERROR_REL_SYMBOL_NULL_ADDRESS;
+	
+	return 0;
+	
+}
+
+/**
+ * check_relocation_table : validates all relocations of @reltable in a
+ * single pass, so that they can be applied without per-entry checks; widths
+ * are read from the processor's table, so that the pass does not branch on
+ * entries, and only accumulates an invalid flag; reading the symbol's value
+ * is a load indexed by the entry, so the pass is not expected to vectorize;
+ * if the flag is set, entries are checked one by one to locate the first
+ * invalid one and throw the related error;
+ * @param env : the loading environment;
+ * @param reltable : the relocation table;
+ * @param sym_table : the symbol table relocations refer to;
+ * @param size : the size of the section to relocate;
+ */
+static void check_relocation_table(
+	struct loading_env *env,
+	struct elf_table *reltable,
+	struct elf_table *sym_table,
+	u64 size
+)
+{
+	
+	struct elf64_rela *rel;
+	struct elf64_sym *sym;
+	u32 nb_syms;
+	u32 sym_index;
+	u32 rel_type;
+	u64 offset;
+	u8 width;
+	u8 invalid;
+	u8 error;
+	
+	/*Determine the number of symbols;*/
+	nb_syms = (u32) (((u8 *) sym_table->t_end - (u8 *) sym_table->t_start) /
+		sym_table->t_bsize);
+	
+	invalid = 0;
+	
+	/*Accumulate checks over the whole table;*/
+	TABLE_ITERATE((*reltable), rel) {
+		
+		sym_index = ELF64_R_SYM(rel->r_info);
+		rel_type = ELF64_R_TYPE(rel->r_info);
+		offset = rel->r_offset;
+		
+		/*Unsupported types are 0 bytes wide;*/
+		width = loader_relocation_width(rel_type);
+		
+		/*Out of range indexes read the null symbol, whose value is null;*/
+		sym = ptr_sum_byte_offset(sym_table->t_start,
+			(usize) ((sym_index < nb_syms) ? sym_index : 0) * sym_table->t_bsize);
+		
+		invalid |= (u8) (!sym_index | !width |
+			(rel_type >= LOADER_RELOCATION_TYPES) | (offset > size) |
+			(offset + width > size) | !sym->sy_value);
+		
+	}
+	
+	/*If all relocations are valid, complete;*/
+	if (!invalid)
+		return;
+	
+	/*Locate and throw the first error;*/
+	TABLE_ITERATE((*reltable), rel) {
+		
+		env->r_error.e_entry++;
+		
+		error = __check_relocation(rel, sym_table, size);
+		
+		if (error)
+			loading_error(env, error);
+		
+	}
+	
+}
+
+/**
+ * apply_reloaction_table : validates the whole relocation table (symbols
+ * valid and defined, types supported, writes in the section), then for each
+ * relocation calls the processor-defined function @loader_apply_relocation,
+ * to actually apply the relocation; it still dispatches on the type and
+ * checks the value for an overflow, the only error left. If a relocation
+ * fails to be applied, the function stops throws the related error;
+ * @param env : the relocation environment;
+ * @param rel_table_id : the relocation table's section index;
+ */
+static void apply_reloaction_table(
+	struct loading_env *env,
+	u16 rel_table_id
+)
+{
+	
+	struct loader_sections *sections;
+	u8 explicit_addend;
+	struct elf_table reltable;
+	u16 symtbl_id;
+	
+	u16 rel_sect_id;
+	u64 rel_sect_start;
+	
+	struct elf_table sym_table;
+	struct elf64_rela *rel;
+	
+	struct loader_stats *stats;
+	u64 start;
+	
+	/*Cache the section cache and stats;*/
+	sections = &env->r_sections;
+	stats = env->r_stats;
+	
+	debug("applying relocations in %s", section_name(env, rel_table_id));
+	
+	/*Save the table start;*/
+	start = loader_timestamp();
+	
+	/*Locate eventual errors;*/
+	__error_locate(env, LOADER_PHASE_RELOCATIONS, rel_table_id);
+	
+	/*Determine whether an explicit addend is provided;*/
+	explicit_addend = (u8) (sections->s_type[rel_table_id] == SHT_RELA);
+	
+	/*Fetch the relocation table;*/
+	__section_to_table(env, rel_table_id, &reltable, 0);
+	
+	/*If required, sort relocations by offset;*/
+	if (env->r_flags & LOADER_FLAG_SORT_RELOCATIONS) {
+		sort_relocation_table(&reltable);
+	}
+	
+	/*Fetch and check the symbol table identifier;*/
+	symtbl_id = __get_section(env, sections->s_link[rel_table_id], SHT_SYMTAB);
+	
+	/*Fetch table data;*/
+	__section_to_table(env, symtbl_id, &sym_table, 0);
+	
+	/*Fetch and check the index of the section to relocate;*/
+	rel_sect_id = __get_section(
+		env, sections->s_info[rel_table_id], SHT_PROGBITS
+	);
+	
+	/*Fetch the start of the section whose content will be changed;*/
+	rel_sect_start = sections->s_addr[rel_sect_id];
+	
+	/*Validate all relocations, only value overflows remain to check;*/
+	check_relocation_table(
+		env, &reltable, &sym_table, sections->s_size[rel_sect_id]
+	);
+	
+	/*Iterate over the relocation table;*/
+	TABLE_ITERATE(reltable, rel) {
+		u64 rel_addr;
+		u64 rel_info;
+		u64 sym_addr;
+		u32 sym_index;
+		u32 rel_type;
+		struct elf64_sym *sym;
+		s64 addend;
+		u8 rel_error;
+		
+		/*Locate eventual errors;*/
+		env->r_error.e_entry++;
+		
+		/*Determine the relocation's address;*/
+		rel_addr = (u64) ptr_sum_byte_offset(rel_sect_start, rel->r_offset);
+		
+		/*Fetch relocation information, get index and type;*/
+		rel_info = rel->r_info;
+		sym_index = ELF64_R_SYM(rel_info);
+		rel_type = ELF64_R_TYPE(rel_info);
+		
+		/*Fetch the symbol reference;*/
+		sym = ptr_sum_byte_offset(sym_table.t_start,
+			(usize) sym_index * sym_table.t_bsize);
+		
+		/*Initialise the addend, and the target of merged entries;*/
+		addend = (explicit_addend) ? rel->r_addend : 0;
+		sym_addr = __merge_target(env, sym, &addend);
+		
+		LOADER_TRACE(LOADER_TRACE_ENTRIES, env, LOADER_EVENT_RELOCATION,
+			LOADER_PHASE_RELOCATIONS, rel_table_id, sym_index, rel_type,
+			rel_addr);
+		
+		/*Apply the relocation;*/
+		rel_error = loader_apply_relocation(
+			rel_addr, sym_addr, addend, rel_type
+		);
+		
+		/*If required, count the relocation by type;*/
+		if (stats) {
+			stats->st_rel_types[(rel_type < LOADER_STATS_REL_TYPES) ?
+				rel_type : LOADER_STATS_REL_TYPES - 1]++;
+		}
+		
+		/*If the relocation failed, throw an error;*/
+		if (rel_error) {
+			
+			/*If required, count overflows, fire the overflow probe;*/
+			if (rel_error == LOADER_ERROR_REL_VALUE_OVERFLOW) {
+				
+				if (stats) {
+					stats->st_overflows++;
+				}
+				
+				LOADER_PROBE4(overflow, env, rel_table_id,
+					env->r_error.e_entry, rel_type);
+				
+			}
+			
+			loading_error(env, rel_error);
+			
+		}
+		
+	}
+	
+	/*If required, update stats;*/
+	if (stats) {
+		stats->st_time[LOADER_PHASE_RELOCATIONS] += loader_timestamp() - start;
+		stats->st_relocations += env->r_error.e_entry;
+	}
+	
+}
+
+/**
+ * announce_functions : notifies env->r_hook of each function of the symbol
+ * tables of the file, at its assigned address;
+ * @param env : the loading environment;
+ */
+static void announce_functions(
+	struct loading_env *env
+)
+{
+	
+	struct loader_sections *sections;
+	struct loader_code_hook *hook;
+	struct elf_table symtable;
+	struct elf_table str_table;
+	struct elf64_sym *sym;
+	u16 index;
+	
+	/*Cache the section cache and the hook;*/
+	sections = &env->r_sections;
+	hook = env->r_hook;
+	
+	SECTIONS_ITERATE(sections, index) {
+		
+		if (sections->s_type[index] != SHT_SYMTAB)
+			continue;
+		
+		/*Fetch the symbol table and its string table;*/
+		__section_to_table(env, index, &symtable, 0);
+		__section_to_table(env, __get_section(
+			env, sections->s_link[index], SHT_STRTAB), &str_table, 1);
+		
+		TABLE_ITERATE(symtable, sym) {
+			if (__is_function(env, sym)) {
+				(*hook->h_load)(hook->h_handle,
+					__get_table_entry(env, &str_table, sym->sy_name),
+					sym->sy_value, sym->sy_size);
+			}
+		}
+		
+	}
+	
+}
+
+/**
+ * loader_apply_relocations : for each relocation in the environment, verifies
+ * the relocation can be applied (symbol valid and defined), then calls the
+ * processor-defined function @loader_apply_relocation, to actually apply the
+ * relocation.
+ * If a relocation fails to be applied, the function stops; if all were
+ * applied, env->r_hook is notified of loaded functions;
+ * @param env : the relocation environment;
+ * @param reltbl_hdr : the relocation table header;
+ * @return an loading error code;
+ */
+u8 loader_apply_relocations(struct loading_env *env)
+{
+	
+	struct loader_sections *sections;
+	u32 relocations;
+	u16 index;
+	u8 error_id;
+	
+	/*Fetch the section cache;*/
+	sections = &env->r_sections;
+	relocations = 0;
+	
+	debug_("loader applying relocations");
+	
+	LOADER_TRACE(LOADER_TRACE_PHASES, env, LOADER_EVENT_PHASE_START,
+		LOADER_PHASE_RELOCATIONS, 0, 0, 0, 0);
+	
+	LOADER_PROBE2(phase_start, env, LOADER_PHASE_RELOCATIONS);
+	
+	try(ctx, error_id) {
+			
+			/*Update the internal error context;*/
+			/*Reset at exception exit, to avoid scope escapism;*/
+			env->r_error_ctx = &ctx;
+			
+			/*Iterate over sections :*/
+			SECTIONS_ITERATE(sections, index) {
+				
+				u32 sh_type;
+				
+				/*Fetch the section type;*/
+				sh_type = sections->s_type[index];
+				
+				/*If the section contains a relocation table in RAM :*/
+				if (((sh_type == SHT_REL) || (sh_type == SHT_RELA)) &&
+					(sections->s_addr[index])) {
+					
+					/*Attempt to apply relocations;*/
+					apply_reloaction_table(env, index);
+					
+					/*If probes are compiled in, count relocations;*/
+					if (LOADER_PROBES) {
+						relocations += env->r_error.e_entry;
+					}
+					
+				}
+				
+			}
+			
+			/*If required, notify the hook of relocated functions;*/
+			if (env->r_hook) {
+				announce_functions(env);
+			}
+			
+		}
+	
+	try_end
+	
+	debug_("loader done applying relocations");
+	
+	LOADER_TRACE(LOADER_TRACE_PHASES, env, LOADER_EVENT_PHASE_END,
+		LOADER_PHASE_RELOCATIONS, 0, 0, error_id, 0);
+	
+	LOADER_PROBE4(phase_end, env, LOADER_PHASE_RELOCATIONS, error_id,
+		relocations);
+	
+	/*Reset the internal error context to avoid scope escapism;*/
+	env->r_error_ctx = 0;
+	
+	/*Return the error id;*/
+	return env->r_error.e_code = error_id;
+	
+}
+
+/*----------------------------------------------------------- single pass load*/
+
+/**
+ * __assign_symbol_table_once : assigns symbols of the symbol table at
+ * @sym_table_id, if it was not already; relocatable files hold at most one
+ * symbol table; if a second one is met, a loading error is thrown;
+ * @param env : the loading environment;
+ * @param sym_table_id : the index of the symbol table to assign;
+ * @param assigned : the index of the assigned symbol table, null if none;
+ * @param defs : a list of defined symbols;
+ * @param queries : a set of symbols the file may define;
+ * @return the index of the assigned symbol table;
+ */
+static u16 __assign_symbol_table_once(
+	struct loading_env *env,
+	u32 sym_table_id,
+	u16 assigned,
+	struct loader_symbol *defs,
+	struct loader_symbol *queries
+)
+{
+	
+	/*If the table is already assigned, nothing to do;*/
+	if (sym_table_id == assigned)
+		return assigned;
+	
+	/*If another table was assigned, fail;*/
+	if (assigned) {
+		__error_locate(env, LOADER_PHASE_SYMBOLS, (u16) sym_table_id);
+		loading_error(env, LOADER_ERROR_MULTIPLE_SYMBOL_TABLES);
+	}
+	
+	/*Check and assign the symbol table;*/
+	assigned = __get_section(env, sym_table_id, SHT_SYMTAB);
+	assing_symbol_table(env, assigned, defs, queries);
+	
+	/*Complete;*/
+	return assigned;
+	
+}
+
+/**
+ * loader_load : loads the file in a single pass : assigns sections, then
+ * classifies sections once, assigning the symbol table when the first
+ * relocation table requiring it is met, and applying each relocation table
+ * as it is met; this is equivalent to calling loader_assign_sections,
+ * loader_assign_symbols and loader_apply_relocations in order;
+ * @param env : the loading environment;
+ * @param defs : a list of defined symbols, see loader_assign_symbols;
+ * @param queries : a set of symbols the file may define, see
+ * loader_assign_symbols;
+ * @return 0 if the file was loaded, a loading error code if not; the error is
+ * located by env->r_error;
+ */
+u8 loader_load(
+	struct loading_env *env,
+	struct loader_symbol *defs,
+	struct loader_symbol *queries
+)
+{
+	
+	struct loader_sections *sections;
+	u32 relocations;
+	u16 index;
+	u16 symtab;
+	u16 assigned;
+	u8 error_id;
+	
+	LOADER_PROBE2(load_start, env, env->r_sections.s_count);
+	
+	/*Sections are collected from queries;*/
+	env->r_roots = queries;
+	
+	/*Assign sections; if an error occurs, fail;*/
+	error_id = loader_assign_sections(env);
+	if (error_id) {
+		LOADER_PROBE2(load_end, env, error_id);
+		return error_id;
+	}
+	
+	/*Fetch the section cache;*/
+	sections = &env->r_sections;
+	
+	/*No symbol table is met or assigned yet;*/
+	symtab = assigned = 0;
+	relocations = 0;
+	
+	debug_("loader loading");
+	
+	LOADER_TRACE(LOADER_TRACE_PHASES, env, LOADER_EVENT_PHASE_START,
+		LOADER_PHASE_RELOCATIONS, 0, 0, 0, 0);
+	
+	LOADER_PROBE2(phase_start, env, LOADER_PHASE_RELOCATIONS);
+	
+	try(ctx, error_id) {
+			
+			/*Update the internal error context;*/
+			/*Reset at exception exit, to avoid scope escapism;*/
+			env->r_error_ctx = &ctx;
+			
+			/*Iterate over sections :*/
+			SECTIONS_ITERATE(sections, index) {
+				
+				u32 sh_type;
+				
+				/*Fetch the section type;*/
+				sh_type = sections->s_type[index];
+				
+				/*If the section holds the symbol table, save it;*/
+				if (sh_type == SHT_SYMTAB) {
+					
+					/*If another symbol table was met, fail;*/
+					if (symtab) {
+						__error_locate(env, LOADER_PHASE_SYMBOLS, index);
+						loading_error(env, LOADER_ERROR_MULTIPLE_SYMBOL_TABLES);
+					}
+					
+					symtab = index;
+					
+				}
+				
+				/*If the section contains a relocation table in RAM :*/
+				if (((sh_type == SHT_REL) || (sh_type == SHT_RELA)) &&
+					(sections->s_addr[index])) {
+					
+					/*Assign the symbol table it uses first;*/
+					assigned = __assign_symbol_table_once(
+						env, sections->s_link[index], assigned, defs, queries
+					);
+					
+					/*Assigning symbols may have folded the section to
+					 * relocate, and dropped the table;*/
+					if (!sections->s_addr[index])
+						continue;
+					
+					/*Apply relocations;*/
+					apply_reloaction_table(env, index);
+					
+					/*If probes are compiled in, count relocations;*/
+					if (LOADER_PROBES) {
+						relocations += env->r_error.e_entry;
+					}
+					
+				}
+				
+			}
+			
+			/*If the symbol table is used by no relocation, assign it;*/
+			if (symtab) {
+				__assign_symbol_table_once(env, symtab, assigned, defs, queries);
+			}
+			
+			/*If required, notify the hook of relocated functions;*/
+			if (env->r_hook) {
+				announce_functions(env);
+			}
+			
+		}
+	
+	try_end
+	
+	debug_("loader done loading");
+	
+	LOADER_TRACE(LOADER_TRACE_PHASES, env, LOADER_EVENT_PHASE_END,
+		LOADER_PHASE_RELOCATIONS, 0, 0, error_id, 0);
+	
+	LOADER_PROBE4(phase_end, env, LOADER_PHASE_RELOCATIONS, error_id,
+		relocations);
+	
+	LOADER_PROBE2(load_end, env, error_id);
+	
+	/*Reset the internal error context to avoid scope escapism;*/
+	env->r_error_ctx = 0;
+	
+	/*Return the error id;*/
+	return env->r_error.e_code = error_id;
+	
+}
+
+
+/*-------------------------------------------------------------- prepared loads*/
+
+/**
+ * loader_prepare : loads the file with loader_load, then prepares its
+ * publication : @view is filled with the modules of env->r_registry
+ * followed by env->r_module, in which the file's exports are indexed; none
+ * of it is visible to lookups of the registry, so that this can run on a
+ * worker, and the file is published by loader_commit; loads that share a
+ * group table, a merge pool or a fold table must still be serialized;
+ * @param env : the loading environment, whose module, registry and reader
+ * are set;
+ * @param defs : a list of defined symbols, see loader_assign_symbols;
+ * @param queries : a set of symbols the file may define, see
+ * loader_assign_symbols;
+ * @param view : the view to fill, neither published nor used by lookups;
+ * @return 0 if the file was prepared, LOADER_ERROR_NOT_PUBLISHABLE,
+ * LOADER_ERROR_ALLOCATION if @view is too small, LOADER_ERROR_CODE_OVERLAP
+ * if a section of the file's code intersects a published module's code, or
+ * a loading error code if not; the error is located by env->r_error;
+ */
+u8 loader_prepare(
+	struct loading_env *env,
+	struct loader_symbol *defs,
+	struct loader_symbol *queries,
+	struct loader_registry_view *view
+)
+{
+	
+	u8 error_id;
+	
+	/*If the file can't be published, fail;*/
+	if ((!env->r_module) || (!env->r_registry) || (!env->r_reader))
+		return env->r_error.e_code = LOADER_ERROR_NOT_PUBLISHABLE;
+	
+	/*Load the file and index its exports; if an error occurs, fail;*/
+	error_id = loader_load(env, defs, queries);
+	
+	if (error_id)
+		return error_id;
+	
+	/*Fill the view; if it is too small, or if code overlaps, fail;*/
+	switch (loader_registry_prepare(env->r_registry, env->r_reader, view,
+		env->r_module, &env->r_epoch)) {
+		case LOADER_REGISTRY_FULL :
+			return env->r_error.e_code = LOADER_ERROR_ALLOCATION;
+		case LOADER_REGISTRY_OVERLAP :
+			return env->r_error.e_code = LOADER_ERROR_CODE_OVERLAP;
+		default :
+			return 0;
+	}
+	
+}
+
+/**
+ * loader_commit : publishes the file prepared by loader_prepare, by
+ * publishing @view in env->r_registry, in constant time if the previous
+ * publication was retired; if another view was published since the
+ * preparation, @view is filled again first; the returned view can be reused
+ * once loader_registry_retire completes, so that two views are enough to
+ * prepare files one after the other;
+ * @param env : the loading environment, prepared by loader_prepare;
+ * @param reader : the reader slot of the calling thread, that fills @view
+ * again; env->r_reader belongs to the thread that ran loader_prepare;
+ * @param view : the view filled by loader_prepare;
+ * @return the previous view, or null if @view became too small, or if the
+ * code of a module published meanwhile intersects the file's code, in which
+ * case nothing is published;
+ */
+struct loader_registry_view *loader_commit(
+	struct loading_env *env,
+	struct loader_registry_reader *reader,
+	struct loader_registry_view *view
+)
+{
+	
+	struct loader_registry_view *previous;
+	
+	/*Until the view is published, fill it again from the current view;*/
+	while (!(previous =
+		loader_registry_commit(env->r_registry, view, env->r_epoch))) {
+		
+		if (loader_registry_prepare(env->r_registry, reader, view,
+			env->r_module, &env->r_epoch))
+			return 0;
+		
+	}
+	
+	return previous;
+	
+}
+
+
+/*---------------------------------------------------------------- page sharing*/
+
+/**
+ * __section_offset : returns the offset in a mapped file of the section at
+ * @index;
+ */
+#define __section_offset(env, index) \
+	((env)->r_sections.s_addr[index] - (u64) (env)->r_hdr)
+
+/**
+ * __mark_pages : sets the bits of @bitmap related to pages intersecting the
+ * file range [@start, @start + @size[; pages past the end of the file are
+ * ignored;
+ * @param bitmap : the page bitmap to update;
+ * @param nb_pages : the number of pages of the file;
+ * @param page_shift : the base 2 logarithm of the page size;
+ * @param start : the offset in the file of the range's first byte;
+ * @param size : the size in bytes of the range;
+ */
+static void __mark_pages(
+	u8 *bitmap,
+	usize nb_pages,
+	u8 page_shift,
+	u64 start,
+	u64 size
+)
+{
+	
+	u64 page;
+	u64 last;
+	
+	/*An empty range, or an empty file, writes no page;*/
+	if ((!size) || (!nb_pages))
+		return;
+	
+	/*Determine the first and last pages of the range;*/
+	page = start >> page_shift;
+	last = (start + size - 1) >> page_shift;
+	
+	/*Ignore pages past the end of the file;*/
+	if (last >= nb_pages) {
+		last = nb_pages - 1;
+	}
+	
+	/*Mark all pages;*/
+	for (; page <= last; page++) {
+		bitmap[page >> 3] |= (u8) (1 << (page & 7));
+	}
+	
+}
+
+/**
+ * __mark_relocation_pages : marks pages holding the site of a relocation of
+ * the relocation table described by @rel_table_hdr;
+ * @param env : the loading environment;
+ * @param rel_table_id : the relocation table's section index;
+ * @param bitmap : the page bitmap to update;
+ * @param nb_pages : the number of pages of the file;
+ * @param page_shift : the base 2 logarithm of the page size;
+ */
+static void __mark_relocation_pages(
+	struct loading_env *env,
+	u16 rel_table_id,
+	u8 *bitmap,
+	usize nb_pages,
+	u8 page_shift
+)
+{
+	
+	struct elf_table reltable;
+	struct elf64_rela *rel;
+	u16 rel_sect_id;
+	u64 rel_sect_offset;
+	u8 width;
+	
+	/*Fetch the relocation table;*/
+	__section_to_table(env, rel_table_id, &reltable, 0);
+	
+	/*Fetch and check the index of the section to relocate;*/
+	rel_sect_id = __get_section(
+		env, env->r_sections.s_info[rel_table_id], SHT_PROGBITS
+	);
+	
+	/*Cache the offset of the section to relocate;*/
+	rel_sect_offset = __section_offset(env, rel_sect_id);
+	
+	/*Iterate over the relocation table;*/
+	TABLE_ITERATE(reltable, rel) {
+		
+		/*Determine the relocation's width;*/
+		width = loader_relocation_width(ELF64_R_TYPE(rel->r_info));
 		
+		/*Unsupported relocations are reported later; assume 8 bytes;*/
+		if (!width) {
+			width = 8;
+		}
 		
-		/*Get the section header; the section should contain program data*/
-		shdr = __get_section_header(env, section_id, 0);
+		/*Mark pages holding the relocation site;*/
+		__mark_pages(bitmap, nb_pages, page_shift,
+			rel_sect_offset + rel->r_offset, width);
 		
-		if (shdr->sh_type == SHT_PROGBITS) {
+	}
+	
+}
+
+/**
+ * loader_dirty_pages : for a file mapped in RAM, determines which pages of the
+ * file the load writes to : pages holding symbol tables, writable sections or
+ * the site of a relocation; other pages can be mapped directly from the file
+ * and shared between all instances, written ones must be private;
+ * must be called after loader_init and after options are set, before any
+ * other loading step;
+ * @param env : the loading environment;
+ * @param file_size : the size in bytes of the mapped file;
+ * @param page_shift : the base 2 logarithm of the page size;
+ * @param bitmap : a bitmap with one bit per page of the file, set by this
+ * function if the page is written to, cleared if not;
+ * @param report : updated with the number of shared and private bytes;
+ * @return 0 if the bitmap was computed, LOADER_ERROR_NOT_MAPPED if the file is
+ * streamed, or a loading error code if the file is ill-formed;
+ */
+u8 loader_dirty_pages(
+	struct loading_env *env,
+	usize file_size,
+	u8 page_shift,
+	u8 *bitmap,
+	struct loader_page_report *report
+)
+{
+	
+	struct loader_sections *sections;
+	u16 index;
+	usize page_size;
+	usize nb_pages;
+	usize page;
+	u8 error_id;
+	
+	/*Streamed sections are not backed by the file;*/
+	if (env->r_stream)
+		return LOADER_ERROR_NOT_MAPPED;
+	
+	/*Determine the number of pages of the file;*/
+	page_size = (usize) 1 << page_shift;
+	nb_pages = (file_size + page_size - 1) >> page_shift;
+	
+	/*Clear the bitmap;*/
+	for (page = 0; page < (nb_pages + 7) >> 3; page++) {
+		bitmap[page] = 0;
+	}
+	
+	/*Fetch the section cache;*/
+	sections = &env->r_sections;
+	
+	try(ctx, error_id) {
 			
-			debug("assigning to section : %s", section_name(env, shdr));
+			/*Update the internal error context;*/
+			/*Reset at exception exit, to avoid scope escapism;*/
+			env->r_error_ctx = &ctx;
 			
-			/*If the offset is valid determine the symbol's address;*/
-			value = sym->sy_value + shdr->sh_addr;
+			/*Iterate over sections :*/
+			SECTIONS_ITERATE(sections, index) {
+				
+				u32 sh_type;
+				
+				/*Fetch the section type;*/
+				sh_type = sections->s_type[index];
+				
+				/*Symbol values are written in symbol tables, and
+				 * writable sections are written by the loaded code,
+				 * unless they occupy no space in the file;*/
+				if ((sh_type == SHT_SYMTAB) ||
+					((sections->s_flags[index] & SHF_WRITE) &&
+						(sh_type != SHT_NOBITS))) {
+					__mark_pages(bitmap, nb_pages, page_shift,
+						__section_offset(env, index), sections->s_size[index]);
+				}
+				
+				/*If the section holds a relocation table :*/
+				if ((sh_type == SHT_REL) || (sh_type == SHT_RELA)) {
+					
+					struct elf_table reltable;
+					
+					/*Relocations are written at their site;*/
+					__mark_relocation_pages(env, index, bitmap, nb_pages,
+						page_shift);
+					
+					/*If relocations are not sorted, skip;*/
+					if (!(env->r_flags & LOADER_FLAG_SORT_RELOCATIONS))
+						continue;
+					
+					/*Unsorted tables are written by the sorting pass;*/
+					__section_to_table(env, index, &reltable, 0);
+					if (!__relocations_sorted(&reltable)) {
+						__mark_pages(bitmap, nb_pages, page_shift,
+							__section_offset(env, index), sections->s_size[index]);
+					}
+					
+				}
+				
+			}
 			
+		}
+	
+	try_end
+	
+	/*Reset the internal error context to avoid scope escapism;*/
+	env->r_error_ctx = 0;
+	
+	/*If the file is ill-formed, fail;*/
+	if (error_id) {
+		return error_id;
+	}
+	
+	/*Count shared and private bytes;*/
+	report->p_shared = report->p_private = 0;
+	for (page = 0; page < nb_pages; page++) {
+		
+		if (bitmap[page >> 3] & (1 << (page & 7))) {
+			report->p_private += page_size;
 		} else {
-			
-			debug("section %s holds no prog_bits : %d", section_name(env, shdr), shdr->sh_type);
-			
+			report->p_shared += page_size;
 		}
 		
 	}
 	
-	/*Save the symbol's value;*/
-	sym->sy_value = value;
+	/*Complete;*/
+	return 0;
 	
 }
 
+
+/*--------------------------------------------------------------------- images*/
+
+/*Relocations applied to the image offline;*/
+#define IMAGE_BAKED ((u8) 0)
+
+/*Relocations saved as relr words;*/
+#define IMAGE_RELR ((u8) 1)
+
+/*Relocations saved as fixups;*/
+#define IMAGE_FIXUP ((u8) 2)
+
 /**
- * assing_symbol_table : for each symbol in the symbol table :
- * - if the symbol is defined updates the symbol's address internally and
- *   updated the list of symbol queries if required;
- * - if the symbol is not defined, search the list of external definitons
- *   for an eventual matching symbol;
- * It it possible that undefined symbols remain after the execution of this
- * function. Those will have their value assigned to 0;
- * @param env : the loading environment
- * @param symtbl_hdr : symbol table's section header;
- * @param definitions : a list of defined symbols, that are accessible to the
- * executable; if undefined symbols with matching names are found in the
- * executable, their value will be set to the value provided in the list;
- * @param queries : a set of symbols the executable may define; if defined
- * symbols with matching names are found in the executable, the list will be
- * updated with the value of the symbol in the executable;
+ * __image_align : rounds @size up to a multiple of 8;
+ */
+#define __image_align(size) (((u64) (size) + 7) & ~(u64) 7)
+
+/**
+ * __image_in_range : determines whether @addr is in the image range
+ * [@base, @base + @size];
+ */
+#define __image_in_range(addr, base, size) \
+	(((addr) >= (base)) && ((addr) - (base) <= (size)))
+
+/**
+ * __image_kind : determines how a relocation is saved in an image, by
+ * applying it at two locations 8 bytes apart; if the symbol is relative, it
+ * is moved by the same distance;
+ * @param rel_addr : the address of the relocation;
+ * @param sym_addr : the address of the symbol;
+ * @param addend : the relocation addend;
+ * @param rel_type : the relocation type;
+ * @param relative : set if the symbol moves with the image;
+ * @return IMAGE_BAKED if the value does not depend on the location,
+ * IMAGE_RELR if it is an aligned 64 bits word that moves with the location,
+ * IMAGE_FIXUP if not;
+ */
+static u8 __image_kind(
+	u64 rel_addr,
+	u64 sym_addr,
+	s64 addend,
+	u32 rel_type,
+	u8 relative
+)
+{
+	
+	union {
+		u64 s_words[2];
+		u8 s_bytes[16];
+	} scratch;
+	u64 first;
+	u64 second;
+	
+	scratch.s_words[0] = scratch.s_words[1] = 0;
+	
+	/*Determine the location of each copy, and the symbol they use;*/
+	first = (u64) scratch.s_bytes;
+	second = first + 8;
+	
+	/*If any copy can't be applied, the relocation must be applied at load;*/
+	if ((loader_apply_relocation(first,
+			(relative) ? sym_addr - rel_addr + first : sym_addr, addend,
+			rel_type)) ||
+		(loader_apply_relocation(second,
+			(relative) ? sym_addr - rel_addr + second : sym_addr, addend,
+			rel_type)))
+		return IMAGE_FIXUP;
+	
+	/*If copies are identical, the relocation is position independent;*/
+	if (scratch.s_words[0] == scratch.s_words[1])
+		return IMAGE_BAKED;
+	
+	/*If aligned 64 bits copies differ by their distance, they are relr;*/
+	if ((relative) && (loader_relocation_width(rel_type) == 8) &&
+		(!(rel_addr & 7)) && (scratch.s_words[1] - scratch.s_words[0] == 8))
+		return IMAGE_RELR;
+	
+	return IMAGE_FIXUP;
+	
+}
+
+/**
+ * __image_relocations : classifies relocations of the file that target
+ * loaded sections; when counting, relocations that do not depend on the
+ * image's address are applied, relr words are written relative to the
+ * image, fixups and relr words are counted, and imports are assigned an
+ * index in @imports; when emitting, fixups and relr offsets are written;
+ * @param env : the loading environment;
+ * @param base : the start of the image range;
+ * @param size : the size of the image range;
+ * @param symtab : the index of the symbol table;
+ * @param imports : the import index of each symbol, LOADER_IMAGE_SELF if
+ * the symbol is not imported;
+ * @param hdr : the image header, whose counters are updated;
+ * @param fixups : the fixups to write, null when counting;
+ * @param relr : the relr offsets to write, null when counting;
+ */
+static void __image_relocations(
+	struct loading_env *env,
+	u64 base,
+	u64 size,
+	u16 symtab,
+	u32 *imports,
+	struct loader_image_hdr *hdr,
+	struct loader_image_fixup *fixups,
+	u64 *relr
+)
+{
+	
+	struct loader_sections *sections;
+	struct elf_table reltable;
+	struct elf_table symtable;
+	struct elf_table str_table;
+	struct elf64_rela *rel;
+	struct elf64_sym *sym;
+	struct loader_image_fixup *fixup;
+	u64 rel_addr;
+	u64 sym_addr;
+	s64 addend;
+	s64 value;
+	u32 sym_index;
+	u32 rel_type;
+	u32 symbol;
+	u16 index;
+	u16 target;
+	u8 explicit_addend;
+	u8 relative;
+	u8 kind;
+	u8 error;
+	
+	/*Cache the section cache;*/
+	sections = &env->r_sections;
+	
+	/*Fetch the symbol table and its string table;*/
+	__section_to_table(env, symtab, &symtable, 0);
+	__section_to_table(env, __get_section(
+		env, sections->s_link[symtab], SHT_STRTAB), &str_table, 1);
+	
+	SECTIONS_ITERATE(sections, index) {
+		
+		/*Only relocation tables targeting loaded sections are used;*/
+		if (((sections->s_type[index] != SHT_REL) &&
+			(sections->s_type[index] != SHT_RELA)) ||
+			(!sections->s_addr[index]))
+			continue;
+		
+		/*Locate eventual errors;*/
+		__error_locate(env, LOADER_PHASE_RELOCATIONS, index);
+		
+		/*All relocations must use the symbol table;*/
+		if (sections->s_link[index] != symtab)
+			loading_error(env, LOADER_ERROR_BAD_IMAGE);
+		
+		/*Determine whether an explicit addend is provided;*/
+		explicit_addend = (u8) (sections->s_type[index] == SHT_RELA);
+		
+		/*Fetch the relocation table and its target;*/
+		__section_to_table(env, index, &reltable, 0);
+		target = __get_section(env, sections->s_info[index], SHT_PROGBITS);
+		
+		TABLE_ITERATE(reltable, rel) {
+			
+			/*Locate eventual errors;*/
+			env->r_error.e_entry++;
+			
+			/*Check the relocation; imports have no value yet;*/
+			sym_index = ELF64_R_SYM(rel->r_info);
+			rel_type = ELF64_R_TYPE(rel->r_info);
+			error = __check_relocation(rel, &symtable, sections->s_size[target]);
+			sym = ptr_sum_byte_offset(symtable.t_start,
+				(usize) sym_index * symtable.t_bsize);
+			
+			if ((error) && ((error != LOADER_ERROR_REL_SYMBOL_NULL_ADDRESS) ||
+				(sym->sy_shndx != SHN_UNDEF)))
+				loading_error(env, error);
+			
+			/*Determine the relocation's address and addend;*/
+			rel_addr = sections->s_addr[target] + rel->r_offset;
+			addend = (explicit_addend) ? rel->r_addend : 0;
+			sym_addr = __merge_target(env, sym, &addend);
+			
+			/*Imports are fixups, assigned an index on first use;*/
+			if (sym->sy_shndx == SHN_UNDEF) {
+				
+				if ((!fixups) && (imports[sym_index] == LOADER_IMAGE_SELF)) {
+					imports[sym_index] = hdr->i_nb_imports++;
+					hdr->i_strings_size += __name_size(__get_table_entry(
+						env, &str_table, sym->sy_name));
+				}
+				
+				kind = IMAGE_FIXUP;
+				symbol = imports[sym_index];
+				value = addend;
+				
+			} else {
+				
+				/*Definitions move with the image, unless absolute;*/
+				relative = (u8) (sym->sy_shndx != SHN_ABS);
+				
+				if ((relative) && (!__image_in_range(sym_addr, base, size)))
+					loading_error(env, LOADER_ERROR_BAD_IMAGE);
+				
+				kind = __image_kind(
+					rel_addr, sym_addr, addend, rel_type, relative
+				);
+				
+				/*Absolute symbols can't be fixed up relative to the image;*/
+				if ((kind == IMAGE_FIXUP) && (!relative))
+					loading_error(env, LOADER_ERROR_BAD_IMAGE);
+				
+				symbol = LOADER_IMAGE_SELF;
+				value = (s64) (sym_addr - base) + addend;
+				
+			}
+			
+			/*Relr words hold their offset in the image;*/
+			if (kind == IMAGE_RELR) {
+				
+				if (relr) {
+					relr[hdr->i_nb_relr] = rel_addr - base;
+				} else {
+					loader_apply_relocation(
+						rel_addr, sym_addr, addend, rel_type
+					);
+					*(u64 *) rel_addr -= base;
+				}
+				
+				hdr->i_nb_relr++;
+				
+			} else if (kind == IMAGE_FIXUP) {
+				
+				/*Addends are saved on 32 bits;*/
+				if (value != (s64) (s32) value)
+					loading_error(env, LOADER_ERROR_REL_VALUE_OVERFLOW);
+				
+				if (fixups) {
+					fixup = fixups + hdr->i_nb_fixups;
+					fixup->f_offset = (u32) (rel_addr - base);
+					fixup->f_symbol = symbol;
+					fixup->f_type = rel_type;
+					fixup->f_addend = (s32) value;
+				}
+				
+				hdr->i_nb_fixups++;
+				
+			} else if (!fixups) {
+				
+				/*Position independent relocations are applied once;*/
+				loader_apply_relocation(
+					rel_addr, sym_addr, addend, rel_type
+				);
+				
+			}
+			
+		}
+		
+	}
+	
+}
+
+/**
+ * __image_exported : determines whether @sym is a global definition of the
+ * image range;
  */
-static void assing_symbol_table(
+#define __image_exported(sym, base, size) \
+	((__is_export(sym)) && ((sym)->sy_shndx != SHN_ABS) && \
+		(__image_in_range((sym)->sy_value, base, size)))
+
+/**
+ * __image_build : see loader_image_build;
+ */
+static void __image_build(
 	struct loading_env *env,
-	struct elf64_shdr *sym_table_header,
-	struct loader_symbol *definitions,
-	struct loader_symbol *queries
+	u64 base,
+	u64 size,
+	struct loader_image_hdr **image,
+	usize *image_size
 )
 {
 	
+	struct loader_sections *sections;
+	struct loader_allocator *alloc;
+	struct loader_image_hdr counts;
+	struct loader_image_hdr *hdr;
+	struct loader_image_fixup *fixups;
+	struct loader_image_export *exports;
 	struct elf_table symtable;
-	
-	u16 str_table_index;
-	struct elf64_shdr *str_table_hdr;
 	struct elf_table str_table;
 	struct elf64_sym *sym;
+	const char *name;
+	u32 *imports;
+	u32 *names;
+	char *strings;
+	u64 *relr;
+	u64 *word;
+	u64 file_size;
+	u64 total;
+	u64 offset;
+	u32 nb_syms;
+	u32 sym_index;
+	u32 string;
+	u16 symtab;
+	u16 index;
 	
-	debug("assigning symbols in %s", section_name(env, sym_table_header));
-	
-	/*Fetch the symbol table;*/
-	__section_header_to_table(env, sym_table_header, &symtable, 0);
+	/*Cache the section cache and the allocator;*/
+	sections = &env->r_sections;
+	alloc = env->r_scratch;
 	
-	/*Fetch the string table id;*/
-	str_table_index = (u16) sym_table_header->sh_link;
+	/*Locate eventual errors;*/
+	__error_locate(env, LOADER_PHASE_SECTIONS, 0);
 	
-	/*Get the string table section header;*/
-	str_table_hdr = __get_section_header(env, str_table_index, SHT_STRTAB);
+	/*Only streamed files, whose sections are in the range, are converted;*/
+	if ((!env->r_stream) || (base & 7))
+		loading_error(env, LOADER_ERROR_BAD_IMAGE);
 	
-	/*Fetch table data;*/
-	__section_header_to_table(env, str_table_hdr, &str_table, 1);
+	/*Determine the image's flags, find the symbol table;*/
+	counts.i_flags = SHF_ALLOC;
+	symtab = 0;
 	
-	/*Iterate over the symbol table;*/
-	TABLE_ITERATE(symtable, sym) {
-		
-		const char *s_name;
-		struct loader_symbol *ext_sym;
-		
-		/*Fetch the name start;*/
-		s_name = __get_table_entry(env, &str_table, sym->sy_name);
+	SECTIONS_ITERATE(sections, index) {
 		
-		/*
-		 * Internal symbol definition;
-		 */
+		if (sections->s_type[index] == SHT_SYMTAB) {
+			symtab = index;
+		}
 		
-		debug("symbol %s", s_name);
+		if ((!(sections->s_flags[index] & SHF_ALLOC)) ||
+			(!sections->s_addr[index]))
+			continue;
 		
-		/*If the symbol is undefined :*/
-		if (sym->sy_shndx == SHN_UNDEF) {
-			
-			debug("undefined, searching for external def", s_name);
-			
-			/*If a definition exists, update the value;
-			 * if not, set the symbol's value to 0;*/
-			sym->sy_value = (u64) sym_def_find(definitions, s_name);
-			
-		} else {
-			
-			/*If the symbol is defined, update its value;*/
-			update_symbol_address(env, sym);
-			
+		if ((!__image_in_range(sections->s_addr[index], base, size)) ||
+			(sections->s_addr[index] - base + sections->s_size[index] > size)) {
+			__error_locate(env, LOADER_PHASE_SECTIONS, index);
+			loading_error(env, LOADER_ERROR_BAD_IMAGE);
 		}
 		
-		debug("assigned at %h", sym->sy_value);
+		counts.i_flags |= sections->s_flags[index] &
+			(SHF_WRITE | SHF_EXECINSTR);
 		
-		/*If the symbol's value is null, stop here;*/
-		if (!sym->sy_value) {
-			
+	}
+	
+	/*An image requires a symbol table;*/
+	if (!symtab)
+		loading_error(env, LOADER_ERROR_BAD_IMAGE);
+	
+	__section_to_table(env, symtab, &symtable, 0);
+	__section_to_table(env, __get_section(
+		env, sections->s_link[symtab], SHT_STRTAB), &str_table, 1);
+	
+	/*Allocate the import index of each symbol;*/
+	nb_syms = (u32) (((u64) symtable.t_end - (u64) symtable.t_start) /
+		symtable.t_bsize);
+	imports = (*alloc->a_alloc)(
+		alloc->a_handle, (usize) nb_syms * sizeof(u32) + 1, sizeof(u32), 0
+	);
+	
+	if (!imports)
+		loading_error(env, LOADER_ERROR_ALLOCATION);
+	
+	for (sym_index = 0; sym_index < nb_syms; sym_index++) {
+		imports[sym_index] = LOADER_IMAGE_SELF;
+	}
+	
+	/*Count fixups, relr words and imports, apply other relocations;*/
+	counts.i_nb_fixups = counts.i_nb_imports = counts.i_nb_relr = 0;
+	counts.i_nb_exports = counts.i_strings_size = 0;
+	__image_relocations(env, base, size, symtab, imports, &counts, 0, 0);
+	
+	/*Count exports;*/
+	__error_locate(env, LOADER_PHASE_SYMBOLS, symtab);
+	
+	TABLE_ITERATE(symtable, sym) {
+		
+		if (!__image_exported(sym, base, size))
 			continue;
-		}
 		
-		/*
-		 * External symbols definition;
-		 */
+		counts.i_nb_exports++;
+		counts.i_strings_size += __name_size(
+			__get_table_entry(env, &str_table, sym->sy_name)
+		);
 		
-		/*Initialise the current symbol;*/
-		ext_sym = queries;
+	}
+	
+	/*Only store bytes of the image up to the last non-null one;*/
+	for (file_size = size; (file_size) &&
+		(!*(const u8 *) (base + file_size - 1)); file_size--);
+	
+	/*Determine the size of the image, with all relr offsets;*/
+	total = sizeof(struct loader_image_hdr) + __image_align(file_size) +
+		counts.i_nb_fixups * sizeof(struct loader_image_fixup) +
+		__image_align(counts.i_nb_imports * sizeof(u32)) +
+		counts.i_nb_exports * sizeof(struct loader_image_export) +
+		__image_align(counts.i_strings_size) + counts.i_nb_relr * sizeof(u64);
+	
+	/*Offsets are saved on 32 bits;*/
+	if (size >> 32)
+		loading_error(env, LOADER_ERROR_BAD_IMAGE);
+	
+	/*Allocate and clear the image;*/
+	hdr = (*alloc->a_alloc)(alloc->a_handle, (usize) total, 8, 0);
+	
+	if (!hdr)
+		loading_error(env, LOADER_ERROR_ALLOCATION);
+	
+	for (word = (u64 *) hdr; (u64) word < (u64) hdr + total; word++) {
+		*word = 0;
+	}
+	
+	/*Locate parts;*/
+	fixups = ptr_sum_byte_offset(hdr + 1, __image_align(file_size));
+	names = (u32 *) (fixups + counts.i_nb_fixups);
+	exports = ptr_sum_byte_offset(
+		names, __image_align(counts.i_nb_imports * sizeof(u32))
+	);
+	strings = (char *) (exports + counts.i_nb_exports);
+	relr = ptr_sum_byte_offset(strings, __image_align(counts.i_strings_size));
+	
+	/*Fill the header, counters are incremented while parts are written;*/
+	hdr->i_magic = LOADER_IMAGE_MAGIC;
+	hdr->i_version = LOADER_IMAGE_VERSION;
+	hdr->i_size = __image_align(size);
+	hdr->i_file_size = file_size;
+	hdr->i_flags = counts.i_flags;
+	hdr->i_nb_imports = counts.i_nb_imports;
+	hdr->i_strings_size = counts.i_strings_size;
+	
+	/*The image's alignment is the alignment of its range, up to a page;*/
+	hdr->i_align = (u32) ((base & (~base + 1)) & 0xfff);
+	if (!hdr->i_align) {
+		hdr->i_align = 0x1000;
+	}
+	
+	/*Copy the image;*/
+	for (offset = 0; offset < file_size; offset++) {
+		((u8 *) (hdr + 1))[offset] = *(const u8 *) (base + offset);
+	}
+	
+	/*Write fixups and relr offsets;*/
+	__image_relocations(env, base, size, symtab, imports, hdr, fixups, relr);
+	
+	/*Write import and export names;*/
+	string = 0;
+	
+	TABLE_ITERATE(symtable, sym) {
 		
-		/*For each external symbol:*/
-		while (ext_sym) {
-			
-			/*If the symbol is already defined, skip;*/
-			/*If symbols names do not match, skip;*/
-			if ((ext_sym->s_defined) ||
-				(str_cmp(s_name, ext_sym->s_name) != 0)) {
-				ext_sym = ext_sym->s_next;
-				continue;
-				
-			}
-			
-			/*Define the external symbol;*/
-			ext_sym->s_defined = 1;
-			ext_sym->s_addr = (void *) sym->sy_value;
-			
-			/*Stop here;*/
-			break;
-			
+		sym_index = (u32) (((u64) sym - (u64) symtable.t_start) /
+			symtable.t_bsize);
+		name = __get_table_entry(env, &str_table, sym->sy_name);
+		
+		if (imports[sym_index] != LOADER_IMAGE_SELF) {
+			names[imports[sym_index]] = string;
+		} else if (__image_exported(sym, base, size)) {
+			exports[hdr->i_nb_exports].e_name = string;
+			exports[hdr->i_nb_exports++].e_offset = (u32) (sym->sy_value - base);
+		} else {
+			continue;
 		}
 		
+		while ((strings[string++] = *(name++)));
+		
 	}
 	
+	/*Encode relr offsets in place;*/
+	loader_sort(relr, hdr->i_nb_relr, sizeof(u64));
+	hdr->i_nb_relr = loader_relr_encode(relr, hdr->i_nb_relr, relr);
+	
+	*image = hdr;
+	*image_size = (usize) ((u64) (relr + hdr->i_nb_relr) - (u64) hdr);
+	
 }
 
 /**
- * loader_assign_symbols : for each symbol in the environment :
- * - if the symbol is defined updates the symbol's address internally and
- *   updated the list of symbol queries if required;
- * - if the symbol is not defined, search the list of external definitions
- *   for an eventual matching symbol;
- * It it possible that undefined symbols remain after the execution of this
- * function. Those will have their value assigned to 0;
- * @param env : the loading environment
- * @param definitions : a list of defined symbols, that are accessible to the
- * executable; if undefined symbols with matching names are found in the
- * executable, their value will be set to the value provided in the list;
- * @param queries : a set of symbols the executable may define; if defined
- * symbols with matching names are found in the executable, the list will be
- * updated with the value of the symbol in the executable;
- * @return 0 if all symbols had their value assigned, or, if a symbol table's
- * string table index was invalid (only source of error), the index of the
- * symbol table's section header; this error should stop the loading;
+ * loader_image_build : converts a streamed file, whose sections and symbols
+ * are assigned, into an image; relocations that do not depend on the
+ * image's address are applied to the file's sections, others are saved in
+ * the image; undefined symbols become imports and global definitions
+ * become exports; the image is allocated by the scratch allocator;
+ * must be called after loader_assign_symbols, instead of
+ * loader_apply_relocations;
+ * @param env : the loading environment;
+ * @param base : the start of the range sections of the file are allocated
+ * in; other allocations of the load must not be in the range;
+ * @param size : the size of the range;
+ * @param image : updated with the image;
+ * @param image_size : updated with the size of the image;
+ * @return 0 if the image was built, a loading error code if not; the error
+ * is located by env->r_error;
  */
-u8 loader_assign_symbols(
+u8 loader_image_build(
 	struct loading_env *env,
-	struct loader_symbol *defs,
-	struct loader_symbol *undefs
+	u64 base,
+	u64 size,
+	struct loader_image_hdr **image,
+	usize *image_size
 )
 {
 	
-	struct elf_table shtable;
-	struct elf64_shdr *sheader;
 	u8 error_id;
 	
-	debug_("loader assigning symbols");
+	debug_("loader building image");
 	
 	try(ctx, error_id) {
 			
@@ -531,224 +5064,198 @@ u8 loader_assign_symbols(
 			/*Reset at exception exit, to avoid scope escapism;*/
 			env->r_error_ctx = &ctx;
 			
-			/*Fetch section header table descriptor;*/
-			shtable = env->r_shtable;
-			
-			/*Iterate over the section table :*/
-			TABLE_ITERATE(shtable, sheader) {
-				
-				/*If the section holds a symbol table :*/
-				if (sheader->sh_type == SHT_SYMTAB) {
-					
-					/*Assign symbols in the symbol table;*/
-					assing_symbol_table(env, sheader, defs, undefs);
-					
-				}
-				
-			}
+			__image_build(env, base, size, image, image_size);
 			
 		}
 	
-	
 	try_end
 	
-	debug_("loader done assigning symbols");
+	debug_("loader done building image");
 	
 	/*Reset the internal error context to avoid scope escapism;*/
 	env->r_error_ctx = 0;
 	
 	/*Return the error id;*/
-	return error_id;
+	return env->r_error.e_code = error_id;
 	
 }
 
-/*--------------------------------------------------------------- relocations */
-
-/**
- * loader_apply_relocation : apply the relocation @rel_type to @rel_addr,
- * regarding symbol at @sym_addr and @addend; If the relocation fails to be
- * applied, the function stops throws the related error;
- * This function is processor-defined;
- * @param rel_addr : the address to apply the relocation to;
- * @param sym_addr : the address of the symbol the relocation concerns;
- * @param addend : the relocation addend, null if none;
- * @param rel_type : the relocation type;
- * @return 0 if the relocation was applied correctly, LOADER_ERROR_REL_BAD_TYPE
- * if bad relocation type, LOADER_ERROR_REL_VALUE_OVERFLOW if relocation value
- * overflow.
- */
-u8 loader_apply_relocation(
-	u64 rel_addr,
-	u64 sym_addr,
-	s64 addend,
-	u32 rel_type
-);
-
 /**
- * apply_reloaction_table : for each relocation in the relocation table,
- * verifies the relocation can be applied (symbol valid and defined), then
- * calls the processor-defined function @loader_apply_relocation, to actually
- * apply the relocation. If a relocation fails to be applied, the function
- * stops throws the related error;
- * @param env : the relocation environment;
- * @param rel_table_hdr : the relocation table header;
+ * loader_image_load : loads an image built by loader_image_build : the
+ * image is copied in memory provided by @alloc, relr words and fixups are
+ * applied, and exports are matched with @queries;
+ * @param image : the image, aligned on 8 bytes;
+ * @param image_size : the size of the image;
+ * @param alloc : the allocator providing memory to the image;
+ * @param defs : a list of defined symbols, imports are resolved in;
+ * @param queries : a set of symbols the image may export; if exported, they
+ * are defined with the address of the export;
+ * @param base : updated with the address of the loaded image;
+ * @return 0 if the image was loaded, LOADER_ERROR_BAD_IMAGE,
+ * LOADER_ERROR_ALLOCATION, LOADER_ERROR_REL_SYMBOL_NULL_ADDRESS,
+ * LOADER_ERROR_REL_BAD_TYPE or LOADER_ERROR_REL_VALUE_OVERFLOW if not;
  */
-static void apply_reloaction_table(
-	struct loading_env *env,
-	struct elf64_shdr *rel_table_hdr
+u8 loader_image_load(
+	const struct loader_image_hdr *image,
+	usize image_size,
+	struct loader_allocator *alloc,
+	struct loader_symbol *defs,
+	struct loader_symbol *queries,
+	void **base
 )
 {
 	
-	u8 explicit_addend;
-	struct elf_table reltable;
-	u16 symtbl_id;
-	
-	u16 rel_sect_id;
-	struct elf64_shdr *rel_sect_hdr;
-	u64 rel_sect_start;
+	const struct loader_image_fixup *fixup;
+	const struct loader_image_export *exports;
+	const u32 *names;
+	const char *strings;
+	const u64 *relr;
+	const u64 *src;
+	u64 *targets;
+	u64 *word;
+	u64 *end;
+	u64 total;
+	u64 symbol;
+	u8 *dst;
+	u32 entry;
+	u32 compares;
+	u8 width;
+	u8 error;
 	
-	struct elf64_shdr *sym_table_hdr;
-	struct elf_table sym_table;
-	struct elf64_rela *rel;
+	/*Check the header;*/
+	if ((image_size < sizeof(struct loader_image_hdr)) ||
+		(image->i_magic != LOADER_IMAGE_MAGIC) ||
+		(image->i_version != LOADER_IMAGE_VERSION) ||
+		(image->i_file_size > image_size) ||
+		(image->i_size & 7) || (image->i_file_size > image->i_size))
+		return LOADER_ERROR_BAD_IMAGE;
 	
-	debug("applying relocations in %s", section_name(env, rel_table_hdr));
+	/*Check the size of the image;*/
+	total = sizeof(struct loader_image_hdr) +
+		__image_align(image->i_file_size) +
+		(u64) image->i_nb_fixups * sizeof(struct loader_image_fixup) +
+		__image_align((u64) image->i_nb_imports * sizeof(u32)) +
+		(u64) image->i_nb_exports * sizeof(struct loader_image_export) +
+		__image_align(image->i_strings_size) +
+		(u64) image->i_nb_relr * sizeof(u64);
 	
-	/*Determine whether an explicit addend is provided;*/
-	explicit_addend = (u8) (rel_table_hdr->sh_type == SHT_RELA);
+	if (total > image_size)
+		return LOADER_ERROR_BAD_IMAGE;
 	
-	/*Fetch the relocation table;*/
-	__section_header_to_table(env, rel_table_hdr, &reltable, 0);
+	/*Locate parts;*/
+	fixup = ptr_sum_byte_offset(image + 1, __image_align(image->i_file_size));
+	names = (const u32 *) (fixup + image->i_nb_fixups);
+	exports = ptr_sum_byte_offset(
+		names, __image_align((u64) image->i_nb_imports * sizeof(u32))
+	);
+	strings = (const char *) (exports + image->i_nb_exports);
+	relr = ptr_sum_byte_offset(strings, __image_align(image->i_strings_size));
 	
-	/*Fetch the symbol table header identifier;*/
-	symtbl_id = (u16) rel_table_hdr->sh_link;
+	/*Names must be terminated, relr words must be in the image;*/
+	if (((image->i_strings_size) && (strings[image->i_strings_size - 1])) ||
+		((!image->i_strings_size) &&
+			((image->i_nb_imports) || (image->i_nb_exports))) ||
+		(!loader_relr_check(relr, image->i_nb_relr, image->i_size)))
+		return LOADER_ERROR_BAD_IMAGE;
 	
-	/*Fetch the symbol table;*/
-	sym_table_hdr = __get_section_header(env, symtbl_id, SHT_SYMTAB);
+	/*Allocate the image;*/
+	dst = (*alloc->a_alloc)(
+		alloc->a_handle, (usize) (image->i_size ? image->i_size : 8),
+		image->i_align, image->i_flags
+	);
 	
-	debug("using symbols from table %s", section_name(env, sym_table_hdr));
+	if (!dst)
+		return LOADER_ERROR_ALLOCATION;
 	
-	/*Fetch table data;*/
-	__section_header_to_table(env, sym_table_hdr, &sym_table, 0);
+	/*Resolve each import once;*/
+	targets = 0;
+	compares = 0;
 	
-	/*Fetch the index of the section to relocate;*/
-	rel_sect_id = (u16) rel_table_hdr->sh_info;
+	if (image->i_nb_imports) {
+		
+		targets = (*alloc->a_alloc)(alloc->a_handle,
+			(usize) image->i_nb_imports * sizeof(u64), sizeof(u64), 0);
+		
+		if (!targets)
+			return LOADER_ERROR_ALLOCATION;
+		
+		for (entry = 0; entry < image->i_nb_imports; entry++) {
+			
+			if (names[entry] >= image->i_strings_size)
+				return LOADER_ERROR_BAD_IMAGE;
+			
+			targets[entry] =
+				(u64) sym_def_find(defs, strings + names[entry], &compares);
+			
+		}
+		
+	}
 	
-	/*Fetch the header of the section to relocate;*/
-	rel_sect_hdr = __get_section_header(env, rel_sect_id, SHT_PROGBITS);
+	/*Copy the image, clear the rest;*/
+	src = (const u64 *) (image + 1);
+	end = (u64 *) (dst + __image_align(image->i_file_size));
+	for (word = (u64 *) dst; word < end; word++) {
+		*word = *(src++);
+	}
 	
-	debug("updating content of section %s", section_name(env, rel_sect_hdr));
+	end = (u64 *) (dst + image->i_size);
+	for (; word < end; word++) {
+		*word = 0;
+	}
 	
-	/*Fetch the start and size of the section whose content will be changed;*/
-	rel_sect_start = rel_sect_hdr->sh_addr;
+	/*Add the image's address to relr words;*/
+	loader_relr_apply(dst, relr, image->i_nb_relr);
 	
-	/*Iterate over the relocation table;*/
-	TABLE_ITERATE(reltable, rel) {
-		u64 rel_addr;
-		u64 rel_info;
-		u32 sym_index;
-		u32 rel_type;
-		struct elf64_sym *sym;
-		u64 sym_addr;
-		s64 addend;
-		u8 rel_error;
-		
-		/*Determine the relocation's address;*/
-		rel_addr = (u64) ptr_sum_byte_offset(rel_sect_start, rel->r_offset);
-		
-		/*Fetch relocation information, get index and type;*/
-		rel_info = rel->r_info;
-		sym_index = ELF64_R_SYM(rel_info);
-		rel_type = ELF64_R_TYPE(rel_info);
-		
-		/*If the symbol's index is null :*/
-		if (!sym_index)
-			loading_error(env, LOADER_ERROR_REL_SYMBOL_NULL_INDEX);
+	/*Apply fixups;*/
+	for (entry = image->i_nb_fixups; entry--; fixup++) {
 		
-		/*Fetch the symbol reference;*/
-		sym = __get_table_entry(env, &sym_table, sym_index);
+		width = loader_relocation_width(fixup->f_type);
 		
-		/*Fetch the symbol's value;*/
-		sym_addr = sym->sy_value;
+		if (!width)
+			return LOADER_ERROR_REL_BAD_TYPE;
 		
-		/*If the symbol's address is null :*/
-		if (!sym_addr)
-			loading_error(env, LOADER_ERROR_REL_SYMBOL_NULL_ADDRESS);
+		if (((u64) fixup->f_offset + width > image->i_size) ||
+			((fixup->f_symbol != LOADER_IMAGE_SELF) &&
+				(fixup->f_symbol >= image->i_nb_imports)))
+			return LOADER_ERROR_BAD_IMAGE;
 		
-		/*Initialise the addend;*/
-		addend = (explicit_addend) ? rel->r_addend : 0;
+		symbol = (fixup->f_symbol == LOADER_IMAGE_SELF) ?
+			(u64) dst : targets[fixup->f_symbol];
 		
-		debug("applying relocation of type %d at %h with addend %h using "
-				  "symbol %s of value %h ",rel_type, rel_addr, addend,
-			  symbol_name(env, sym_table_hdr, sym), sym_addr);
+		if (!symbol)
+			return LOADER_ERROR_REL_SYMBOL_NULL_ADDRESS;
 		
-		/*Apply the relocation;*/
-		rel_error = loader_apply_relocation(
-			rel_addr, sym_addr, addend, rel_type
-		);
+		error = loader_apply_relocation((u64) (dst + fixup->f_offset), symbol,
+			fixup->f_addend, fixup->f_type);
 		
-		/*If the relocation failed, throw an error;*/
-		if (rel_error) {
-			loading_error(env, rel_error);
-		}
+		if (error)
+			return error;
 		
 	}
 	
-}
-
-/**
- * loader_apply_relocations : for each relocation in the environment, verifies
- * the relocation can be applied (symbol valid and defined), then calls the
- * processor-defined function @loader_apply_relocation, to actually apply the
- * relocation.
- * If a relocation fails to be applied, the function stops;
- * @param env : the relocation environment;
- * @param reltbl_hdr : the relocation table header;
- * @return an loading error code;
- */
-u8 loader_apply_relocations(struct loading_env *env)
-{
-	
-	struct elf_table shtable;
-	struct elf64_shdr *shdr;
-	u8 error_id;
-	
-	/*Fetch the symbol table descriptor;*/
-	shtable = env->r_shtable;
-	
-	debug_("loader applying relocations");
-	
-	try(ctx, error_id) {
+	/*Define queries the image exports;*/
+	for (; queries; queries = queries->s_next) {
+		
+		if (queries->s_defined)
+			continue;
+		
+		for (entry = 0; entry < image->i_nb_exports; entry++) {
 			
-			/*Update the internal error context;*/
-			/*Reset at exception exit, to avoid scope escapism;*/
-			env->r_error_ctx = &ctx;
+			if ((exports[entry].e_name >= image->i_strings_size) ||
+				(exports[entry].e_offset > image->i_size))
+				return LOADER_ERROR_BAD_IMAGE;
 			
-			/*Iterate over the section table :*/
-			TABLE_ITERATE(shtable, shdr) {
-				
-				u32 sh_type;
-				
-				/*Fetch the section type;*/
-				sh_type = shdr->sh_type;
-				
-				/*If the section contains a relocation table :*/
-				if ((sh_type == SHT_REL) || (sh_type == SHT_RELA)) {
-					
-					/*Attempt to apply relocations;*/
-					apply_reloaction_table(env, shdr);
-					
-				}
-				
+			if (str_cmp(strings + exports[entry].e_name, queries->s_name) == 0) {
+				queries->s_defined = 1;
+				queries->s_addr = dst + exports[entry].e_offset;
+				break;
 			}
 			
 		}
+		
+	}
 	
-	try_end
-	
-	debug_("loader done applying relocations");
-	
-	/*Reset the internal error context to avoid scope escapism;*/
-	env->r_error_ctx = 0;
+	*base = dst;
 	
 	/*Complete;*/
 	return 0;
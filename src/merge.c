@@ -0,0 +1,226 @@
+/*merge.c - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#include <merge.h>
+
+/**
+ * merge_match : determines whether the entry @slot has the content of the
+ * entry @key;
+ */
+static u8 merge_match(
+	const void *slot,
+	const void *key
+)
+{
+	
+	const struct loader_merge_entry *entry;
+	const struct loader_merge_entry *data;
+	u64 byte;
+	
+	entry = slot;
+	data = key;
+	
+	if (entry->m_size != data->m_size)
+		return 0;
+	
+	for (byte = 0; (byte < data->m_size) &&
+		(entry->m_data[byte] == data->m_data[byte]);)
+		byte++;
+	
+	return (u8) (byte == data->m_size);
+	
+}
+
+/**
+ * merge_in_range : determines whether the entry @slot is in the range @key;
+ */
+static u8 merge_in_range(
+	const void *slot,
+	const void *key
+)
+{
+	
+	const u64 *range;
+	u64 data;
+	
+	range = key;
+	data = (u64) ((const struct loader_merge_entry *) slot)->m_data;
+	
+	return (u8) ((data >= range[0]) && (data < range[1]));
+	
+}
+
+/**
+ * loader_merge_pool_init : initializes @pool with the slot array @entries;
+ * @param pool : the pool to initialize;
+ * @param entries : the slot array;
+ * @param mask : the number of slots minus one; must be 2^n - 1;
+ */
+void loader_merge_pool_init(
+	struct loader_merge_pool *pool,
+	struct loader_merge_entry *entries,
+	u32 mask
+)
+{
+	
+	loader_hash_init(&pool->p_entries, entries,
+		sizeof(struct loader_merge_entry), mask);
+	
+}
+
+/**
+ * merge_slot : returns the slot of @pool holding the content of the @size
+ * bytes at @data, or the free slot it would be inserted in; @hash receives
+ * the content's hash;
+ */
+static struct loader_merge_entry *merge_slot(
+	struct loader_merge_pool *pool,
+	const u8 *data,
+	u64 size,
+	u32 *hash,
+	u32 *probes
+)
+{
+	
+	struct loader_merge_entry key;
+	
+	*hash = loader_hash_bytes(LOADER_HASH_BASIS, data, size);
+	key.m_data = data;
+	key.m_size = size;
+	
+	return loader_hash_find(&pool->p_entries, *hash, &merge_match, &key,
+		probes);
+	
+}
+
+/**
+ * loader_merge_find : searches @pool for an entry with the content of the
+ * @size bytes at @data; if none is found, and the pool is less than 3/4 full,
+ * @data is inserted;
+ * @param pool : the pool to search;
+ * @param data : the entry's content;
+ * @param size : the entry's size;
+ * @param probes : incremented with the number of slots probed;
+ * @return the address of the pooled entry with the same content, @data if
+ * there is none;
+ */
+const u8 *loader_merge_find(
+	struct loader_merge_pool *pool,
+	const u8 *data,
+	u64 size,
+	u32 *probes
+)
+{
+	
+	struct loader_merge_entry *entry;
+	u32 hash;
+	
+	entry = merge_slot(pool, data, size, &hash, probes);
+	
+	/*If an entry has the same content, use it;*/
+	if (entry->m_slot.s_used)
+		return entry->m_data;
+	
+	/*If the slot is free, the entry is new; insert it if possible;*/
+	if (loader_hash_claim(&pool->p_entries, entry, hash)) {
+		entry->m_data = data;
+		entry->m_size = size;
+	}
+	
+	return data;
+	
+}
+
+/**
+ * loader_merge_lookup : searches @pool for an entry with the content of the
+ * @size bytes at @data, without inserting it;
+ * @param pool : the pool to search;
+ * @param data : the entry's content;
+ * @param size : the entry's size;
+ * @param probes : incremented with the number of slots probed;
+ * @return the address of the pooled entry with the same content, null if
+ * there is none;
+ */
+const u8 *loader_merge_lookup(
+	struct loader_merge_pool *pool,
+	const u8 *data,
+	u64 size,
+	u32 *probes
+)
+{
+	
+	struct loader_merge_entry *entry;
+	u32 hash;
+	
+	entry = merge_slot(pool, data, size, &hash, probes);
+	
+	return (entry->m_slot.s_used) ? entry->m_data : 0;
+	
+}
+
+/**
+ * loader_merge_map_addr : returns the address @offset designates in the
+ * section mapped by @map : the address of the pooled copy of the entry
+ * containing @offset, plus the offset in the entry;
+ * @param map : the map of a merged section;
+ * @param offset : an offset in the section of the file;
+ * @return the address, 0 if @map has no pieces;
+ */
+u64 loader_merge_map_addr(
+	const struct loader_merge_map *map,
+	u64 offset
+)
+{
+	
+	const struct loader_merge_piece *piece;
+	u64 low;
+	u64 high;
+	u64 mid;
+	
+	if (!map->m_count)
+		return 0;
+	
+	/*Find the last piece starting at or before the offset;*/
+	low = 0;
+	high = map->m_count;
+	
+	while (high - low > 1) {
+		
+		mid = low + ((high - low) >> 1);
+		
+		if (map->m_pieces[mid].p_offset <= offset) {
+			low = mid;
+		} else {
+			high = mid;
+		}
+		
+	}
+	
+	piece = map->m_pieces + low;
+	
+	return piece->p_addr + (offset - piece->p_offset);
+	
+}
+
+/**
+ * loader_merge_pool_remove : removes from @pool the entries in
+ * [@start, @end[, so that the memory of their section can be freed;
+ * @param pool : the pool;
+ * @param start : the first byte of the memory to free;
+ * @param end : the byte following the memory to free;
+ * @return the number of entries removed;
+ */
+u32 loader_merge_pool_remove(
+	struct loader_merge_pool *pool,
+	u64 start,
+	u64 end
+)
+{
+	
+	u64 range[2];
+	
+	range[0] = start;
+	range[1] = end;
+	
+	return loader_hash_remove(&pool->p_entries, &merge_in_range, range);
+	
+}
@@ -0,0 +1,324 @@
+/*module.c - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#include <string.h>
+
+#include <module.h>
+
+/**
+ * The module key struct is the key of an export search;
+ */
+struct module_key {
+	
+	/*The module's name block;*/
+	const char *k_names;
+	
+	/*The name to search for;*/
+	const char *k_name;
+	
+};
+
+/**
+ * module_match : determines whether the export @slot has the name of the
+ * module key @key;
+ */
+static u8 module_match(
+	const void *slot,
+	const void *key
+)
+{
+	
+	const struct module_key *name;
+	
+	name = key;
+	
+	return (u8) !str_cmp(name->k_name,
+		name->k_names + ((const struct loader_export *) slot)->e_name);
+	
+}
+
+/**
+ * module_name : copies @name at the end of the name block of @module;
+ * @return the offset of the copy;
+ */
+static u32 module_name(
+	struct loader_module *module,
+	const char *name
+)
+{
+	
+	u32 offset;
+	char *dst;
+	
+	offset = module->m_length;
+	
+	dst = module->m_names + offset;
+	while ((*(dst++) = *(name++)));
+	
+	module->m_length = (u32) (dst - module->m_names);
+	
+	return offset;
+	
+}
+
+/**
+ * loader_module_init : initializes @module with the slot array @exports,
+ * the function array @functions, the range array @ranges and the name block
+ * @names; the module has no code;
+ * @param module : the module to initialize;
+ * @param exports : the slot array, with at least 4/3 slots per export;
+ * @param mask : the number of slots minus one; must be 2^n - 1;
+ * @param functions : the function array, large enough for all functions;
+ * @param ranges : the range array, large enough for all code ranges;
+ * @param names : the name block, large enough for all names, terminators
+ * included;
+ */
+void loader_module_init(
+	struct loader_module *module,
+	struct loader_export *exports,
+	u32 mask,
+	struct loader_function *functions,
+	struct loader_code_range *ranges,
+	char *names
+)
+{
+	
+	loader_hash_init(&module->m_exports, exports,
+		sizeof(struct loader_export), mask);
+	
+	module->m_functions = functions;
+	module->m_ranges = ranges;
+	module->m_names = names;
+	module->m_nb_functions = 0;
+	module->m_nb_ranges = 0;
+	module->m_length = 0;
+	
+}
+
+/**
+ * loader_module_export : exports @name at @addr from @module, copying the
+ * name in the name block; if @name is already exported, or if the slot array
+ * is 3/4 full, nothing is done;
+ * @param module : the module;
+ * @param name : the name of the definition;
+ * @param addr : the address of the definition, not null;
+ */
+void loader_module_export(
+	struct loader_module *module,
+	const char *name,
+	void *addr
+)
+{
+	
+	struct loader_export *export;
+	struct module_key key;
+	u32 probes;
+	u32 hash;
+	
+	hash = loader_hash_string(name);
+	key.k_names = module->m_names;
+	key.k_name = name;
+	probes = 0;
+	
+	export = loader_hash_find(&module->m_exports, hash, &module_match, &key,
+		&probes);
+	
+	/*If the name is already exported, keep the first definition;*/
+	if ((export->e_slot.s_used) ||
+		(!loader_hash_claim(&module->m_exports, export, hash)))
+		return;
+	
+	/*Copy the name and fill the slot;*/
+	export->e_addr = addr;
+	export->e_name = module_name(module, name);
+	
+}
+
+/**
+ * loader_module_function : adds the function @name at @addr to @module,
+ * copying the name in the name block; functions must be sorted before
+ * being searched;
+ * @param module : the module;
+ * @param name : the name of the function;
+ * @param addr : the address of the function;
+ * @param size : the size of the function, null if unknown;
+ */
+void loader_module_function(
+	struct loader_module *module,
+	const char *name,
+	u64 addr,
+	u64 size
+)
+{
+	
+	struct loader_function *function;
+	
+	function = module->m_functions + module->m_nb_functions++;
+	function->f_addr = addr;
+	function->f_size = size;
+	function->f_name = module_name(module, name);
+	
+}
+
+/**
+ * loader_module_code : adds the code range [@start, @end[ to @module; ranges
+ * must be sorted before being searched or registered;
+ * @param module : the module;
+ * @param start : the first byte of the range;
+ * @param end : the byte following the range;
+ */
+void loader_module_code(
+	struct loader_module *module,
+	u64 start,
+	u64 end
+)
+{
+	
+	struct loader_code_range *range;
+	
+	range = module->m_ranges + module->m_nb_ranges++;
+	range->c_start = start;
+	range->c_end = end;
+	range->c_module = module;
+	
+}
+
+/**
+ * loader_module_sort : sorts the functions and the code ranges of @module by
+ * address, and merges contiguous ranges;
+ * @param module : the module;
+ */
+void loader_module_sort(
+	struct loader_module *module
+)
+{
+	
+	struct loader_code_range *ranges;
+	u32 index;
+	u32 count;
+	
+	/*Functions and ranges start with their address;*/
+	loader_sort(module->m_functions, module->m_nb_functions,
+		sizeof(struct loader_function));
+	
+	ranges = module->m_ranges;
+	loader_sort(ranges, module->m_nb_ranges, sizeof(struct loader_code_range));
+	
+	/*Extend each range with the ranges that start before its end;*/
+	for (index = count = 0; index < module->m_nb_ranges; index++) {
+		
+		if ((count) && (ranges[index].c_start <= ranges[count - 1].c_end)) {
+			if (ranges[index].c_end > ranges[count - 1].c_end)
+				ranges[count - 1].c_end = ranges[index].c_end;
+			continue;
+		}
+		
+		ranges[count++] = ranges[index];
+		
+	}
+	
+	module->m_nb_ranges = count;
+	
+}
+
+/**
+ * loader_module_function_at : searches the sorted functions of @module for
+ * the function containing @addr, in O(log n); a function of unknown size
+ * extends to the next one; performs no write, and can be called from a
+ * signal handler;
+ * @param module : the module to search;
+ * @param addr : the address to search for;
+ * @return the function, null if no function contains @addr;
+ */
+const struct loader_function *loader_module_function_at(
+	const struct loader_module *module,
+	u64 addr
+)
+{
+	
+	const struct loader_function *function;
+	u32 low;
+	u32 high;
+	u32 middle;
+	
+	/*Find the number of functions starting at or before @addr;*/
+	low = 0;
+	high = module->m_nb_functions;
+	
+	while (low < high) {
+		
+		middle = low + (high - low) / 2;
+		
+		if (module->m_functions[middle].f_addr <= addr) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+		
+	}
+	
+	/*If none, or if the last one ends before @addr, fail;*/
+	if (!low)
+		return 0;
+	
+	function = module->m_functions + low - 1;
+	
+	if ((function->f_size) && (addr - function->f_addr >= function->f_size))
+		return 0;
+	
+	return function;
+	
+}
+
+/**
+ * loader_module_lookup : searches @module for the export @name;
+ * @param module : the module to search;
+ * @param name : the name of the definition;
+ * @return the address of the definition, null if it is not exported;
+ */
+void *loader_module_lookup(
+	const struct loader_module *module,
+	const char *name
+)
+{
+	
+	const struct loader_export *export;
+	struct module_key key;
+	u32 probes;
+	
+	key.k_names = module->m_names;
+	key.k_name = name;
+	probes = 0;
+	
+	export = loader_hash_find(&module->m_exports, loader_hash_string(name),
+		&module_match, &key, &probes);
+	
+	return (export->e_slot.s_used) ? export->e_addr : 0;
+	
+}
+
+/**
+ * loader_module_unload : notifies @hook that each function of @module is
+ * about to be unloaded; to be called by the caller before it frees the
+ * module's code;
+ * @param module : the module;
+ * @param hook : the hook to notify;
+ */
+void loader_module_unload(
+	const struct loader_module *module,
+	const struct loader_code_hook *hook
+)
+{
+	
+	const struct loader_function *function;
+	u32 index;
+	
+	for (index = 0; index < module->m_nb_functions; index++) {
+		
+		function = module->m_functions + index;
+		
+		(*hook->h_unload)(hook->h_handle, module->m_names + function->f_name,
+			function->f_addr, function->f_size);
+		
+	}
+	
+}
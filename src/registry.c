@@ -0,0 +1,554 @@
+/*registry.c - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#include <registry.h>
+
+/*Sequentially consistent accesses, provided by the compiler;*/
+#define atomic_load(ptr) __atomic_load_n((ptr), __ATOMIC_SEQ_CST)
+#define atomic_store(ptr, val) __atomic_store_n((ptr), (val), __ATOMIC_SEQ_CST)
+#define atomic_xchg(ptr, val) \
+	__atomic_exchange_n((ptr), (val), __ATOMIC_SEQ_CST)
+
+/**
+ * registry_lock : acquires the writers lock of @registry;
+ */
+static void registry_lock(
+	struct loader_registry *registry
+)
+{
+	
+	while (atomic_xchg(&registry->r_lock, 1)) {
+		
+		/*Spin on reads, without writing the lock's line;*/
+		while (atomic_load(&registry->r_lock));
+		
+	}
+	
+}
+
+/**
+ * registry_enter : records a lookup of @registry in @reader, with the
+ * current epoch; if a writer started another epoch meanwhile, it may not
+ * wait for the lookup, so the epoch is recorded again; if @reader is in use
+ * by the lookup the caller interrupted, its epoch is not later than the
+ * current one, so the slot is left as is;
+ * @return 1 if the slot was taken, and must be released by registry_leave,
+ * 0 if it was in use;
+ */
+static u8 registry_enter(
+	struct loader_registry *registry,
+	struct loader_registry_reader *reader
+)
+{
+	
+	u32 epoch;
+	
+	if (atomic_load(&reader->d_active))
+		return 0;
+	
+	epoch = atomic_load(&registry->r_epoch);
+	
+	for (;;) {
+		
+		atomic_store(&reader->d_epoch, epoch);
+		atomic_store(&reader->d_active, 1);
+		
+		if (atomic_load(&registry->r_epoch) == epoch)
+			return 1;
+		
+		epoch = atomic_load(&registry->r_epoch);
+		
+	}
+	
+}
+
+/**
+ * registry_leave : releases @reader if registry_enter took it;
+ */
+static __inline__ void registry_leave(
+	struct loader_registry_reader *reader,
+	u8 taken
+)
+{
+	
+	if (taken)
+		atomic_store(&reader->d_active, 0);
+	
+}
+
+/**
+ * registry_wait : scans reader slots of @registry until none records a
+ * lookup that started before @epoch;
+ */
+static void registry_wait(
+	struct loader_registry *registry,
+	u32 epoch
+)
+{
+	
+	struct loader_registry_reader *reader;
+	u32 index;
+	
+	for (index = 0; index < registry->r_nb_readers; index++) {
+		
+		reader = registry->r_readers + index;
+		
+		/*Epochs wrap, compare their difference;*/
+		while ((atomic_load(&reader->d_active)) &&
+			((s32) (atomic_load(&reader->d_epoch) - epoch) < 0));
+		
+	}
+	
+}
+
+/**
+ * registry_swap : publishes @view and starts a new epoch, without waiting
+ * for lookups of the previous one; if the previous view was committed and
+ * not retired yet, first waits for lookups that may use the view it
+ * replaced; the writers lock must be held;
+ * @return the previous view;
+ */
+static struct loader_registry_view *registry_swap(
+	struct loader_registry *registry,
+	struct loader_registry_view *view
+)
+{
+	
+	struct loader_registry_view *previous;
+	u32 epoch;
+	
+	previous = registry->r_view;
+	epoch = registry->r_epoch;
+	
+	/*Lookups of the epoch before may use any view but the published one;*/
+	registry_wait(registry, epoch);
+	
+	atomic_store(&registry->r_view, view);
+	
+	/*Start a new epoch; lookups of the previous one may use any view;*/
+	atomic_store(&registry->r_epoch, epoch + 1);
+	
+	return previous;
+	
+}
+
+/**
+ * registry_publish : publishes @view, then waits for lookups that may use
+ * the previous view; the writers lock must be held;
+ * @return the previous view;
+ */
+static struct loader_registry_view *registry_publish(
+	struct loader_registry *registry,
+	struct loader_registry_view *view
+)
+{
+	
+	struct loader_registry_view *previous;
+	
+	previous = registry_swap(registry, view);
+	
+	/*Wait for lookups of the previous epoch to complete;*/
+	registry_wait(registry, registry->r_epoch);
+	
+	return previous;
+	
+}
+
+/**
+ * registry_fill : fills @view with the modules of @current followed by
+ * @module, and merges the sorted code ranges of @current and @module; as
+ * ranges of each are disjoint, a range of @module can only intersect the
+ * range merged before it;
+ * @return 0 if @view was filled, LOADER_REGISTRY_FULL if it is too small, or
+ * LOADER_REGISTRY_OVERLAP if a code range of @module intersects a module's;
+ */
+static u8 registry_fill(
+	const struct loader_registry_view *current,
+	struct loader_registry_view *view,
+	struct loader_module *module
+)
+{
+	
+	const struct loader_code_range *range;
+	u32 index;
+	u32 added;
+	u32 count;
+	
+	/*If the view can't contain all modules and ranges, fail;*/
+	if ((view->v_size <= current->v_count) ||
+		(view->v_range_size < current->v_nb_ranges + module->m_nb_ranges))
+		return LOADER_REGISTRY_FULL;
+	
+	/*Merge ranges by address;*/
+	for (index = added = count = 0;
+		(index < current->v_nb_ranges) || (added < module->m_nb_ranges);
+		count++) {
+		
+		if ((added == module->m_nb_ranges) || ((index < current->v_nb_ranges) &&
+			(current->v_ranges[index]->c_start <
+				module->m_ranges[added].c_start))) {
+			range = current->v_ranges[index++];
+		} else {
+			range = module->m_ranges + added++;
+		}
+		
+		/*If the range starts before the end of the previous one, fail;*/
+		if ((count) && (range->c_start < view->v_ranges[count - 1]->c_end))
+			return LOADER_REGISTRY_OVERLAP;
+		
+		view->v_ranges[count] = range;
+		
+	}
+	
+	view->v_nb_ranges = count;
+	
+	/*Copy modules and append the new one;*/
+	for (index = 0; index < current->v_count; index++) {
+		view->v_modules[index] = current->v_modules[index];
+	}
+	
+	view->v_modules[index] = module;
+	view->v_count = index + 1;
+	
+	return 0;
+	
+}
+
+/**
+ * loader_registry_init : initializes @registry and publishes @view;
+ * @param registry : the registry to initialize;
+ * @param view : the initial view, its modules must be initialized and
+ * sorted, and its code ranges sorted and disjoint;
+ * @param readers : the reader slots, that lookups record themselves in;
+ * @param nb_readers : the number of reader slots;
+ */
+void loader_registry_init(
+	struct loader_registry *registry,
+	struct loader_registry_view *view,
+	struct loader_registry_reader *readers,
+	u32 nb_readers
+)
+{
+	
+	u32 index;
+	
+	registry->r_view = view;
+	registry->r_readers = readers;
+	registry->r_nb_readers = nb_readers;
+	registry->r_epoch = 0;
+	registry->r_lock = 0;
+	
+	for (index = 0; index < nb_readers; index++) {
+		readers[index].d_active = 0;
+	}
+	
+}
+
+/**
+ * loader_registry_add : publishes @view, filled with the modules of the
+ * current view followed by @module;
+ * @param registry : the registry;
+ * @param view : the view to fill and publish;
+ * @param module : the module to add, whose exports are indexed;
+ * @return the previous view, that lookups do not reference anymore, or null
+ * if @view is too small, or if a code range of @module intersects a
+ * module's, in which case nothing is published;
+ */
+struct loader_registry_view *loader_registry_add(
+	struct loader_registry *registry,
+	struct loader_registry_view *view,
+	struct loader_module *module
+)
+{
+	
+	struct loader_registry_view *current;
+	
+	registry_lock(registry);
+	
+	/*If the view can't contain all modules, or if code overlaps, fail;*/
+	if (registry_fill(registry->r_view, view, module)) {
+		atomic_store(&registry->r_lock, 0);
+		return 0;
+	}
+	
+	current = registry_publish(registry, view);
+	
+	atomic_store(&registry->r_lock, 0);
+	
+	return current;
+	
+}
+
+/**
+ * loader_registry_prepare : fills @view with the modules of the current view
+ * followed by @module, without publishing it; takes no lock and can run on
+ * a worker, concurrently with lookups and writers;
+ * @param registry : the registry;
+ * @param reader : the reader slot of the calling thread;
+ * @param view : the view to fill, neither published nor used by lookups;
+ * @param module : the module to add, whose exports are indexed;
+ * @param epoch : updated with the epoch of the view @view was filled from,
+ * to provide to loader_registry_commit;
+ * @return 0 if @view was filled, LOADER_REGISTRY_FULL if it is too small,
+ * or LOADER_REGISTRY_OVERLAP if a code range of @module intersects a
+ * module's;
+ */
+u8 loader_registry_prepare(
+	struct loader_registry *registry,
+	struct loader_registry_reader *reader,
+	struct loader_registry_view *view,
+	struct loader_module *module,
+	u32 *epoch
+)
+{
+	
+	u8 taken;
+	u8 error;
+	
+	/*Read the current view as a lookup, so that it is not reused; a view
+	 * published meanwhile has a later epoch, and fails the commit;*/
+	taken = registry_enter(registry, reader);
+	*epoch = atomic_load(&registry->r_epoch);
+	
+	error = registry_fill(atomic_load(&registry->r_view), view, module);
+	
+	registry_leave(reader, taken);
+	
+	return error;
+	
+}
+
+/**
+ * loader_registry_commit : publishes @view, prepared by
+ * loader_registry_prepare, if no view was published since; views are
+ * compared by epoch, not by address, as view buffers are reused; does not
+ * wait for lookups, and completes in constant time if the previous commit
+ * was retired;
+ * @param registry : the registry;
+ * @param view : the prepared view;
+ * @param epoch : the epoch of the view @view was prepared from;
+ * @return the previous view, that lookups may reference until
+ * loader_registry_retire completes, or null if another view was published
+ * since the preparation, in which case nothing is published;
+ */
+struct loader_registry_view *loader_registry_commit(
+	struct loader_registry *registry,
+	struct loader_registry_view *view,
+	u32 epoch
+)
+{
+	
+	struct loader_registry_view *previous;
+	
+	registry_lock(registry);
+	
+	/*If a view was published since the preparation, fail;*/
+	if (registry->r_epoch != epoch) {
+		atomic_store(&registry->r_lock, 0);
+		return 0;
+	}
+	
+	previous = registry_swap(registry, view);
+	
+	atomic_store(&registry->r_lock, 0);
+	
+	return previous;
+	
+}
+
+/**
+ * loader_registry_retire : waits for lookups that may reference the view
+ * replaced by the last publication; the view returned by
+ * loader_registry_commit can then be reused;
+ * @param registry : the registry;
+ */
+void loader_registry_retire(
+	struct loader_registry *registry
+)
+{
+	
+	u32 epoch;
+	
+	epoch = atomic_load(&registry->r_epoch);
+	
+	/*Wait for lookups of the previous epoch to complete;*/
+	registry_wait(registry, epoch);
+	
+}
+
+/**
+ * loader_registry_remove : publishes @view, filled with the modules of the
+ * current view except @module; group, merge and fold tables shared by loads
+ * are not updated : before the module's memory is freed, the caller removes
+ * its entries with loader_group_table_remove, loader_merge_pool_remove and
+ * loader_fold_table_remove;
+ * @param registry : the registry;
+ * @param view : the view to fill and publish;
+ * @param module : the module to remove;
+ * @return the previous view, that lookups do not reference anymore, or null
+ * if @view is too small, in which case nothing is published;
+ */
+struct loader_registry_view *loader_registry_remove(
+	struct loader_registry *registry,
+	struct loader_registry_view *view,
+	struct loader_module *module
+)
+{
+	
+	struct loader_registry_view *current;
+	u32 index;
+	u32 count;
+	u32 ranges;
+	
+	registry_lock(registry);
+	
+	current = registry->r_view;
+	
+	/*Count remaining modules and ranges;*/
+	for (index = count = 0; index < current->v_count; index++) {
+		count += (u32) (current->v_modules[index] != module);
+	}
+	
+	for (index = ranges = 0; index < current->v_nb_ranges; index++) {
+		ranges += (u32) (current->v_ranges[index]->c_module != module);
+	}
+	
+	/*If the view can't contain them, fail;*/
+	if ((view->v_size < count) || (view->v_range_size < ranges)) {
+		atomic_store(&registry->r_lock, 0);
+		return 0;
+	}
+	
+	/*Copy all modules but the removed one, then its ranges;*/
+	for (index = count = 0; index < current->v_count; index++) {
+		if (current->v_modules[index] != module) {
+			view->v_modules[count++] = current->v_modules[index];
+		}
+	}
+	
+	for (index = ranges = 0; index < current->v_nb_ranges; index++) {
+		if (current->v_ranges[index]->c_module != module) {
+			view->v_ranges[ranges++] = current->v_ranges[index];
+		}
+	}
+	
+	view->v_count = count;
+	view->v_nb_ranges = ranges;
+	
+	current = registry_publish(registry, view);
+	
+	atomic_store(&registry->r_lock, 0);
+	
+	return current;
+	
+}
+
+/**
+ * loader_registry_lookup : searches the modules of @registry for the export
+ * @name, in order; may be called concurrently with lookups and writers;
+ * @param registry : the registry to search;
+ * @param reader : the reader slot of the calling thread;
+ * @param name : the name of the definition;
+ * @return the address of the definition, null if it is not exported;
+ */
+void *loader_registry_lookup(
+	struct loader_registry *registry,
+	struct loader_registry_reader *reader,
+	const char *name
+)
+{
+	
+	struct loader_registry_view *view;
+	void *addr;
+	u32 index;
+	u8 taken;
+	
+	/*Record the lookup in the current epoch;*/
+	taken = registry_enter(registry, reader);
+	
+	/*The view can't be reused until the lookup completes;*/
+	view = atomic_load(&registry->r_view);
+	addr = 0;
+	
+	for (index = 0; (!addr) && (index < view->v_count); index++) {
+		addr = loader_module_lookup(view->v_modules[index], name);
+	}
+	
+	registry_leave(reader, taken);
+	
+	return addr;
+	
+}
+
+/**
+ * loader_addr_lookup : searches the code ranges of @registry for the one
+ * containing @pc, then its module's function containing @pc, in O(log n);
+ * performs no lock nor allocation and can be called from a signal handler,
+ * even if it interrupted a lookup or a writer; names remain valid until the
+ * module is removed;
+ * @param registry : the registry to search;
+ * @param reader : the reader slot of the calling thread, possibly in use by
+ * the lookup the caller interrupted;
+ * @param pc : the address to locate;
+ * @param addr : the location where to save the location of @pc;
+ * @return 1 if a module contains @pc, 0 if not;
+ */
+u8 loader_addr_lookup(
+	struct loader_registry *registry,
+	struct loader_registry_reader *reader,
+	u64 pc,
+	struct loader_addr *addr
+)
+{
+	
+	struct loader_registry_view *view;
+	const struct loader_code_range *range;
+	struct loader_module *module;
+	const struct loader_function *function;
+	u32 low;
+	u32 high;
+	u32 middle;
+	u8 taken;
+	
+	/*Record the lookup in the current epoch;*/
+	taken = registry_enter(registry, reader);
+	
+	view = atomic_load(&registry->r_view);
+	
+	/*Find the number of ranges starting at or before @pc;*/
+	low = 0;
+	high = view->v_nb_ranges;
+	
+	while (low < high) {
+		
+		middle = low + (high - low) / 2;
+		
+		if (view->v_ranges[middle]->c_start <= pc) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+		
+	}
+	
+	/*If the last one does not contain @pc, fail;*/
+	range = (low) ? view->v_ranges[low - 1] : 0;
+	
+	if ((!range) || (pc >= range->c_end)) {
+		registry_leave(reader, taken);
+		return 0;
+	}
+	
+	module = range->c_module;
+	
+	/*Locate @pc in the module's functions;*/
+	function = loader_module_function_at(module, pc);
+	
+	addr->a_module = module;
+	addr->a_function = (function) ? module->m_names + function->f_name : 0;
+	addr->a_offset = pc - ((function) ? function->f_addr : range->c_start);
+	
+	registry_leave(reader, taken);
+	
+	return 1;
+	
+}
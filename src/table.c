@@ -0,0 +1,380 @@
+/*table.c - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#include <table.h>
+
+/**
+ * loader_hash_bytes : returns @hash updated with the @size bytes at @data,
+ * as in FNV-1a;
+ * @param hash : the hash to update, LOADER_HASH_BASIS to start a hash;
+ * @param data : the bytes to hash;
+ * @param size : the number of bytes to hash;
+ * @return the updated hash;
+ */
+u32 loader_hash_bytes(
+	u32 hash,
+	const void *data,
+	u64 size
+)
+{
+	
+	const u8 *byte;
+	
+	for (byte = data; size--;) {
+		hash = (hash ^ *(byte++)) * 16777619u;
+	}
+	
+	return hash;
+	
+}
+
+/**
+ * loader_hash_string : returns the FNV-1a hash of the string @str;
+ * @param str : the string to hash;
+ * @return the hash;
+ */
+u32 loader_hash_string(
+	const char *str
+)
+{
+	
+	u32 hash;
+	
+	hash = LOADER_HASH_BASIS;
+	
+	while (*str) {
+		hash = (hash ^ (u8) *(str++)) * 16777619u;
+	}
+	
+	return hash;
+	
+}
+
+/**
+ * loader_hash_slots : returns the number of slots of a table that stays
+ * half empty with @count used slots;
+ * @param count : the number of slots to use;
+ * @return the smallest power of 2 greater than or equal to 2 * @count;
+ */
+u32 loader_hash_slots(
+	u32 count
+)
+{
+	
+	u32 slots;
+	
+	for (slots = 1; slots < 2 * count;)
+		slots <<= 1;
+	
+	return slots;
+	
+}
+
+/**
+ * loader_hash_init : initializes @table with the slot array @slots, and
+ * frees all slots;
+ * @param table : the table to initialize;
+ * @param slots : the slot array;
+ * @param bsize : the size of a slot;
+ * @param mask : the number of slots minus one; must be 2^n - 1;
+ */
+void loader_hash_init(
+	struct loader_hash_table *table,
+	void *slots,
+	u32 bsize,
+	u32 mask
+)
+{
+	
+	u32 index;
+	
+	table->h_slots = slots;
+	table->h_bsize = bsize;
+	table->h_mask = mask;
+	table->h_used = 0;
+	
+	/*Free all slots;*/
+	for (index = 0; index <= mask; index++) {
+		((struct loader_hash_slot *) loader_hash_slot_at(table, index))->s_used
+			= 0;
+	}
+	
+}
+
+/**
+ * loader_hash_find : probes @table linearly from @hash until a free slot or
+ * a used slot with hash @hash that @match accepts; @match is called only for
+ * slots with hash @hash; performs no write, and can be called from a signal
+ * handler;
+ * @param table : the table to search;
+ * @param hash : the hash of the key;
+ * @param match : returns 1 if the slot holds the key, 0 if not;
+ * @param key : the key to provide to @match;
+ * @param probes : incremented with the number of slots probed;
+ * @return the matching slot, or the free slot that ends the probe sequence;
+ */
+void *loader_hash_find(
+	const struct loader_hash_table *table,
+	u32 hash,
+	u8 (*match)(const void *slot, const void *key),
+	const void *key,
+	u32 *probes
+)
+{
+	
+	struct loader_hash_slot *slot;
+	u32 index;
+	
+	/*Probe slots linearly from the hash, until a free slot;*/
+	for (index = hash & table->h_mask;; index = (index + 1) & table->h_mask) {
+		
+		slot = loader_hash_slot_at(table, index);
+		(*probes)++;
+		
+		if ((!slot->s_used) ||
+			((slot->s_hash == hash) && ((*match)(slot, key))))
+			return slot;
+		
+	}
+	
+}
+
+/**
+ * loader_hash_claim : uses the free slot @slot, returned by loader_hash_find
+ * for @hash, if the table is less than 3/4 full;
+ * @param table : the table;
+ * @param slot : the free slot;
+ * @param hash : the hash of the slot's key;
+ * @return 1 if the slot is used, 0 if the table is full;
+ */
+u8 loader_hash_claim(
+	struct loader_hash_table *table,
+	void *slot,
+	u32 hash
+)
+{
+	
+	if ((table->h_used + 1) * 4 > (table->h_mask + 1) * 3)
+		return 0;
+	
+	((struct loader_hash_slot *) slot)->s_hash = hash;
+	((struct loader_hash_slot *) slot)->s_used = 1;
+	table->h_used++;
+	
+	return 1;
+	
+}
+
+/**
+ * hash_move : copies the slot at @src over the slot at @dst, and frees it;
+ */
+static void hash_move(
+	struct loader_hash_table *table,
+	u32 dst,
+	u32 src
+)
+{
+	
+	u8 *to;
+	u8 *from;
+	u32 byte;
+	
+	to = loader_hash_slot_at(table, dst);
+	from = loader_hash_slot_at(table, src);
+	
+	for (byte = 0; byte < table->h_bsize; byte++) {
+		to[byte] = from[byte];
+	}
+	
+	((struct loader_hash_slot *) from)->s_used = 0;
+	
+}
+
+/**
+ * hash_free : frees the used slot at @index of @table, then moves back
+ * following slots whose probe sequence crosses it;
+ */
+static void hash_free(
+	struct loader_hash_table *table,
+	u32 index
+)
+{
+	
+	struct loader_hash_slot *slot;
+	u32 hole;
+	u32 next;
+	u32 home;
+	
+	slot = loader_hash_slot_at(table, index);
+	slot->s_used = 0;
+	table->h_used--;
+	
+	for (hole = next = index;;) {
+		
+		next = (next + 1) & table->h_mask;
+		slot = loader_hash_slot_at(table, next);
+		
+		if (!slot->s_used)
+			return;
+		
+		/*If the slot's home is cyclically in ]hole, next], it stays;*/
+		home = slot->s_hash & table->h_mask;
+		if (((next - home) & table->h_mask) <
+			((next - hole) & table->h_mask))
+			continue;
+		
+		hash_move(table, hole, next);
+		hole = next;
+		
+	}
+	
+}
+
+/**
+ * loader_hash_release : frees the used slot @slot of @table; following slots
+ * are moved back so that no probe sequence is broken;
+ * @param table : the table;
+ * @param slot : the slot to free;
+ */
+void loader_hash_release(
+	struct loader_hash_table *table,
+	void *slot
+)
+{
+	
+	hash_free(table,
+		(u32) (((u8 *) slot - (u8 *) table->h_slots) / table->h_bsize));
+	
+}
+
+/**
+ * loader_hash_remove : frees each used slot of @table that @drop accepts;
+ * following slots are moved back so that no probe sequence is broken;
+ * @param table : the table;
+ * @param drop : returns 1 if the slot must be freed, 0 if not;
+ * @param key : the key to provide to @drop;
+ * @return the number of slots freed;
+ */
+u32 loader_hash_remove(
+	struct loader_hash_table *table,
+	u8 (*drop)(const void *slot, const void *key),
+	const void *key
+)
+{
+	
+	struct loader_hash_slot *slot;
+	u32 removed;
+	u32 index;
+	
+	removed = 0;
+	
+	/*Slots moved back to @index are checked again before moving on;*/
+	for (index = 0; index <= table->h_mask;) {
+		
+		slot = loader_hash_slot_at(table, index);
+		
+		if ((!slot->s_used) || (!(*drop)(slot, key))) {
+			index++;
+			continue;
+		}
+		
+		hash_free(table, index);
+		removed++;
+		
+	}
+	
+	return removed;
+	
+}
+
+/**
+ * sort_swap : swaps the records at @a and @b of @bsize bytes;
+ */
+static __inline__ void sort_swap(
+	u64 *a,
+	u64 *b,
+	u32 bsize
+)
+{
+	
+	u64 tmp;
+	u32 words;
+	
+	/*Swap records word per word;*/
+	for (words = bsize >> 3; words--;) {
+		tmp = a[words];
+		a[words] = b[words];
+		b[words] = tmp;
+	}
+	
+}
+
+/**
+ * sort_record : returns the record at @index of @records;
+ */
+#define sort_record(records, index, bsize) \
+	((u64 *) ((u8 *) (records) + (index) * (bsize)))
+
+/**
+ * sort_sift : restores the heap property of the heap of @count records
+ * rooted at @root;
+ */
+static void sort_sift(
+	void *records,
+	usize root,
+	usize count,
+	u32 bsize
+)
+{
+	
+	usize child;
+	
+	/*While the root has a child :*/
+	while ((child = 2 * root + 1) < count) {
+		
+		/*Select the child with the greatest key;*/
+		if ((child + 1 < count) && (*sort_record(records, child, bsize) <
+			*sort_record(records, child + 1, bsize)))
+			child++;
+		
+		/*If the root is greater than both children, complete;*/
+		if (*sort_record(records, root, bsize) >=
+			*sort_record(records, child, bsize))
+			return;
+		
+		/*Move the root down;*/
+		sort_swap(sort_record(records, root, bsize),
+			sort_record(records, child, bsize), bsize);
+		root = child;
+		
+	}
+	
+}
+
+/**
+ * loader_sort : sorts @count records of @bsize bytes at @records in place,
+ * by increasing value of their first 64 bits word, with a heapsort;
+ * @param records : the records, aligned on 8 bytes;
+ * @param count : the number of records;
+ * @param bsize : the size of a record, a multiple of 8;
+ */
+void loader_sort(
+	void *records,
+	usize count,
+	u32 bsize
+)
+{
+	
+	usize index;
+	
+	/*Build a max-heap;*/
+	for (index = count / 2; index--;) {
+		sort_sift(records, index, count, bsize);
+	}
+	
+	/*Move the greatest record to the end, restore the heap, repeat;*/
+	for (index = count; index-- > 1;) {
+		sort_swap(records, sort_record(records, index, bsize), bsize);
+		sort_sift(records, 0, index, bsize);
+	}
+	
+}
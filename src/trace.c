@@ -0,0 +1,81 @@
+/*trace.c - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#include <trace.h>
+
+/*Names of event kinds, by kind;*/
+static const char *event_names[LOADER_EVENT_KINDS] = {
+	"unknown",
+	"phase start",
+	"phase end",
+	"section",
+	"symbol",
+	"relocation",
+	"drop",
+	"group",
+	"fold",
+};
+
+/**
+ * loader_trace_init : initializes @trace with the event buffer @events;
+ * @param trace : the trace to initialize;
+ * @param events : the event buffer;
+ * @param mask : the number of events in the buffer minus one; must be
+ * 2^n - 1;
+ */
+void loader_trace_init(
+	struct loader_trace *trace,
+	struct loader_event *events,
+	u32 mask
+)
+{
+	trace->t_events = events;
+	trace->t_mask = mask;
+	trace->t_count = 0;
+}
+
+/**
+ * loader_trace_decode : calls @render on each event still in @trace, from the
+ * oldest to the newest, providing the name of the event's kind;
+ * @param trace : the trace to decode;
+ * @param render : the function rendering an event;
+ * @param handle : the renderer's private data, provided to each call;
+ * @return the number of events lost because the buffer was full;
+ */
+u32 loader_trace_decode(
+	struct loader_trace *trace,
+	void (*render)(void *handle, const struct loader_event *, const char *),
+	void *handle
+)
+{
+	
+	const struct loader_event *event;
+	u32 count;
+	u32 lost;
+	u32 index;
+	u8 kind;
+	
+	/*Cache the number of recorded events;*/
+	count = trace->t_count;
+	
+	/*Determine the number of overwritten events;*/
+	lost = (count > trace->t_mask + 1) ? count - (trace->t_mask + 1) : 0;
+	
+	/*Render remaining events, from the oldest;*/
+	for (index = lost; index != count; index++) {
+		
+		/*Fetch the event and its kind;*/
+		event = trace->t_events + (index & trace->t_mask);
+		kind = event->ev_kind;
+		
+		/*Render the event;*/
+		(*render)(
+			handle, event,
+			event_names[(kind < LOADER_EVENT_KINDS) ? kind : 0]
+		);
+		
+	}
+	
+	/*Complete;*/
+	return lost;
+	
+}
@@ -0,0 +1,83 @@
+/*dedupe.c - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+/*
+ * Built with gcc -std=c89 -O2 -ffunction-sections -fno-ipa-icf
+ * -fno-asynchronous-unwind-tables -c; loaded twice, to check that groups,
+ * merge entries, common symbols and identical code are shared, and converted
+ * to an image;
+ */
+
+#include <types.h>
+
+/*A COMDAT group, loaded once;*/
+__asm__(
+	".section .text.grp,\"axG\",@progbits,grp,comdat\n"
+	".globl grp\n"
+	".type grp, @function\n"
+	"grp:\n"
+	"	movl $3, %eax\n"
+	"	ret\n"
+	".text\n"
+);
+
+/*A constant of a merge section, loaded once;*/
+__asm__(
+	".section .rodata.cst4,\"aM\",@progbits,4\n"
+	".globl cst\n"
+	".type cst, @object\n"
+	"cst:\n"
+	"	.long 42\n"
+	".text\n"
+);
+
+/*A common symbol, placed once;*/
+__asm__(
+	".comm cmn, 8, 8\n"
+);
+
+/*A string of a merge section, loaded once, that its pointer references
+ * through the section symbol;*/
+const char *const msg = "rmld";
+
+u32 grp(void);
+
+/*Identical functions, folded;*/
+u32 id1(void)
+{
+	return 7;
+}
+
+u32 id2(void)
+{
+	return 7;
+}
+
+/*Functions whose code only differs by the target of their relocation;*/
+__attribute__((noinline)) u32 f1(void)
+{
+	return 1;
+}
+
+__attribute__((noinline)) u32 f2(void)
+{
+	return 2;
+}
+
+u32 cf(void)
+{
+	return f1();
+}
+
+u32 cg(void)
+{
+	return f2();
+}
+
+/*Function pointers, written by absolute relocations, saved as relr words
+ * in images;*/
+static u32 (*const calls[2])(void) = {&f1, &f2};
+
+u32 dispatch(u32 index)
+{
+	return (*calls[index])();
+}
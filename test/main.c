@@ -1,3 +1,5 @@
+#define _DEFAULT_SOURCE
+
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -11,12 +13,413 @@
 
 #define FILE_NAME "test/test.o"
 
+#define DEDUPE_NAME "test/dedupe.o"
+
+#define ARENA_SIZE (1 << 20)
+
+#define PAGE_SHIFT 12
+
+#define TRACE_SIZE 128
+
+#define SCRATCH_SIZE (1 << 18)
+
+#define GROUP_SLOTS 16
+
+#define DEDUPE_QUERIES 8
+
+#define IMAGE_SIZE (1 << 16)
+
+#define TEST_RANGES 16
+
 #define handle_error(msg) { printf("%s error;\n",msg); exit(1); }
 
 u32 a;
 u32 b;
 u32 c;
 
+/*The arena the loader allocates memory in;*/
+static u8 *arena;
+static usize arena_used;
+
+static void *arena_alloc(void *handle, usize size, usize align, u64 flags)
+{
+	
+	usize start;
+	
+	if (!align)
+		align = 1;
+	
+	start = (arena_used + align - 1) & ~(align - 1);
+	
+	if (start + size > ARENA_SIZE)
+		return 0;
+	
+	arena_used = start + size;
+	
+	return arena + start;
+	
+}
+
+/*The block the streamed load allocates scratch memory in;*/
+static u64 scratch_block[SCRATCH_SIZE / sizeof(u64)];
+
+/*The block the sections of an image are laid out in;*/
+static u64 image_block[IMAGE_SIZE / sizeof(u64)];
+
+static u8 fd_read(void *handle, void *dst, u64 offset, usize size)
+{
+	
+	return (u8) (pread(*(int *) handle, dst, size, (off_t) offset) !=
+		(ssize_t) size);
+	
+}
+
+static void render(void *handle, const struct loader_event *event,
+				   const char *kind)
+{
+	
+	printf("  %-10s phase %d section %3d symbol %3d type %d value %lx\n",
+		   kind, event->ev_phase, event->ev_section, event->ev_symbol,
+		   event->ev_type, event->ev_value);
+	
+}
+
+static void load(struct loading_env *rel, u8 single_pass,
+				 struct loader_registry_view *view)
+{
+	
+	struct loader_symbol prtf;
+	struct loader_symbol func;
+	u8 error;
+	u32 (*fnc)(void);
+	u32 res;
+	
+	prtf.s_defined = 1;
+	prtf.s_addr = (void*)&printf;
+	prtf.s_next = 0;
+	prtf.s_name = "printf";
+	
+	func.s_defined = 0;
+	func.s_addr = 0;
+	func.s_next = 0;
+	func.s_name = "func";
+	
+	if (view) {
+		
+		error = loader_prepare(rel, &prtf, &func, view);
+		
+		printf("prepare : %d (phase %d, section %d, entry %d)\n", error,
+			   rel->r_error.e_phase, rel->r_error.e_section,
+			   rel->r_error.e_entry);
+		
+	} else if (single_pass) {
+		
+		error = loader_load(rel, &prtf, &func);
+		
+		printf("load : %d (phase %d, section %d, entry %d)\n", error,
+			   rel->r_error.e_phase, rel->r_error.e_section,
+			   rel->r_error.e_entry);
+		
+	} else {
+		
+		error = loader_assign_sections(rel);
+		
+		printf("sections allocations : %d\n", error);
+		
+		error = loader_assign_symbols(rel, &prtf, &func);
+		
+		printf("symbols assignment : %d\n", error);
+		
+		error = loader_apply_relocations(rel);
+		
+		printf("rellocation application : %d\n", error);
+		
+	}
+	
+	printf("func : %p\n", func.s_addr);
+	
+	fnc = func.s_addr;
+	
+	printf("calling :\n");
+	
+	res = (*fnc)();
+	
+	printf("called : %d\n", res);
+	
+}
+
+/*A view prepared before other publications is not committed, even if the
+ * view it was filled from was reused meanwhile;*/
+static void registry_stale(struct loader_module *module)
+{
+	
+	struct loader_module *slots[3][8];
+	const struct loader_code_range *ranges[3][16];
+	struct loader_code_range codes[5][2];
+	struct loader_registry_view views[3];
+	struct loader_registry registry;
+	struct loader_registry_reader reader;
+	struct loader_export exports[5][2];
+	struct loader_module others[5];
+	struct loader_addr first;
+	struct loader_addr second;
+	struct loader_registry_view *old;
+	u32 epoch;
+	u8 view;
+	
+	for (view = 0; view < 3; view++) {
+		views[view].v_modules = slots[view];
+		views[view].v_ranges = ranges[view];
+		views[view].v_size = 8;
+		views[view].v_range_size = 16;
+		views[view].v_count = 0;
+		views[view].v_nb_ranges = 0;
+	}
+	
+	/*Other modules have no code, but the three last ones;*/
+	for (view = 0; view < 5; view++) {
+		loader_module_init(others + view, exports[view], 1, 0, codes[view], 0);
+	}
+	
+	loader_registry_init(&registry, views, &reader, 1);
+	loader_registry_prepare(&registry, &reader, views + 1, module, &epoch);
+	
+	/*Another writer publishes twice, the second time in the first view;*/
+	loader_registry_add(&registry, views + 2, others);
+	loader_registry_add(&registry, views, others + 1);
+	
+	printf("stale commit : %s\n",
+		   (loader_registry_commit(&registry, views + 1, epoch)) ? "FAILED" :
+		   "ok");
+	
+	/*Publish two modules whose code alternates, then one that intersects
+	 * them;*/
+	loader_module_code(others + 2, 0x1000, 0x1010);
+	loader_module_code(others + 2, 0x1030, 0x1040);
+	loader_module_code(others + 3, 0x1010, 0x1030);
+	loader_module_code(others + 4, 0x100c, 0x1014);
+	
+	loader_registry_add(&registry, views + 1, others + 2);
+	loader_registry_add(&registry, views + 2, others + 3);
+	old = loader_registry_add(&registry, views + 1, others + 4);
+	
+	printf("registry ranges : %s\n", ((!old) &&
+		   (loader_addr_lookup(&registry, &reader, 0x1018, &first)) &&
+		   (first.a_module == others + 3) && (first.a_offset == 8) &&
+		   (loader_addr_lookup(&registry, &reader, 0x1034, &second)) &&
+		   (second.a_module == others + 2) && (second.a_offset == 4) &&
+		   (!loader_addr_lookup(&registry, &reader, 0x1040, &second))) ? "ok" :
+		   "FAILED");
+	
+}
+
+/*The queries of the dedupe object;*/
+static const char *const dedupe_names[DEDUPE_QUERIES] =
+	{"grp", "cst", "id1", "id2", "cf", "cg", "msg", "cmn"};
+
+/*Call the function at @addr;*/
+static u32 call(void *addr)
+{
+	
+	u32 (*fnc)(void);
+	
+	fnc = addr;
+	
+	return (*fnc)();
+	
+}
+
+/*Stream the dedupe object twice, with process-wide group, merge, fold and
+ * common tables;*/
+static void dedupe(struct loader_allocator *alloc)
+{
+	
+	struct loading_env rel;
+	struct loader_stream stream;
+	struct loader_allocator scratch_alloc;
+	struct loader_arena scratch;
+	struct loader_group_table groups;
+	struct loader_group group_slots[GROUP_SLOTS];
+	struct loader_merge_pool pool;
+	struct loader_merge_entry pool_slots[GROUP_SLOTS];
+	struct loader_fold_table folds;
+	struct loader_fold_entry fold_slots[GROUP_SLOTS];
+	struct loader_common_table commons;
+	struct loader_common common_slots[GROUP_SLOTS];
+	struct loader_symbol queries[DEDUPE_QUERIES];
+	void *addrs[2][DEDUPE_QUERIES];
+	u8 error;
+	u8 copy;
+	u8 query;
+	int fd;
+	
+	fd = open(DEDUPE_NAME, O_RDONLY);
+	
+	if (fd == -1) handle_error("dedupe open")
+	
+	stream.s_handle = &fd;
+	stream.s_read = &fd_read;
+	
+	loader_group_table_init(&groups, group_slots, GROUP_SLOTS - 1);
+	loader_merge_pool_init(&pool, pool_slots, GROUP_SLOTS - 1);
+	loader_fold_table_init(&folds, fold_slots, GROUP_SLOTS - 1);
+	loader_common_table_init(&commons, common_slots, GROUP_SLOTS - 1);
+	loader_arena_init(&scratch, scratch_block, SCRATCH_SIZE);
+	scratch_alloc.a_handle = &scratch;
+	scratch_alloc.a_alloc = &loader_arena_alloc;
+	
+	for (copy = 0; copy < 2; copy++) {
+		
+		for (query = 0; query < DEDUPE_QUERIES; query++) {
+			queries[query].s_defined = 0;
+			queries[query].s_addr = 0;
+			queries[query].s_next =
+				(query + 1 < DEDUPE_QUERIES) ? queries + query + 1 : 0;
+			queries[query].s_name = dedupe_names[query];
+		}
+		
+		error = loader_init_stream(&rel, &stream, alloc);
+		
+		if (!error) {
+			rel.r_scratch = &scratch_alloc;
+			rel.r_flags = LOADER_FLAG_DEDUPE_GROUPS |
+				LOADER_FLAG_MERGE_SECTIONS | LOADER_FLAG_FOLD_CODE;
+			rel.r_groups = &groups;
+			rel.r_merge = &pool;
+			rel.r_folds = &folds;
+			rel.r_commons = &commons;
+			error = loader_declare_commons(&rel);
+		}
+		
+		if (!error) {
+			error = loader_load(&rel, 0, queries);
+		}
+		
+		printf("dedupe load %d : %d, grp : %p\n", copy, error,
+			   queries[0].s_addr);
+		
+		for (query = 0; query < DEDUPE_QUERIES; query++) {
+			addrs[copy][query] = (error) ? 0 : queries[query].s_addr;
+		}
+		
+		/*Release scratch memory, and shift the next load's, so that the
+		 * string tables of the first load are overwritten;*/
+		loader_arena_reset(&scratch);
+		loader_arena_alloc(&scratch, 64, 1, 0);
+		
+	}
+	
+	/*The second copy of the group resolves to the first;*/
+	printf("dedupe groups : %s\n",
+		   ((addrs[0][0]) && (addrs[1][0] == addrs[0][0])) ? "ok" : "FAILED");
+	
+	/*The second copy of the constant resolves to the first, and so does the
+	 * second copy of the string, that is referenced by its section;*/
+	printf("dedupe merge : %s\n",
+		   ((addrs[0][1]) && (addrs[1][1] == addrs[0][1]) &&
+			   (*(u32 *) addrs[1][1] == 42) && (addrs[1][6]) &&
+			   (*(const char **) addrs[1][6] ==
+				   *(const char **) addrs[0][6]) &&
+			   (**(const char **) addrs[1][6] == 'r')) ? "ok" :
+		   "FAILED");
+	
+	/*The second copy of the common symbol resolves to the first;*/
+	printf("dedupe commons : %s\n",
+		   ((addrs[0][7]) && (addrs[1][7] == addrs[0][7])) ? "ok" : "FAILED");
+	
+	/*Identical functions fold, in a load and across loads; functions calling
+	 * different targets do not;*/
+	printf("dedupe fold : %s\n",
+		   ((addrs[0][2]) && (addrs[0][3] == addrs[0][2]) &&
+			   (addrs[1][2] == addrs[0][2]) && (addrs[1][3] == addrs[0][2]) &&
+			   (addrs[1][4] == addrs[0][4]) && (addrs[0][4] != addrs[0][5]) &&
+			   (call(addrs[1][2]) == 7) && (call(addrs[1][4]) == 1) &&
+			   (call(addrs[1][5]) == 2)) ? "ok" : "FAILED");
+	
+	/*Before the first copy is unloaded, its entries are removed;*/
+	printf("dedupe removal : %s\n",
+		   ((loader_group_table_remove(&groups, (u64) addrs[0][0],
+			   (u64) addrs[0][0] + 1) == 1) && (!groups.t_groups.h_used) &&
+			   (loader_merge_pool_remove(&pool, (u64) addrs[0][1],
+				   (u64) addrs[0][1] + 4) == 1) &&
+			   (loader_fold_table_remove(&folds, (u64) addrs[0][2],
+				   (u64) addrs[0][2] + 1) == 1) &&
+			   (loader_common_table_remove(&commons, (u64) addrs[0][7],
+				   (u64) addrs[0][7] + 8) == 1)) ? "ok" : "FAILED");
+	
+	close(fd);
+	
+}
+
+/*Convert the dedupe object to an image, load the image and call it;*/
+static void image(struct loader_allocator *alloc)
+{
+	
+	struct loading_env rel;
+	struct loader_stream stream;
+	struct loader_allocator scratch_alloc;
+	struct loader_arena scratch;
+	struct loader_allocator section_alloc;
+	struct loader_arena sections;
+	struct loader_image_hdr *hdr;
+	struct loader_symbol query;
+	u32 (*dispatch)(u32);
+	usize size;
+	void *base;
+	u8 error;
+	int fd;
+	
+	fd = open(DEDUPE_NAME, O_RDONLY);
+	
+	if (fd == -1) handle_error("image open")
+	
+	stream.s_handle = &fd;
+	stream.s_read = &fd_read;
+	
+	loader_arena_init(&scratch, scratch_block, SCRATCH_SIZE);
+	scratch_alloc.a_handle = &scratch;
+	scratch_alloc.a_alloc = &loader_arena_alloc;
+	loader_arena_init(&sections, image_block, IMAGE_SIZE);
+	section_alloc.a_handle = &sections;
+	section_alloc.a_alloc = &loader_arena_alloc;
+	
+	query.s_defined = 0;
+	query.s_addr = 0;
+	query.s_next = 0;
+	query.s_name = "dispatch";
+	
+	/*Sections are laid out in the image block, metadata apart;*/
+	error = loader_init_stream(&rel, &stream, &scratch_alloc);
+	
+	if (!error) {
+		rel.r_code = rel.r_data = &section_alloc;
+		if (!(error = loader_assign_sections(&rel)) &&
+			!(error = loader_assign_symbols(&rel, 0, &query)))
+			error = loader_image_build(&rel, (u64) image_block, IMAGE_SIZE,
+				&hdr, &size);
+	}
+	
+	printf("image build : %d, %d relr words\n", error,
+		   (error) ? 0 : hdr->i_nb_relr);
+	
+	close(fd);
+	
+	if (error)
+		return;
+	
+	/*Load the image elsewhere, and call through its relocated pointers;*/
+	query.s_defined = 0;
+	query.s_addr = 0;
+	error = loader_image_load(hdr, size, alloc, 0, &query, &base);
+	
+	dispatch = query.s_addr;
+	
+	printf("image load : %d, dispatch : %s\n", error,
+		   ((!error) && (hdr->i_nb_relr) && (dispatch) &&
+			   ((*dispatch)(0) == 1) && ((*dispatch)(1) == 2)) ? "ok" : "FAILED");
+	
+}
+
 int main(int argc, char *argv[])
 {
 	
@@ -24,12 +427,27 @@ int main(int argc, char *argv[])
 	int fd;
 	struct stat sb;
 	usize file_size;
-	struct loader_symbol prtf;
-	struct loader_symbol func;
 	struct loading_env rel;
+	struct loader_stream stream;
+	struct loader_allocator alloc;
+	struct loader_allocator scratch_alloc;
+	struct loader_arena scratch;
+	struct loader_page_report report;
+	struct loader_trace trace;
+	struct loader_stats stats;
+	struct loader_module module;
+	struct loader_module *modules[2];
+	const struct loader_code_range *ranges[TEST_RANGES];
+	struct loader_registry_view views[2];
+	struct loader_registry registry;
+	struct loader_registry_reader reader;
+	struct loader_addr location;
+	struct loader_counter calls;
+	struct loader_event events[TRACE_SIZE];
+	u8 pages[64];
+	usize page;
+	usize used;
 	u8 error;
-	u32 (*fnc)(void);
-	u32 res;
 	
 	fd = open(FILE_NAME, O_RDONLY);
 	
@@ -40,8 +458,8 @@ int main(int argc, char *argv[])
 	
 	file_size = (usize) sb.st_size;
 	
-	addr = mmap(NULL, file_size, PROT_WRITE | PROT_READ | PROT_EXEC,
-				MAP_PRIVATE, fd, 0);
+	/*Map the file shared; pages the load writes to are remapped private;*/
+	addr = mmap(NULL, file_size, PROT_READ | PROT_EXEC, MAP_SHARED, fd, 0);
 	
 	if (addr == MAP_FAILED) handle_error("mmap")
 	
@@ -52,44 +470,150 @@ int main(int argc, char *argv[])
 		
 	}
 	
-	prtf.s_defined = 1;
-	prtf.s_addr = (void*)&printf;
-	prtf.s_next = 0;
-	prtf.s_name = "printf";
+	printf("hdr : %p\n", addr);
 	
-	func.s_defined = 0;
-	func.s_addr = 0;
-	func.s_next = 0;
-	func.s_name = "func";
+	arena = mmap(NULL, ARENA_SIZE, PROT_WRITE | PROT_READ | PROT_EXEC,
+				 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 	
-	printf("hdr : %p\n", addr);
+	if (arena == MAP_FAILED) handle_error("arena mmap")
 	
-	loader_init(&rel, addr);
+	alloc.a_handle = 0;
+	alloc.a_alloc = &arena_alloc;
 	
-	error = loader_assign_sections(&rel);
+	error = loader_init(&rel, addr, &alloc);
 	
-	printf("sections allocations : %d\n", error);
+	printf("init : %d\n", error);
 	
-	error = loader_assign_symbols(&rel, &prtf, &func);
+	rel.r_flags = LOADER_FLAG_SORT_RELOCATIONS;
 	
-	printf("symbols assignment : %d\n", error);
+	/*An empty file has no page to write;*/
+	error = loader_dirty_pages(&rel, 0, PAGE_SHIFT, pages, &report);
 	
-	error = loader_apply_relocations(&rel);
+	printf("empty dirty pages : %d, private : %lu\n", error,
+		   report.p_private);
 	
-	printf("rellocation application : %d\n", error);
+	/*The bitmap must hold a bit per page of the file;*/
+	if (((file_size + (1 << PAGE_SHIFT) - 1) >> PAGE_SHIFT) > 8 * sizeof(pages))
+		handle_error("page bitmap")
 	
-	printf("func : %p\n", func.s_addr);
+	error = loader_dirty_pages(&rel, file_size, PAGE_SHIFT, pages, &report);
 	
-	fnc = func.s_addr;
+	printf("dirty pages : %d, shared : %lu, private : %lu\n", error,
+		   report.p_shared, report.p_private);
 	
-	printf("calling :\n");
+	for (page = 0; page << PAGE_SHIFT < file_size; page++) {
+		
+		if (!(pages[page >> 3] & (1 << (page & 7))))
+			continue;
+		
+		if (mmap((u8 *) addr + (page << PAGE_SHIFT), 1 << PAGE_SHIFT,
+				 PROT_WRITE | PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_FIXED,
+				 fd, (off_t) (page << PAGE_SHIFT)) == MAP_FAILED)
+			handle_error("private mmap")
+		
+	}
 	
-	res = (*fnc)();
+	load(&rel, 0, 0);
 	
-	printf("called : %d\n", res);
+	/*Load the file a second time, streaming it to the arena;*/
+	used = arena_used;
+	
+	stream.s_handle = &fd;
+	stream.s_read = &fd_read;
+	
+	error = loader_init_stream(&rel, &stream, &alloc);
+	
+	printf("stream init : %d\n", error);
+	
+	/*Allocate metadata only used during the load in the scratch arena;*/
+	loader_arena_init(&scratch, scratch_block, SCRATCH_SIZE);
+	
+	scratch_alloc.a_handle = &scratch;
+	scratch_alloc.a_alloc = &loader_arena_alloc;
+	rel.r_scratch = &scratch_alloc;
+	
+	/*Only load sections reachable from func;*/
+	rel.r_flags = LOADER_FLAG_GC_SECTIONS;
+	
+	loader_trace_init(&trace, events, TRACE_SIZE - 1);
+	
+	rel.r_trace = &trace;
+	
+	/*Index the exports of the file;*/
+	rel.r_module = &module;
+	
+	/*Count calls to printf from the file;*/
+	calls.c_next = 0;
+	calls.c_name = "printf";
+	calls.c_count = 0;
+	calls.c_thunks = 0;
+	rel.r_counters = &calls;
+	
+	/*Prepare the file's publication in a registry, initially empty;*/
+	views[0].v_count = 0;
+	views[0].v_nb_ranges = 0;
+	views[1].v_modules = modules;
+	views[1].v_ranges = ranges;
+	views[1].v_size = 1;
+	views[1].v_range_size = TEST_RANGES;
+	
+	loader_registry_init(&registry, views, &reader, 1);
+	rel.r_registry = &registry;
+	rel.r_reader = &reader;
+	
+	loader_stats_start(&rel, &stats);
+	
+	load(&rel, 1, views + 1);
+	
+	printf("printf calls : %lu (%d thunks)\n",
+		   (unsigned long) loader_counter_read(&calls), calls.c_thunks);
+	
+	printf("stats : init %lu, sections %lu, symbols %lu, relocations %lu\n",
+		   stats.st_time[LOADER_STATS_INIT],
+		   stats.st_time[LOADER_PHASE_SECTIONS],
+		   stats.st_time[LOADER_PHASE_SYMBOLS],
+		   stats.st_time[LOADER_PHASE_RELOCATIONS]);
+	
+	printf("stats : %d symbols, %d lookups, %d compares, %d relocations "
+		   "(%d PC32, %d PLT32), %d overflows\n", stats.st_symbols,
+		   stats.st_lookups, stats.st_compares, stats.st_relocations,
+		   stats.st_rel_types[2], stats.st_rel_types[4], stats.st_overflows);
+	
+	printf("exports : %d, func : %p\n", module.m_exports.h_used,
+		   loader_module_lookup(&module, "func"));
+	
+	/*Publish the module, then reuse the previous view once retired;*/
+	printf("commit : previous view %d modules\n",
+		   loader_commit(&rel, &reader, views + 1)->v_count);
+	
+	loader_registry_retire(&registry);
+	
+	/*Locate an address in func;*/
+	
+	if (loader_addr_lookup(&registry, &reader,
+		(u64) loader_module_lookup(&module, "func") + 4, &location))
+		printf("func + 4 : %s + %lu\n", location.a_function,
+			   (unsigned long) location.a_offset);
+	
+	printf("trace :\n");
+	
+	printf("%d events lost\n", loader_trace_decode(&trace, &render, 0));
+	
+	printf("streamed bytes : %lu / %lu\n", arena_used - used, file_size);
+	
+	/*The load is complete and its trace decoded, release the scratch arena;*/
+	printf("scratch peak : %lu bytes\n", (unsigned long) scratch.a_peak);
+	
+	loader_arena_reset(&scratch);
 	
 	close(fd);
 	
+	registry_stale(&module);
+	
+	dedupe(&alloc);
+	
+	image(&alloc);
+	
 	exit(EXIT_SUCCESS);
 	
 }
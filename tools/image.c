@@ -0,0 +1,172 @@
+/*image.c - rmld - GPLV3, copyleft 2019 Raphael Outhier;*/
+
+#define _GNU_SOURCE
+
+#include <sys/mman.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <elf64.h>
+#include <loader.h>
+
+/*The size of the range sections are laid out in;*/
+#define RANGE_SIZE (256 << 20)
+
+#define handle_error(msg) { fprintf(stderr, "%s error;\n", msg); exit(1); }
+
+/*<string.h> resolves to nostd's, declare libc's copy;*/
+extern void *memcpy(void *dst, const void *src, size_t size);
+
+/*The range sections are laid out in;*/
+static u8 *range;
+static usize range_used;
+
+/*The object, read in memory;*/
+static u8 *object;
+static usize object_size;
+
+/*Sections are laid out in the range, metadata is allocated apart;*/
+static void *image_alloc(void *handle, usize size, usize align, u64 flags)
+{
+	
+	usize start;
+	
+	if (!(flags & SHF_ALLOC))
+		return malloc(size ? size : 1);
+	
+	if (!align)
+		align = 1;
+	
+	start = (range_used + align - 1) & ~(align - 1);
+	
+	if (start + size > RANGE_SIZE)
+		return 0;
+	
+	range_used = start + size;
+	
+	return range + start;
+	
+}
+
+static u8 mem_read(void *handle, void *dst, u64 offset, usize size)
+{
+	
+	if (offset + size > object_size)
+		return 1;
+	
+	memcpy(dst, object + offset, size);
+	
+	return 0;
+	
+}
+
+/*Read @path in memory;*/
+static void read_object(const char *path)
+{
+	
+	FILE *file;
+	long size;
+	
+	if (!(file = fopen(path, "rb")) || fseek(file, 0, SEEK_END) ||
+		((size = ftell(file)) < 0) || fseek(file, 0, SEEK_SET))
+		handle_error("open")
+	
+	object_size = (usize) size;
+	
+	if (!(object = malloc(object_size)) ||
+		fread(object, 1, object_size, file) != object_size)
+		handle_error("read")
+	
+	fclose(file);
+	
+}
+
+int main(int argc, char *argv[])
+{
+	
+	struct loading_env env;
+	struct loader_stream stream;
+	struct loader_allocator alloc;
+	struct loader_image_hdr *image;
+	usize image_size;
+	FILE *file;
+	u32 flags;
+	
+	/*With -m, constants are merged; with -f, identical code is folded;*/
+	flags = 0;
+	while ((argc > 1) && (argv[1][0] == '-')) {
+		if (argv[1][1] == 'm') {
+			flags |= LOADER_FLAG_MERGE_SECTIONS;
+		} else if (argv[1][1] == 'f') {
+			flags |= LOADER_FLAG_FOLD_CODE;
+		} else {
+			break;
+		}
+		argv++;
+		argc--;
+	}
+	
+	if (argc != 3) {
+		
+		fprintf(stderr, "usage : %s [-m] [-f] object image\n"
+				"  lays the object out and writes it as an rmld image;\n",
+				argv[0]);
+		
+		return 1;
+		
+	}
+	
+	/*The range is page aligned, so that the image is;*/
+	range = mmap(NULL, RANGE_SIZE, PROT_WRITE | PROT_READ,
+				 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	
+	if (range == MAP_FAILED) handle_error("range mmap")
+	
+	read_object(argv[1]);
+	
+	alloc.a_handle = 0;
+	alloc.a_alloc = &image_alloc;
+	stream.s_handle = 0;
+	stream.s_read = &mem_read;
+	
+	env.r_error.e_code = loader_init_stream(&env, &stream, &alloc);
+	
+	/*Lay sections out, assign symbols, imports are left undefined;*/
+	if (!env.r_error.e_code) {
+		env.r_flags = flags;
+		if (!loader_assign_sections(&env) && !loader_assign_symbols(&env, 0, 0))
+			loader_image_build(&env, (u64) range, range_used, &image,
+							   &image_size);
+	}
+	
+	if (env.r_error.e_code) {
+		
+		fprintf(stderr, "conversion error %d (phase %d, section %d, entry %d)\n",
+				env.r_error.e_code, env.r_error.e_phase,
+				env.r_error.e_section, env.r_error.e_entry);
+		
+		return 1;
+		
+	}
+	
+	if (!(file = fopen(argv[2], "wb")) ||
+		(fwrite(image, 1, image_size, file) != image_size) || fclose(file))
+		handle_error("write")
+	
+	printf("%s : %lu bytes, image %lu bytes, %u fixups, %u relr words, "
+		   "%u imports, %u exports\n", argv[2], (unsigned long) image_size,
+		   (unsigned long) image->i_size, image->i_nb_fixups,
+		   image->i_nb_relr, image->i_nb_imports, image->i_nb_exports);
+	
+	return 0;
+	
+}
+
+
+void ns_log(const char *str) {
+	fprintf(stderr, "%s", str);
+}
+
+void ns_abort() {
+	abort();
+}